@@ -0,0 +1,116 @@
+#include "internal.h"
+
+//// IMA ADPCM
+// Blocks are laid out as in WAV files. Each channel starts with a
+// four byte header holding its first sample as a little-endian
+// int16 and the step index to continue from. The remaining samples
+// follow as four bit codes, in groups of four bytes per channel
+// that hold eight samples each, low nibble first. Since every block
+// carries its own starting state, blocks decode independently.
+#define ADPCM_GROUPS ((MIXED_ADPCM_BLOCK_SIZE - 4) / 4)
+
+static const int16_t step_table[89] = {
+  7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37,
+  41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173,
+  190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+  724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+  2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894,
+  6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289,
+  16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const int8_t index_table[16] = {
+  -1, -1, -1, -1, 2, 4, 6, 8,
+  -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+struct adpcm_channel{
+  int32_t predictor;
+  int32_t index;
+};
+
+static inline int32_t clamp(int32_t value, int32_t min, int32_t max){
+  return (value < min)? min : (max < value)? max : value;
+}
+
+static inline int16_t decode_nibble(struct adpcm_channel *channel, uint8_t nibble){
+  int32_t step = step_table[channel->index];
+  int32_t diff = step >> 3;
+  if(nibble & 1) diff += step >> 2;
+  if(nibble & 2) diff += step >> 1;
+  if(nibble & 4) diff += step;
+  if(nibble & 8) diff = -diff;
+  channel->predictor = clamp(channel->predictor + diff, INT16_MIN, INT16_MAX);
+  channel->index = clamp(channel->index + index_table[nibble], 0, 88);
+  return channel->predictor;
+}
+
+static inline uint8_t encode_sample(struct adpcm_channel *channel, int32_t sample){
+  int32_t step = step_table[channel->index];
+  int32_t diff = sample - channel->predictor;
+  uint8_t nibble = 0;
+  if(diff < 0){
+    nibble = 8;
+    diff = -diff;
+  }
+  if(step <= diff){ nibble |= 4; diff -= step; }
+  step >>= 1;
+  if(step <= diff){ nibble |= 2; diff -= step; }
+  step >>= 1;
+  if(step <= diff){ nibble |= 1; }
+  // Track the decoder's state rather than the input, so that the
+  // error does not accumulate.
+  decode_nibble(channel, nibble);
+  return nibble;
+}
+
+void adpcm_decode_block(uint8_t *block, channel_t channels, float *out){
+  struct adpcm_channel state[channels];
+  for(channel_t c=0; c<channels; ++c){
+    uint8_t *header = block + 4*c;
+    state[c].predictor = (int16_t)(header[0] | (header[1] << 8));
+    state[c].index = clamp(header[2], 0, 88);
+    out[c] = mixed_from_int16(state[c].predictor);
+  }
+  uint8_t *data = block + 4*channels;
+  for(uint32_t g=0; g<ADPCM_GROUPS; ++g){
+    for(channel_t c=0; c<channels; ++c){
+      float *frame = out + (1+8*g)*channels + c;
+      for(uint8_t b=0; b<4; ++b){
+        uint8_t byte = *data++;
+        frame[(2*b+0)*channels] = mixed_from_int16(decode_nibble(&state[c], byte & 0x0F));
+        frame[(2*b+1)*channels] = mixed_from_int16(decode_nibble(&state[c], byte >> 4));
+      }
+    }
+  }
+}
+
+void adpcm_encode_block(float *in, channel_t channels, uint8_t *block){
+  struct adpcm_channel state[channels];
+  for(channel_t c=0; c<channels; ++c){
+    uint8_t *header = block + 4*c;
+    int16_t first = mixed_to_int16(in[c]);
+    int32_t delta = abs(mixed_to_int16(in[channels+c]) - first);
+    // Start with the step that fits the first difference, as there
+    // is no earlier state to carry over.
+    state[c].predictor = first;
+    state[c].index = 0;
+    while(state[c].index < 88 && step_table[state[c].index] < delta)
+      ++state[c].index;
+    header[0] = first & 0xFF;
+    header[1] = (first >> 8) & 0xFF;
+    header[2] = state[c].index;
+    header[3] = 0;
+  }
+  uint8_t *data = block + 4*channels;
+  for(uint32_t g=0; g<ADPCM_GROUPS; ++g){
+    for(channel_t c=0; c<channels; ++c){
+      float *frame = in + (1+8*g)*channels + c;
+      for(uint8_t b=0; b<4; ++b){
+        uint8_t lo = encode_sample(&state[c], mixed_to_int16(frame[(2*b+0)*channels]));
+        uint8_t hi = encode_sample(&state[c], mixed_to_int16(frame[(2*b+1)*channels]));
+        *data++ = lo | (hi << 4);
+      }
+    }
+  }
+}
@@ -1,13 +1,91 @@
 #include "internal.h"
 
+// Buffers are single-producer single-consumer, so acquiring the
+// other side's pointer and releasing our own is sufficient.
 #define read_buffer_state(READ, WRITE, FULL_R2, BUFFER) \
-  uint32_t READ = atomic_read(BUFFER->read);            \
-  uint32_t WRITE ## _ = atomic_read(BUFFER->write);     \
+  uint32_t READ = atomic_acquire(BUFFER->read);         \
+  uint32_t WRITE ## _ = atomic_acquire(BUFFER->write);  \
   char FULL_R2 = WRITE ## _ >> 31;                      \
   uint32_t WRITE = WRITE ## _ & 0x7FFFFFFF;
 
+// In mirrored mode the data is mapped twice in a row, so we can treat
+// it as a plain ring and always hand out the full span. The read and
+// write pointers run modulo twice the size to tell full from empty.
+// Since each pointer is only ever advanced by its owner, each side
+// keeps a cached copy of the other's pointer and only reloads it
+// when the cached copy does not suffice, to avoid touching the
+// other side's cache line on every call.
+static inline uint32_t ring_used(uint32_t read, uint32_t write, struct bip *buffer){
+  return (read <= write)? write - read : write + 2*buffer->size - read;
+}
+
+static inline uint32_t ring_advance(uint32_t pointer, uint32_t size, struct bip *buffer){
+  pointer += size;
+  return (2*buffer->size <= pointer)? pointer - 2*buffer->size : pointer;
+}
+
+static inline int ring_request_write(uint32_t *off, uint32_t *size, struct bip *buffer){
+  uint32_t write = atomic_owned(buffer->write);
+  uint32_t available = buffer->size - ring_used(buffer->read_cache, write, buffer);
+  if(available < *size){
+    buffer->read_cache = atomic_acquire(buffer->read);
+    available = buffer->size - ring_used(buffer->read_cache, write, buffer);
+  }
+  if(available == 0){
+    *size = 0;
+    *off = 0;
+    return 0;
+  }
+  *size = MIN(*size, available);
+  *off = write % buffer->size;
+  buffer->reserved = *size;
+  return 1;
+}
+
+static inline int ring_finish_write(uint32_t size, struct bip *buffer){
+  if(buffer->reserved < size){
+    mixed_err(MIXED_BUFFER_OVERCOMMIT);
+    return 0;
+  }
+  atomic_release(buffer->write, ring_advance(atomic_owned(buffer->write), size, buffer));
+  buffer->reserved = 0;
+  return 1;
+}
+
+static inline int ring_request_read(uint32_t *off, uint32_t *size, struct bip *buffer){
+  uint32_t read = atomic_owned(buffer->read);
+  uint32_t available = ring_used(read, buffer->write_cache, buffer);
+  if(available < *size){
+    buffer->write_cache = atomic_acquire(buffer->write);
+    available = ring_used(read, buffer->write_cache, buffer);
+  }
+  if(available == 0){
+    *size = 0;
+    *off = 0;
+    return 0;
+  }
+  *size = MIN(*size, available);
+  *off = read % buffer->size;
+  return 1;
+}
+
+static inline int ring_finish_read(uint32_t size, struct bip *buffer){
+  uint32_t read = atomic_owned(buffer->read);
+  if(ring_used(read, buffer->write_cache, buffer) < size){
+    buffer->write_cache = atomic_acquire(buffer->write);
+    if(ring_used(read, buffer->write_cache, buffer) < size){
+      mixed_err(MIXED_BUFFER_OVERCOMMIT);
+      return 0;
+    }
+  }
+  atomic_release(buffer->read, ring_advance(read, size, buffer));
+  return 1;
+}
+
 static inline int bip_request_write(uint32_t *off, uint32_t *size, struct bip *buffer){
   mixed_err(MIXED_NO_ERROR);
+  if(buffer->flags & BIP_MIRRORED)
+    return ring_request_write(off, size, buffer);
   uint32_t to_write = *size;
   read_buffer_state(read, write, full_r2, buffer);
   // Check if we're waiting for read to catch up with a full second region
@@ -23,7 +101,7 @@ static inline int bip_request_write(uint32_t *off, uint32_t *size, struct bip *b
       *size = to_write;
       *off = 0;
       buffer->reserved = to_write;
-      atomic_write(buffer->write, 0x80000000);
+      atomic_release(buffer->write, 0x80000000);
     }else{ // Read has not done anything yet, no space!
       *size = 0;
       *off = 0;
@@ -44,20 +122,23 @@ static inline int bip_request_write(uint32_t *off, uint32_t *size, struct bip *b
 }
 
 static inline int bip_finish_write(uint32_t size, struct bip *buffer){
+  if(buffer->flags & BIP_MIRRORED)
+    return ring_finish_write(size, buffer);
   if(buffer->reserved < size){
     mixed_err(MIXED_BUFFER_OVERCOMMIT);
     return 0;
   }
- retry: {
-    uint32_t write = atomic_read(buffer->write);
-    if(!atomic_cas(buffer->write, write, write+size))
-      goto retry;
-  }
+  // The reader may clear the wrap bit concurrently, so we need to
+  // add atomically, but as the bit is never carried into, no CAS
+  // loop is needed.
+  atomic_add(buffer->write, size);
   buffer->reserved = 0;
   return 1;
 }
 
 static inline int bip_request_read(uint32_t *off, uint32_t *size, struct bip *buffer){
+  if(buffer->flags & BIP_MIRRORED)
+    return ring_request_read(off, size, buffer);
   read_buffer_state(read, write, full_r2, buffer);
   if(full_r2){
     uint32_t available = buffer->size - read;
@@ -67,13 +148,13 @@ static inline int bip_request_read(uint32_t *off, uint32_t *size, struct bip *bu
     }else if(0 < write){ // We are at the end and need to wrap now.
     retry:
       if(!atomic_cas(buffer->write, write_, write)){
-        write_ = atomic_read(buffer->write);
+        write_ = atomic_acquire(buffer->write);
         write = write_ & 0x7FFFFFFF;
         goto retry;
       }
       *size = MIN(*size, write);
       *off = 0;
-      atomic_write(buffer->read, 0);
+      atomic_release(buffer->read, 0);
     }else{ // Write has not done anything yet, no space!
       *size = 0;
       *off = 0;
@@ -91,20 +172,22 @@ static inline int bip_request_read(uint32_t *off, uint32_t *size, struct bip *bu
 }
 
 static inline int bip_finish_read(uint32_t size, struct bip *buffer){
+  if(buffer->flags & BIP_MIRRORED)
+    return ring_finish_read(size, buffer);
   read_buffer_state(read, write, full_r2, buffer);
   if(full_r2){
     if(buffer->size-read < size){
       mixed_err(MIXED_BUFFER_OVERCOMMIT);
       return 0;
     }else{
-      atomic_write(buffer->read, read+size);
+      atomic_release(buffer->read, read+size);
     }
   }else if(read<write){
     if(write-read < size){
       mixed_err(MIXED_BUFFER_OVERCOMMIT);
       return 0;
     }
-    atomic_write(buffer->read, read+size);
+    atomic_release(buffer->read, read+size);
   }else if(0 < size){
     mixed_err(MIXED_BUFFER_OVERCOMMIT);
     return 0;
@@ -112,7 +195,17 @@ static inline int bip_finish_read(uint32_t size, struct bip *buffer){
   return 1;
 }
 
+// The total number of elements stored, across both regions.
+static inline uint32_t bip_used(struct bip *buffer){
+  if(buffer->flags & BIP_MIRRORED)
+    return ring_used(atomic_acquire(buffer->read), atomic_acquire(buffer->write), buffer);
+  read_buffer_state(read, write, full_r2, buffer);
+  return full_r2? (buffer->size - read) + write : write - read;
+}
+
 static inline uint32_t bip_available_read(struct bip *buffer){
+  if(buffer->flags & BIP_MIRRORED)
+    return ring_used(atomic_acquire(buffer->read), atomic_acquire(buffer->write), buffer);
   read_buffer_state(read, write, full_r2, buffer);
   if(full_r2){
     if(read < buffer->size)
@@ -124,6 +217,8 @@ static inline uint32_t bip_available_read(struct bip *buffer){
 }
 
 static inline uint32_t bip_available_write(struct bip *buffer){
+  if(buffer->flags & BIP_MIRRORED)
+    return buffer->size - ring_used(atomic_acquire(buffer->read), atomic_acquire(buffer->write), buffer);
   read_buffer_state(read, write, full_r2, buffer);
   if(full_r2)
     return read - write;
@@ -1,5 +1,65 @@
 #include "internal.h"
 #include "bip.h"
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+static float *allocate_data(uint32_t *size, enum mixed_buffer_flags *flags){
+  if(*flags & MIXED_BUFFER_MIRRORED){
+    size_t bytes = *size*sizeof(float);
+    float *data = mirror_alloc(&bytes, (size_t)MIRROR_MAX_SIZE*sizeof(float));
+    if(data){
+      *size = bytes / sizeof(float);
+      return data;
+    }
+    // Mirroring is not supported, fall back to a regular buffer.
+    *flags &= ~MIXED_BUFFER_MIRRORED;
+  }
+  if(*flags & (MIXED_BUFFER_ALIGNED | MIXED_BUFFER_HUGEPAGES)){
+    size_t alignment = BUFFER_ALIGNMENT;
+    *size = ((*size + BUFFER_ALIGNMENT_SAMPLES - 1) / BUFFER_ALIGNMENT_SAMPLES) * BUFFER_ALIGNMENT_SAMPLES;
+    if((*flags & MIXED_BUFFER_HUGEPAGES) && HUGEPAGE_SIZE <= *size*sizeof(float))
+      alignment = HUGEPAGE_SIZE;
+    float *data = aligned_calloc(*size, sizeof(float), alignment);
+#ifdef MADV_HUGEPAGE
+    if(data && alignment == HUGEPAGE_SIZE)
+      madvise(data, (*size*sizeof(float)) & ~(size_t)(HUGEPAGE_SIZE-1), MADV_HUGEPAGE);
+#endif
+    return data;
+  }
+  return mixed_calloc(*size, sizeof(float));
+}
+
+static int check_size(uint32_t size, enum mixed_buffer_flags flags){
+  if((flags & MIXED_BUFFER_MIRRORED) && MIRROR_MAX_SIZE <= size){
+    mixed_err(MIXED_INVALID_VALUE);
+    return 0;
+  }
+  return 1;
+}
+
+static void free_data(float *data, uint32_t size, enum mixed_buffer_flags flags){
+  if(flags & MIXED_BUFFER_POOLED)
+    return;
+  if(flags & MIXED_BUFFER_MIRRORED)
+    mirror_free(data, size*sizeof(float));
+  else if(flags & (MIXED_BUFFER_ALIGNED | MIXED_BUFFER_HUGEPAGES))
+    aligned_free(data);
+  else
+    mixed_free(data);
+}
+
+// Storage that is handed between threads by staged resizes.
+struct buffer_storage{
+  float *data;
+  uint32_t size;
+  enum mixed_buffer_flags flags;
+};
+
+static void free_storage(struct buffer_storage *storage){
+  if(storage->data)
+    free_data(storage->data, storage->size, storage->flags);
+}
 
 MIXED_EXPORT int mixed_make_buffer(uint32_t size, struct mixed_buffer *buffer){
   mixed_err(MIXED_NO_ERROR);
@@ -7,7 +67,11 @@ MIXED_EXPORT int mixed_make_buffer(uint32_t size, struct mixed_buffer *buffer){
     mixed_err(MIXED_BUFFER_ALLOCATED);
     return 0;
   }
-  buffer->_data = calloc(size, sizeof(float));
+  if(!check_size(size, buffer->flags))
+    return 0;
+  if(buffer->flags & MIXED_BUFFER_HUGEPAGES)
+    buffer->flags |= MIXED_BUFFER_ALIGNED;
+  buffer->_data = allocate_data(&size, &buffer->flags);
   if(!buffer->_data){
     mixed_err(MIXED_OUT_OF_MEMORY);
     return 0;
@@ -19,10 +83,18 @@ MIXED_EXPORT int mixed_make_buffer(uint32_t size, struct mixed_buffer *buffer){
 
 MIXED_EXPORT void mixed_free_buffer(struct mixed_buffer *buffer){
   if(buffer->_data && !buffer->virtual)
-    free(buffer->_data);
+    free_data(buffer->_data, buffer->size, buffer->flags);
+  if(buffer->_staged){
+    free_storage(buffer->_staged);
+    mixed_free(buffer->_staged);
+    buffer->_staged = 0;
+  }
+  mixed_buffer_reclaim_resize(buffer);
   buffer->_data = 0;
   buffer->size = 0;
   buffer->virtual = 0;
+  // Keep the requested kind of storage for when the buffer is made again.
+  buffer->flags &= ~(MIXED_BUFFER_POOLED | MIXED_BUFFER_SHARED);
   mixed_buffer_clear(buffer);
 }
 
@@ -30,6 +102,8 @@ MIXED_EXPORT int mixed_buffer_clear(struct mixed_buffer *buffer){
   buffer->read = 0;
   buffer->write = 0;
   buffer->reserved = 0;
+  buffer->_read_cache = 0;
+  buffer->_write_cache = 0;
   return 1;
 }
 
@@ -69,9 +143,73 @@ MIXED_EXPORT uint32_t mixed_buffer_available_write(struct mixed_buffer *buffer){
   return bip_available_write((struct bip*)buffer);
 }
 
+MIXED_EXPORT int mixed_buffer_group_request(float **in_areas, float **out_areas, uint32_t *frames, struct mixed_buffer_group *group){
+  uint32_t size = *frames;
+  for(uint32_t i=0; i<group->ins; ++i){
+    struct mixed_buffer *buffer = group->in[i];
+    uint32_t off = 0;
+    in_areas[i] = 0;
+    if(buffer){
+      bip_request_read(&off, &size, (struct bip*)buffer);
+      in_areas[i] = buffer->_data+off;
+    }
+  }
+  for(uint32_t i=0; i<group->outs; ++i){
+    struct mixed_buffer *buffer = group->out[i];
+    uint32_t off = 0;
+    out_areas[i] = 0;
+    if(buffer){
+      bip_request_write(&off, &size, (struct bip*)buffer);
+      out_areas[i] = buffer->_data+off;
+    }
+  }
+  *frames = size;
+  return 0 < size;
+}
+
+MIXED_EXPORT int mixed_buffer_group_finish(uint32_t frames, struct mixed_buffer_group *group){
+  int result = 1;
+  for(uint32_t i=0; i<group->ins; ++i){
+    if(group->in[i] && !bip_finish_read(frames, (struct bip*)group->in[i]))
+      result = 0;
+  }
+  for(uint32_t i=0; i<group->outs; ++i){
+    if(group->out[i] && !bip_finish_write(frames, (struct bip*)group->out[i]))
+      result = 0;
+  }
+  return result;
+}
+
+// We can only hand the array over if both buffers opted in, nobody
+// else refers to it, and the two buffers are interchangeable. Since
+// the target is empty, the source simply takes over its empty array
+// in exchange.
+static int forward_data(struct mixed_buffer *from, struct mixed_buffer *to){
+  if(from->virtual || to->virtual || !from->_data || !to->_data)
+    return 0;
+  if(from->size != to->size || from->flags != to->flags)
+    return 0;
+  if(!(from->flags & MIXED_BUFFER_FORWARD))
+    return 0;
+  if(from->flags & (MIXED_BUFFER_POOLED | MIXED_BUFFER_SHARED))
+    return 0;
+  if(from->reserved || to->reserved || bip_used((struct bip*)to) || !bip_used((struct bip*)from))
+    return 0;
+
+  float *data = to->_data;
+  to->_data = from->_data;
+  to->read = from->read;
+  to->write = from->write;
+  to->_read_cache = from->read;
+  to->_write_cache = from->write;
+  from->_data = data;
+  mixed_buffer_clear(from);
+  return 1;
+}
+
 MIXED_EXPORT int mixed_buffer_transfer(struct mixed_buffer *from, struct mixed_buffer *to){
   mixed_err(MIXED_NO_ERROR);
-  if(from != to){
+  if(from != to && !forward_data(from, to)){
     float *read, *write;
     uint32_t samples = UINT32_MAX;
     mixed_buffer_request_read(&read, &samples, from);
@@ -96,14 +234,114 @@ MIXED_EXPORT int mixed_buffer_copy(struct mixed_buffer *from, struct mixed_buffe
   return 1;
 }
 
+// Copy the unread data to the front of the target, oldest first.
+static uint32_t linearize(float *target, uint32_t size, struct mixed_buffer *buffer){
+  uint32_t samples;
+  if(buffer->flags & MIXED_BUFFER_MIRRORED){
+    samples = MIN(size, bip_used((struct bip*)buffer));
+    memcpy(target, buffer->_data+(buffer->read % buffer->size), samples*sizeof(float));
+  }else{
+    read_buffer_state(read, write, full_r2, buffer);
+    if(full_r2){
+      samples = MIN(size, buffer->size - read);
+      memcpy(target, buffer->_data+read, samples*sizeof(float));
+      uint32_t rest = MIN(size - samples, write);
+      memcpy(target+samples, buffer->_data, rest*sizeof(float));
+      samples += rest;
+    }else{
+      samples = MIN(size, write - read);
+      memcpy(target, buffer->_data+read, samples*sizeof(float));
+    }
+  }
+  return samples;
+}
+
+// Move the buffer onto the new storage, and leave the old storage
+// in its place.
+static void replace_storage(struct buffer_storage *storage, struct mixed_buffer *buffer){
+  uint32_t samples = linearize(storage->data, storage->size, buffer);
+  float *data = buffer->_data;
+  uint32_t size = buffer->size;
+  enum mixed_buffer_flags flags = buffer->flags;
+  buffer->_data = storage->data;
+  buffer->size = storage->size;
+  buffer->flags = storage->flags;
+  mixed_buffer_clear(buffer);
+  buffer->write = samples;
+  buffer->_write_cache = samples;
+  storage->data = data;
+  storage->size = size;
+  storage->flags = flags;
+}
+
 MIXED_EXPORT int mixed_buffer_resize(uint32_t size, struct mixed_buffer *buffer){
   mixed_err(MIXED_NO_ERROR);
-  float *new = realloc(buffer->_data, size*sizeof(float));
-  if(!new){
+  if(buffer->virtual || (buffer->flags & MIXED_BUFFER_POOLED)){
+    // We do not own the storage, or the pool's blocks have a fixed size.
+    mixed_err(MIXED_INVALID_VALUE);
+    return 0;
+  }
+  if(!check_size(size, buffer->flags))
+    return 0;
+  struct buffer_storage storage = {0, size, buffer->flags};
+  storage.data = allocate_data(&storage.size, &storage.flags);
+  if(!storage.data){
     mixed_err(MIXED_OUT_OF_MEMORY);
     return 0;
   }
-  buffer->_data = new;
-  buffer->size = size;
+  replace_storage(&storage, buffer);
+  free_storage(&storage);
+  return 1;
+}
+
+MIXED_EXPORT int mixed_buffer_stage_resize(uint32_t size, struct mixed_buffer *buffer){
+  mixed_err(MIXED_NO_ERROR);
+  if(buffer->virtual || (buffer->flags & MIXED_BUFFER_POOLED)){
+    mixed_err(MIXED_INVALID_VALUE);
+    return 0;
+  }
+  if(!check_size(size, buffer->flags))
+    return 0;
+  // Apply publishes the retired storage before it clears the staged
+  // one, so once we see no staged storage, we also see the retired.
+  if(atomic_acquire(buffer->_staged)){
+    mixed_err(MIXED_BUFFER_ALLOCATED);
+    return 0;
+  }
+  mixed_buffer_reclaim_resize(buffer);
+  struct buffer_storage *storage = mixed_calloc(1, sizeof(struct buffer_storage));
+  if(!storage){
+    mixed_err(MIXED_OUT_OF_MEMORY);
+    return 0;
+  }
+  storage->size = size;
+  storage->flags = buffer->flags;
+  storage->data = allocate_data(&storage->size, &storage->flags);
+  if(!storage->data){
+    mixed_free(storage);
+    mixed_err(MIXED_OUT_OF_MEMORY);
+    return 0;
+  }
+  atomic_release(buffer->_staged, storage);
+  return 1;
+}
+
+MIXED_EXPORT int mixed_buffer_apply_resize(struct mixed_buffer *buffer){
+  mixed_err(MIXED_NO_ERROR);
+  struct buffer_storage *storage = atomic_acquire(buffer->_staged);
+  if(!storage) return 0;
+  replace_storage(storage, buffer);
+  atomic_release(buffer->_retired, storage);
+  atomic_release(buffer->_staged, (void*)0);
+  return 1;
+}
+
+MIXED_EXPORT int mixed_buffer_reclaim_resize(struct mixed_buffer *buffer){
+  mixed_err(MIXED_NO_ERROR);
+  struct buffer_storage *storage = atomic_exchange(buffer->_retired, (void*)0);
+  if(storage){
+    free_storage(storage);
+    mixed_free(storage);
+  }
   return 1;
 }
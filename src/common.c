@@ -3,6 +3,16 @@
 #else
 #  include <windows.h>
 #endif
+#ifndef _WIN32
+#  include <sched.h>
+#  include <pthread.h>
+#endif
+#ifdef __linux__
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/syscall.h>
+#  include <linux/futex.h>
+#endif
 #include "internal.h"
 
 MIXED_EXPORT uint8_t mixed_samplesize(enum mixed_encoding encoding){
@@ -17,6 +27,14 @@ MIXED_EXPORT uint8_t mixed_samplesize(enum mixed_encoding encoding){
   case MIXED_UINT32: return 4;
   case MIXED_FLOAT: return 4;
   case MIXED_DOUBLE: return 8;
+  case MIXED_INT16_BE: return 2;
+  case MIXED_INT24_BE: return 3;
+  case MIXED_INT32_BE: return 4;
+  case MIXED_INT24_32: return 4;
+  case MIXED_INT20: return 3;
+  case MIXED_MULAW: return 1;
+  case MIXED_ALAW: return 1;
+  case MIXED_IMA_ADPCM: return 0;
   default: return -1;
   }
 }
@@ -89,6 +107,12 @@ MIXED_EXPORT char *mixed_error_string(int code){
     return "A segment with the requested name had already been registered.";
   case MIXED_BAD_SEGMENT:
     return "A segment with the requested name is not registered.";
+  case MIXED_MAPPING_FAILED:
+    return "The file could not be opened or mapped into memory.";
+  case MIXED_GRAPH_CYCLE:
+    return "The connections of a graph segment form a cycle.";
+  case MIXED_BUFFER_DROPPED:
+    return "The data being read was dropped by the writer.";
   default:
     return "Unknown error code.";
   }
@@ -118,6 +142,22 @@ MIXED_EXPORT char *mixed_type_string(int code){
     return "float";
   case MIXED_DOUBLE:
     return "double";
+  case MIXED_INT16_BE:
+    return "int16 big-endian";
+  case MIXED_INT24_BE:
+    return "int24 big-endian";
+  case MIXED_INT32_BE:
+    return "int32 big-endian";
+  case MIXED_INT24_32:
+    return "int24 in int32";
+  case MIXED_INT20:
+    return "int20";
+  case MIXED_MULAW:
+    return "mu-law";
+  case MIXED_ALAW:
+    return "a-law";
+  case MIXED_IMA_ADPCM:
+    return "ima adpcm";
   case MIXED_BOOL:
     return "bool";
   case MIXED_SIZE_T:
@@ -156,6 +196,12 @@ MIXED_EXPORT char *mixed_type_string(int code){
     return "error";
   case MIXED_RESAMPLE_TYPE_ENUM:
     return "resample type";
+  case MIXED_MULTIBUFFER_POINTER:
+    return "multibuffer pointer";
+  case MIXED_DITHER_TYPE_ENUM:
+    return "dither type";
+  case MIXED_CHANNEL_MAP_POINTER:
+    return "channel map pointer";
   default:
     return "unknown";
   }
@@ -165,16 +211,298 @@ MIXED_EXPORT char *mixed_version(){
   return MIXED_VERSION;
 }
 
+static void *default_calloc(size_t count, size_t size, void *user){
+  IGNORE(user);
+  return calloc(count, size);
+}
+
+static void *default_realloc(void *ptr, size_t size, void *user){
+  IGNORE(user);
+  return realloc(ptr, size);
+}
+
+static void default_free(void *ptr, void *user){
+  IGNORE(user);
+  free(ptr);
+}
+
+static struct mixed_allocator default_allocator = {default_calloc, default_realloc, default_free, 0};
+thread_local struct mixed_allocator *allocator = &default_allocator;
+
+// Every allocation is prefixed by a header that remembers which
+// allocator it came from, so that it can be freed correctly even
+// after the current allocator was changed.
+struct allocation{
+  struct mixed_allocator *allocator;
+  size_t size;
+};
+
+MIXED_EXPORT int mixed_set_allocator(struct mixed_allocator *new){
+  mixed_err(MIXED_NO_ERROR);
+  if(new && (!new->calloc || !new->free)){
+    mixed_err(MIXED_INVALID_VALUE);
+    return 0;
+  }
+  allocator = (new)? new : &default_allocator;
+  return 1;
+}
+
+MIXED_EXPORT struct mixed_allocator *mixed_get_allocator(){
+  return allocator;
+}
+
+void *mixed_calloc(size_t count, size_t size){
+  if(size && (SIZE_MAX - sizeof(struct allocation)) / size < count) return 0;
+  size_t bytes = count*size;
+  struct allocation *header = allocator->calloc(1, sizeof(struct allocation)+bytes, allocator->user);
+  if(!header) return 0;
+  header->allocator = allocator;
+  header->size = bytes;
+  return header+1;
+}
+
+void *mixed_realloc(void *ptr, size_t size){
+  if(!ptr) return mixed_calloc(1, size);
+  struct allocation *header = ((struct allocation *)ptr)-1;
+  struct mixed_allocator *owner = header->allocator;
+  if(owner->realloc){
+    header = owner->realloc(header, sizeof(struct allocation)+size, owner->user);
+    if(!header) return 0;
+    header->size = size;
+    return header+1;
+  }else{
+    struct allocation *new = owner->calloc(1, sizeof(struct allocation)+size, owner->user);
+    if(!new) return 0;
+    memcpy(new+1, header+1, MIN(size, header->size));
+    new->allocator = owner;
+    new->size = size;
+    owner->free(header, owner->user);
+    return new+1;
+  }
+}
+
+void mixed_free(void *ptr){
+  if(ptr){
+    struct allocation *header = ((struct allocation *)ptr)-1;
+    header->allocator->free(header, header->allocator->user);
+  }
+}
+
+static void *arena_calloc(size_t count, size_t size, void *user){
+  struct mixed_arena *arena = (struct mixed_arena *)user;
+  // A wrapped product would hand out a short block.
+  if(size && arena->size / size < count) return 0;
+  // Keep everything 16 byte aligned like malloc would.
+  size_t bytes = (count*size + 15) & ~(size_t)15;
+  size_t start = __atomic_fetch_add(&arena->used, bytes, __ATOMIC_RELAXED);
+  if(arena->size < start+bytes){
+    __atomic_fetch_sub(&arena->used, bytes, __ATOMIC_RELAXED);
+    return 0;
+  }
+  // Memory may be handed out again after a reset, so clear it.
+  memset(arena->_data+start, 0, bytes);
+  return arena->_data+start;
+}
+
+static void arena_free(void *ptr, void *user){
+  IGNORE(ptr, user);
+}
+
+MIXED_EXPORT int mixed_make_arena(size_t size, struct mixed_arena *arena){
+  mixed_err(MIXED_NO_ERROR);
+  arena->_data = aligned_calloc(size, 1, 16);
+  if(!arena->_data){
+    mixed_err(MIXED_OUT_OF_MEMORY);
+    return 0;
+  }
+  arena->size = size;
+  arena->used = 0;
+  arena->allocator.calloc = arena_calloc;
+  arena->allocator.realloc = 0;
+  arena->allocator.free = arena_free;
+  arena->allocator.user = arena;
+  return 1;
+}
+
+MIXED_EXPORT void mixed_free_arena(struct mixed_arena *arena){
+  if(allocator == &arena->allocator)
+    allocator = &default_allocator;
+  if(arena->_data)
+    aligned_free(arena->_data);
+  arena->_data = 0;
+  arena->size = 0;
+  arena->used = 0;
+}
+
+MIXED_EXPORT int mixed_arena_reset(struct mixed_arena *arena){
+  arena->used = 0;
+  return 1;
+}
+
 void *crealloc(void *ptr, size_t oldcount, size_t newcount, size_t size){
   size_t newsize = newcount*size;
   size_t oldsize = oldcount*size;
-  ptr = realloc(ptr, newsize);
+  ptr = mixed_realloc(ptr, newsize);
   if(ptr && oldsize < newsize){
     memset(((char*)ptr)+oldsize, 0, newsize-oldsize);
   }
   return ptr;
 }
 
+// We over-allocate and stash the original pointer right before the
+// aligned block, so that this works with any underlying allocator.
+void *aligned_calloc(size_t count, size_t size, size_t alignment){
+  size_t bytes = count*size;
+  char *base = mixed_calloc(1, bytes + alignment + sizeof(void *));
+  if(!base) return 0;
+  uintptr_t start = (uintptr_t)(base + sizeof(void *));
+  char *aligned = (char *)((start + alignment - 1) & ~(uintptr_t)(alignment - 1));
+  ((void **)aligned)[-1] = base;
+  return aligned;
+}
+
+void aligned_free(void *ptr){
+  if(ptr)
+    mixed_free(((void **)ptr)[-1]);
+}
+
+// Map the same pages twice, back to back, so that any span of up to
+// bytes length starting within the first mapping is contiguous. The
+// size rounded to pages must stay below limit.
+void *mirror_alloc(size_t *bytes, size_t limit){
+#if defined(__linux__) && defined(SYS_memfd_create)
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t size = ((*bytes + page - 1) / page) * page;
+  if(limit <= size) return 0;
+  unsigned char *base = MAP_FAILED;
+  // We go through syscall as the memfd_create wrapper is too recent.
+  int fd = syscall(SYS_memfd_create, "mixed-mirror", 1);
+  if(fd < 0) return 0;
+  if(ftruncate(fd, size) < 0) goto cleanup;
+  base = mmap(0, 2*size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if(base == MAP_FAILED) goto cleanup;
+  if(mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED
+     || mmap(base+size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED){
+    munmap(base, 2*size);
+    goto cleanup;
+  }
+  close(fd);
+  *bytes = size;
+  return base;
+
+ cleanup:
+  close(fd);
+  return 0;
+#else
+  IGNORE(bytes, limit);
+  return 0;
+#endif
+}
+
+void mirror_free(void *ptr, size_t bytes){
+#if defined(__linux__) && defined(SYS_memfd_create)
+  if(ptr)
+    munmap(ptr, 2*bytes);
+#else
+  IGNORE(ptr, bytes);
+#endif
+}
+
+uint64_t monotonic_ms(){
+#ifdef _WIN32
+  return GetTickCount64();
+#else
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (uint64_t)time.tv_sec*1000 + time.tv_nsec/1000000;
+#endif
+}
+
+// Without futexes we fall back to polling at a fine interval.
+void futex_wait(uint32_t *word, uint32_t value, int32_t timeout){
+#if defined(__linux__) && defined(SYS_futex)
+  struct timespec time = {0};
+  if(0 <= timeout){
+    time.tv_sec = timeout / 1000;
+    time.tv_nsec = (timeout % 1000) * 1000000;
+  }
+  syscall(SYS_futex, word, FUTEX_WAIT_PRIVATE, value, (0 <= timeout)? &time : 0, 0, 0);
+#else
+  if(__atomic_load_n(word, __ATOMIC_ACQUIRE) != value || timeout == 0)
+    return;
+#ifdef _WIN32
+  Sleep(1);
+#else
+  struct timespec time = {0, 100000};
+  nanosleep(&time, 0);
+#endif
+#endif
+}
+
+void thread_yield(){
+#ifdef _WIN32
+  SwitchToThread();
+#else
+  sched_yield();
+#endif
+}
+
+void futex_wake(uint32_t *word){
+#if defined(__linux__) && defined(SYS_futex)
+  syscall(SYS_futex, word, FUTEX_WAKE_PRIVATE, INT32_MAX, 0, 0, 0);
+#else
+  IGNORE(word);
+#endif
+}
+
+#ifdef _WIN32
+struct thread_start{
+  void *(*function)(void *);
+  void *argument;
+};
+
+static DWORD WINAPI thread_trampoline(LPVOID argument){
+  struct thread_start start = *(struct thread_start *)argument;
+  mixed_free(argument);
+  start.function(start.argument);
+  return 0;
+}
+#endif
+
+int thread_create(void **thread, void *(*function)(void *), void *argument){
+#ifdef _WIN32
+  struct thread_start *start = mixed_calloc(1, sizeof(struct thread_start));
+  if(!start) return 0;
+  start->function = function;
+  start->argument = argument;
+  HANDLE handle = CreateThread(0, 0, thread_trampoline, start, 0, 0);
+  if(!handle){
+    mixed_free(start);
+    return 0;
+  }
+  *thread = handle;
+#else
+  pthread_t *handle = mixed_calloc(1, sizeof(pthread_t));
+  if(!handle) return 0;
+  if(pthread_create(handle, 0, function, argument) != 0){
+    mixed_free(handle);
+    return 0;
+  }
+  *thread = handle;
+#endif
+  return 1;
+}
+
+void thread_join(void *thread){
+#ifdef _WIN32
+  WaitForSingleObject(thread, INFINITE);
+  CloseHandle(thread);
+#else
+  pthread_join(*(pthread_t *)thread, 0);
+  mixed_free(thread);
+#endif
+}
+
 void set_info_field(struct mixed_segment_field_info *info, uint32_t field, enum mixed_segment_field_type type, uint32_t count, enum mixed_segment_info_flags flags, char*description){
   info->field = field;
   info->description = description;
@@ -6,6 +6,7 @@ MIXED_EXPORT extern inline float mixed_from_int8(int8_t sample);
 MIXED_EXPORT extern inline float mixed_from_uint8(uint8_t sample);
 MIXED_EXPORT extern inline float mixed_from_int16(int16_t sample);
 MIXED_EXPORT extern inline float mixed_from_uint16(uint16_t sample);
+MIXED_EXPORT extern inline float mixed_from_int20(int20_t sample);
 MIXED_EXPORT extern inline float mixed_from_int24(int24_t sample);
 MIXED_EXPORT extern inline float mixed_from_uint24(uint24_t sample);
 MIXED_EXPORT extern inline float mixed_from_int32(int32_t sample);
@@ -16,6 +17,7 @@ MIXED_EXPORT extern inline int8_t mixed_to_int8(float sample);
 MIXED_EXPORT extern inline uint8_t mixed_to_uint8(float sample);
 MIXED_EXPORT extern inline int16_t mixed_to_int16(float sample);
 MIXED_EXPORT extern inline uint16_t mixed_to_uint16(float sample);
+MIXED_EXPORT extern inline int20_t mixed_to_int20(float sample);
 MIXED_EXPORT extern inline int24_t mixed_to_int24(float sample);
 MIXED_EXPORT extern inline uint24_t mixed_to_uint24(float sample);
 MIXED_EXPORT extern inline int32_t mixed_to_int32(float sample);
@@ -4,6 +4,10 @@
 typedef int32_t int24_t;
 typedef uint32_t uint24_t;
 
+#define INT20_MAX 524287
+#define INT20_MIN -524288
+typedef int32_t int20_t;
+
 __attribute__((always_inline))
 MIXED_EXPORT inline float mixed_from_float(float sample){
   return (1.0f<sample)? 1.0f
@@ -42,6 +46,13 @@ MIXED_EXPORT inline float mixed_from_uint16(uint16_t sample){
   return ((float)sample)/((float)UINT16_MAX/2)-1;
 }
 
+__attribute__((always_inline))
+MIXED_EXPORT inline float mixed_from_int20(int20_t sample){
+  return (sample < 0)
+    ? -(sample/(float)INT20_MIN)
+    : +(sample/(float)INT20_MAX);
+}
+
 __attribute__((always_inline))
 MIXED_EXPORT inline float mixed_from_int24(int24_t sample){
   return (sample < 0)
@@ -108,6 +119,13 @@ MIXED_EXPORT inline uint16_t mixed_to_uint16(float sample){
     : 0;
 }
 
+__attribute__((always_inline))
+MIXED_EXPORT inline int20_t mixed_to_int20(float sample){
+  return (1.0f<=sample)? INT20_MAX
+    : (-1.0f<=sample)? sample*0x80000
+    : INT20_MIN;
+}
+
 __attribute__((always_inline))
 MIXED_EXPORT inline int24_t mixed_to_int24(float sample){
   return (1.0f<=sample)? INT24_MAX
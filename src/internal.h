@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <time.h>
 #include "mixed.h"
 #ifdef __RDRND__
@@ -22,6 +23,9 @@
 # endif
 #endif
 #define BASE_VECTOR_SIZE 32
+#define BUFFER_ALIGNMENT 64
+#define BUFFER_ALIGNMENT_SAMPLES (BUFFER_ALIGNMENT/sizeof(float))
+#define HUGEPAGE_SIZE (2*1024*1024)
 
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
@@ -42,14 +46,33 @@ static inline void __ignore(char _, ...){(void)_;}
 #define VECTORIZE
 #endif
 
+// Must be layout-compatible with mixed_buffer and mixed_pack.
 struct bip{
   void *data;
   uint32_t size;
+  uint32_t flags;
+  char _pad0[MIXED_CACHE_LINE - sizeof(void *) - 2*sizeof(uint32_t)];
   uint32_t read;
+  uint32_t write_cache;
+  char _pad1[MIXED_CACHE_LINE - 2*sizeof(uint32_t)];
   uint32_t write;
   uint32_t reserved;
+  uint32_t read_cache;
+  char _pad2[MIXED_CACHE_LINE - 3*sizeof(uint32_t)];
 };
 
+#define BIP_CHECK_LAYOUT(TYPE)                                          \
+  typedef char bip_layout_##TYPE[(offsetof(struct bip, read) == offsetof(struct TYPE, read) \
+                                  && offsetof(struct bip, write) == offsetof(struct TYPE, write) \
+                                  && offsetof(struct bip, read_cache) == offsetof(struct TYPE, _read_cache) \
+                                  && offsetof(struct bip, flags) == offsetof(struct TYPE, flags))? 1 : -1];
+BIP_CHECK_LAYOUT(mixed_buffer)
+BIP_CHECK_LAYOUT(mixed_pack)
+BIP_CHECK_LAYOUT(mixed_multibuffer)
+
+// Shared by MIXED_BUFFER_MIRRORED and MIXED_PACK_MIRRORED.
+#define BIP_MIRRORED 0x8
+
 struct vector{
   void **data;
   uint32_t count;
@@ -103,7 +126,114 @@ int mix_noop(struct mixed_segment *segment);
 
 void mixed_err(int errorcode);
 
+void *mixed_calloc(size_t count, size_t size);
+void *mixed_realloc(void *ptr, size_t size);
+void mixed_free(void *ptr);
 void *crealloc(void *ptr, size_t oldcount, size_t newcount, size_t size);
+void *aligned_calloc(size_t count, size_t size, size_t alignment);
+void aligned_free(void *ptr);
+// Mirrored rings count positions modulo twice their size in 32 bits,
+// so their size in elements must stay below this.
+#define MIRROR_MAX_SIZE 0x80000000u
+void *mirror_alloc(size_t *bytes, size_t limit);
+void mirror_free(void *ptr, size_t bytes);
+uint64_t monotonic_ms();
+void futex_wait(uint32_t *word, uint32_t value, int32_t timeout);
+void futex_wake(uint32_t *word);
+void thread_yield();
+int thread_create(void **thread, void *(*function)(void *), void *argument);
+void thread_join(void *thread);
+
+static inline int is_aligned(const void *ptr){
+  return ((uintptr_t)ptr % BUFFER_ALIGNMENT) == 0;
+}
+
+// G.711 companding tables, see transfer.c. The decoding tables map
+// every code to its sample, the encoding tables map int16 samples
+// shifted down to the resolution of the codec to their code.
+extern float mulaw_decode_table[256];
+extern float alaw_decode_table[256];
+extern uint8_t mulaw_encode_table[1 << 14];
+extern uint8_t alaw_encode_table[1 << 13];
+
+static inline uint8_t mulaw_encode(int16_t sample){
+  return mulaw_encode_table[(sample >> 2) + (1 << 13)];
+}
+
+static inline uint8_t alaw_encode(int16_t sample){
+  return alaw_encode_table[(sample >> 3) + (1 << 12)];
+}
+
+// IMA ADPCM blocks, see adpcm.c. The frames are interleaved floats.
+void adpcm_decode_block(uint8_t *block, channel_t channels, float *out);
+void adpcm_encode_block(float *in, channel_t channels, uint8_t *block);
+
+// Block-coded encodings hold a fixed number of frames per block
+// rather than a fixed number of bytes per sample. These give the
+// smallest whole unit of a pack in bytes and in frames.
+static inline uint32_t pack_unit_bytes(struct mixed_pack *pack){
+  if(pack->encoding == MIXED_IMA_ADPCM)
+    return MIXED_ADPCM_BLOCK_SIZE*pack->channels;
+  // Planar packs count positions within a single plane.
+  if(pack->flags & MIXED_PACK_PLANAR)
+    return mixed_samplesize(pack->encoding);
+  return mixed_samplesize(pack->encoding)*pack->channels;
+}
+
+static inline uint32_t pack_unit_frames(struct mixed_pack *pack){
+  return (pack->encoding == MIXED_IMA_ADPCM)? MIXED_ADPCM_BLOCK_FRAMES : 1;
+}
+
+// Vectorised conversion between an interleaved pack and one float
+// array per channel, see kernels.c. They process as many whole
+// blocks of frames as fit and return the number of frames done,
+// leaving the rest to the scalar transfer functions. The lookups
+// return 0 if there is no kernel for the combination.
+typedef uint32_t (*mixed_deinterleave_function)(void *in, float **outs, channel_t channels, uint32_t frames, float volume);
+typedef uint32_t (*mixed_interleave_function)(float **ins, void *out, channel_t channels, uint32_t frames, float volume);
+mixed_deinterleave_function deinterleave_kernel(enum mixed_encoding encoding, channel_t channels);
+mixed_interleave_function interleave_kernel(enum mixed_encoding encoding, channel_t channels);
+
+// Dither state for one channel. Every vector lane draws from its
+// own xorshift generator, so that the kernels need not serialise
+// on a single random sequence.
+#define DITHER_LANES 16
+struct dither_channel{
+  uint32_t rng[DITHER_LANES];
+  float error;
+};
+
+static inline uint32_t dither_xorshift(uint32_t x){
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
+void dither_seed(struct dither_channel *channel, uint32_t seed);
+int dither_applies(enum mixed_encoding encoding);
+float dither_array_to(float *in, uint32_t in_stride, void *out, uint32_t out_stride, uint32_t samples, float volume, float target_volume, enum mixed_encoding encoding, enum mixed_dither_type type, struct dither_channel *state);
+// Like mixed_buffer_from_pack and mixed_buffer_to_pack, but only
+// for the count pack channels listed in map, in that order. A null
+// map selects all channels in order. Pack channels that are not
+// selected are skipped when reading and silenced when writing.
+int buffer_from_pack(struct mixed_pack *in, struct mixed_buffer **outs, channel_t *map, channel_t count, float *volume, float target_volume);
+int buffer_to_pack(struct mixed_buffer **ins, struct mixed_pack *out, channel_t *map, channel_t count, float *volume, float target_volume, enum mixed_dither_type dither, struct dither_channel *state);
+// Convert between frames of the pack's data starting at the given
+// area and separate float arrays, with volume ramping and channel
+// selection as above. The encoding must have a translator.
+void unpack_frames(struct mixed_pack *pack, char *in, channel_t *map, channel_t count, float **outs, uint32_t frames, float *volume, float target_volume);
+void pack_frames(float **ins, struct mixed_pack *pack, char *out, channel_t *map, channel_t count, uint32_t frames, float *volume, float target_volume, enum mixed_dither_type dither, struct dither_channel *state);
+// Like mixed_pack_convert, but output channel c draws from input
+// channel map[c]. Output channels past count are silent. A null map
+// uses the default layout of mixed_pack_convert.
+int pack_convert(struct mixed_pack *in, struct mixed_pack *out, channel_t *map, channel_t count, float *volume, float target_volume);
+// The volume the ramp reaches after the given number of frames.
+float ramp_volume(float volume, float target_volume, uint32_t frames);
+// Like mixed_interleave_function but with TPDF dither added before
+// rounding to the nearest step.
+typedef uint32_t (*mixed_dither_interleave_function)(float **ins, void *out, uint32_t frames, float volume, struct dither_channel *dither);
+mixed_dither_interleave_function dither_interleave_kernel(enum mixed_encoding encoding, channel_t channels);
 
 void *open_library(char *file);
 void close_library(void *handle);
@@ -125,3 +255,11 @@ extern float (*mixed_random)();
 #define atomic_read(PLACE) __atomic_load_n(&PLACE, __ATOMIC_SEQ_CST)
 #define atomic_write(PLACE, VAL) __atomic_store_n(&PLACE, VAL, __ATOMIC_SEQ_CST)
 #define atomic_cas(PLACE, OLD, NEW) __sync_bool_compare_and_swap(&PLACE, OLD, NEW)
+// Weaker orderings for the single-producer single-consumer buffers.
+#define atomic_acquire(PLACE) __atomic_load_n(&PLACE, __ATOMIC_ACQUIRE)
+#define atomic_release(PLACE, VAL) __atomic_store_n(&PLACE, VAL, __ATOMIC_RELEASE)
+#define atomic_owned(PLACE) __atomic_load_n(&PLACE, __ATOMIC_RELAXED)
+#define atomic_add(PLACE, VAL) __atomic_fetch_add(&PLACE, VAL, __ATOMIC_RELEASE)
+#define atomic_exchange(PLACE, VAL) __atomic_exchange_n(&PLACE, VAL, __ATOMIC_ACQ_REL)
+#define atomic_increment(PLACE) __atomic_add_fetch(&PLACE, 1, __ATOMIC_SEQ_CST)
+#define atomic_decrement(PLACE) __atomic_sub_fetch(&PLACE, 1, __ATOMIC_SEQ_CST)
@@ -0,0 +1,570 @@
+#include "internal.h"
+
+//// Vectorised (de)interleaving transfer kernels
+// Every kernel converts a run of frames between an interleaved pack
+// encoding and one float array per channel. Frames are processed in
+// groups of four per 128 bit lane. Four frames of C channels occupy
+// exactly C vectors of four samples each, which are converted on
+// load, and then shuffled into (or out of) one vector per channel.
+// Since all shuffles used stay within their 128 bit lane, the same
+// network works on every vector width, with each lane holding the
+// next group of four frames.
+//
+// Only the SSE set is dispatched for now. Wider sets that assemble
+// their lanes from SSE conversions did not reliably beat it, so one
+// should only be added together with real wide loads and a benchmark.
+//
+// The conversions match the scalar functions in encoding.h exactly,
+// so that it does not matter which path a frame takes.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE4_2__)
+#include <immintrin.h>
+
+//// Conversion of four samples
+static inline __m128 clamp_unit(__m128 v){
+  // MAXPS returns the second operand for NaN, so NaN clamps to -1
+  // just like in the scalar functions.
+  return _mm_min_ps(_mm_max_ps(v, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+}
+
+//// Byte shuffles
+// Samples that are not a native little-endian word are rearranged
+// with a byte shuffle into (or out of) one 32 bit word per sample.
+#define SWAP16 _mm_setr_epi8(1,0, 3,2, 5,4, 7,6, 9,8, 11,10, 13,12, 15,14)
+#define SWAP32 _mm_setr_epi8(3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12)
+#define SPREAD24 _mm_setr_epi8(0,1,2,-1, 3,4,5,-1, 6,7,8,-1, 9,10,11,-1)
+#define SPREAD24_BE _mm_setr_epi8(2,1,0,-1, 5,4,3,-1, 8,7,6,-1, 11,10,9,-1)
+#define GATHER24 _mm_setr_epi8(0,1,2, 4,5,6, 8,9,10, 12,13,14, -1,-1,-1,-1)
+#define GATHER24_BE _mm_setr_epi8(2,1,0, 6,5,4, 10,9,8, 14,13,12, -1,-1,-1,-1)
+
+// Four packed samples take twelve bytes, which must be accessed
+// exactly so as not to run over the end of the pack.
+static inline __m128i load_packed(char *p){
+  int32_t last;
+  memcpy(&last, p+8, sizeof(last));
+  return _mm_insert_epi32(_mm_loadl_epi64((__m128i *)p), last, 2);
+}
+
+static inline void store_packed(char *p, __m128i i){
+  int32_t last = _mm_extract_epi32(i, 2);
+  _mm_storel_epi64((__m128i *)p, i);
+  memcpy(p+8, &last, sizeof(last));
+}
+
+static inline __m128i sign_extend(__m128i i, int bits){
+  return _mm_srai_epi32(_mm_slli_epi32(i, 32-bits), 32-bits);
+}
+
+//// Conversion of four samples
+static inline __m128 int_to_unit(__m128i i, float max, float min){
+  __m128 v = _mm_cvtepi32_ps(i);
+  // Dividing by the power of two minimum is exact as a multiplication.
+  return _mm_blendv_ps(_mm_div_ps(v, _mm_set1_ps(max)), _mm_mul_ps(v, _mm_set1_ps(-1.0f/min)), v);
+}
+
+static inline __m128 chunk_from_int16(char *p){
+  return int_to_unit(_mm_cvtepi16_epi32(_mm_loadl_epi64((__m128i *)p)), INT16_MAX, INT16_MIN);
+}
+
+static inline __m128 chunk_from_int16_be(char *p){
+  __m128i i = _mm_shuffle_epi8(_mm_loadl_epi64((__m128i *)p), SWAP16);
+  return int_to_unit(_mm_cvtepi16_epi32(i), INT16_MAX, INT16_MIN);
+}
+
+static inline __m128 chunk_from_int24(char *p){
+  return int_to_unit(sign_extend(_mm_shuffle_epi8(load_packed(p), SPREAD24), 24), INT24_MAX, INT24_MIN);
+}
+
+static inline __m128 chunk_from_int24_be(char *p){
+  return int_to_unit(sign_extend(_mm_shuffle_epi8(load_packed(p), SPREAD24_BE), 24), INT24_MAX, INT24_MIN);
+}
+
+static inline __m128 chunk_from_int24_32(char *p){
+  return int_to_unit(sign_extend(_mm_loadu_si128((__m128i *)p), 24), INT24_MAX, INT24_MIN);
+}
+
+static inline __m128 chunk_from_int20(char *p){
+  return int_to_unit(sign_extend(_mm_shuffle_epi8(load_packed(p), SPREAD24), 20), INT20_MAX, INT20_MIN);
+}
+
+static inline __m128d int32_to_unit(__m128d v){
+  return _mm_blendv_pd(_mm_div_pd(v, _mm_set1_pd(INT32_MAX)), _mm_mul_pd(v, _mm_set1_pd(1.0/2147483648.0)), v);
+}
+
+static inline __m128 int32_chunk_to_unit(__m128i s){
+  __m128d lo = int32_to_unit(_mm_cvtepi32_pd(s));
+  __m128d hi = int32_to_unit(_mm_cvtepi32_pd(_mm_unpackhi_epi64(s, s)));
+  return _mm_movelh_ps(_mm_cvtpd_ps(lo), _mm_cvtpd_ps(hi));
+}
+
+// Companded samples are decoded through the tables in transfer.c,
+// so the vector only needs to be assembled from the lookups.
+static inline __m128 chunk_from_table(char *p, float *table){
+  uint8_t *c = (uint8_t *)p;
+  return _mm_setr_ps(table[c[0]], table[c[1]], table[c[2]], table[c[3]]);
+}
+
+static inline __m128 chunk_from_mulaw(char *p){
+  return chunk_from_table(p, mulaw_decode_table);
+}
+
+static inline __m128 chunk_from_alaw(char *p){
+  return chunk_from_table(p, alaw_decode_table);
+}
+
+static inline __m128 chunk_from_int32(char *p){
+  return int32_chunk_to_unit(_mm_loadu_si128((__m128i *)p));
+}
+
+static inline __m128 chunk_from_int32_be(char *p){
+  return int32_chunk_to_unit(_mm_shuffle_epi8(_mm_loadu_si128((__m128i *)p), SWAP32));
+}
+
+static inline __m128 chunk_from_float(char *p){
+  return clamp_unit(_mm_loadu_ps((float *)p));
+}
+
+static inline __m128i unit_to_int16(__m128 v){
+  // 1.0 turns into 32768, which the saturating pack clamps for us.
+  __m128i i = _mm_cvttps_epi32(_mm_mul_ps(clamp_unit(v), _mm_set1_ps(32768.0f)));
+  return _mm_packs_epi32(i, i);
+}
+
+static inline void chunk_to_int16(char *p, __m128 v){
+  _mm_storel_epi64((__m128i *)p, unit_to_int16(v));
+}
+
+static inline void chunk_to_int16_be(char *p, __m128 v){
+  _mm_storel_epi64((__m128i *)p, _mm_shuffle_epi8(unit_to_int16(v), SWAP16));
+}
+
+// For sample widths below 32 bits the scaled 1.0 still fits and
+// only needs to be clamped to the maximum.
+static inline __m128i unit_to_int(__m128 v, float scale){
+  __m128i i = _mm_cvttps_epi32(_mm_mul_ps(clamp_unit(v), _mm_set1_ps(scale)));
+  return _mm_min_epi32(i, _mm_set1_epi32((int32_t)scale-1));
+}
+
+static inline void chunk_to_int24(char *p, __m128 v){
+  store_packed(p, _mm_shuffle_epi8(unit_to_int(v, 8388608.0f), GATHER24));
+}
+
+static inline void chunk_to_int24_be(char *p, __m128 v){
+  store_packed(p, _mm_shuffle_epi8(unit_to_int(v, 8388608.0f), GATHER24_BE));
+}
+
+static inline void chunk_to_int24_32(char *p, __m128 v){
+  _mm_storeu_si128((__m128i *)p, unit_to_int(v, 8388608.0f));
+}
+
+static inline void chunk_to_int20(char *p, __m128 v){
+  store_packed(p, _mm_shuffle_epi8(unit_to_int(v, 524288.0f), GATHER24));
+}
+
+// Rounds to the nearest step rather than truncating, for use with
+// dither that has already been added to the samples.
+static inline void chunk_round_int16(char *p, __m128 v){
+  __m128i i = _mm_cvtps_epi32(_mm_mul_ps(clamp_unit(v), _mm_set1_ps(32768.0f)));
+  _mm_storel_epi64((__m128i *)p, _mm_packs_epi32(i, i));
+}
+
+// Encoding goes through int16 like the scalar functions do, the
+// vector computes the table indices for mulaw_encode and alaw_encode.
+static inline void chunk_to_table(char *p, __m128 v, int shift, uint8_t *table){
+  int32_t index[4];
+  __m128i i = _mm_cvtepi16_epi32(unit_to_int16(v));
+  i = _mm_add_epi32(_mm_srai_epi32(i, shift), _mm_set1_epi32(1 << (15-shift)));
+  _mm_storeu_si128((__m128i *)index, i);
+  for(int k=0; k<4; ++k)
+    p[k] = table[index[k]];
+}
+
+static inline void chunk_to_mulaw(char *p, __m128 v){
+  chunk_to_table(p, v, 2, mulaw_encode_table);
+}
+
+static inline void chunk_to_alaw(char *p, __m128 v){
+  chunk_to_table(p, v, 3, alaw_encode_table);
+}
+
+static inline __m128i unit_to_int32(__m128 v){
+  __m128 c = clamp_unit(v);
+  __m128i i = _mm_cvttps_epi32(_mm_mul_ps(c, _mm_set1_ps(2147483648.0f)));
+  // 1.0 overflows to INT32_MIN, flip it over to INT32_MAX.
+  return _mm_xor_si128(i, _mm_castps_si128(_mm_cmpge_ps(c, _mm_set1_ps(1.0f))));
+}
+
+static inline void chunk_to_int32(char *p, __m128 v){
+  _mm_storeu_si128((__m128i *)p, unit_to_int32(v));
+}
+
+static inline void chunk_to_int32_be(char *p, __m128 v){
+  _mm_storeu_si128((__m128i *)p, _mm_shuffle_epi8(unit_to_int32(v), SWAP32));
+}
+
+static inline void chunk_to_float(char *p, __m128 v){
+  _mm_storeu_ps((float *)p, clamp_unit(v));
+}
+
+//// Vector operations for each instruction set
+#define sse_TARGET
+
+typedef __m128 sse_t;
+#define sse_lanes 1
+#define sse_unpacklo _mm_unpacklo_ps
+#define sse_unpackhi _mm_unpackhi_ps
+#define sse_shuffle _mm_shuffle_ps
+#define sse_mul _mm_mul_ps
+#define sse_set1 _mm_set1_ps
+#define sse_loadu _mm_loadu_ps
+#define sse_storeu _mm_storeu_ps
+#define sse_add _mm_add_ps
+#define sse_sub _mm_sub_ps
+typedef __m128i sse_i;
+#define sse_loadi(P) _mm_loadu_si128((__m128i *)(P))
+#define sse_storei(P, V) _mm_storeu_si128((__m128i *)(P), V)
+#define sse_xori _mm_xor_si128
+#define sse_slli _mm_slli_epi32
+#define sse_srli _mm_srli_epi32
+#define sse_cvti _mm_cvtepi32_ps
+#define sse_row(CHUNK, P, STEP) CHUNK(P)
+#define sse_unrow(CHUNK, P, STEP, V) CHUNK(P, V)
+
+//// Shuffle networks
+// The rows hold the frames in memory order, the columns one channel.
+#define TRANSPOSE4(V, A, B, C, D){                                      \
+    V##_t t0 = V##_unpacklo(A, B), t1 = V##_unpacklo(C, D);             \
+    V##_t t2 = V##_unpackhi(A, B), t3 = V##_unpackhi(C, D);             \
+    A = V##_shuffle(t0, t1, _MM_SHUFFLE(1,0,1,0));                      \
+    B = V##_shuffle(t0, t1, _MM_SHUFFLE(3,2,3,2));                      \
+    C = V##_shuffle(t2, t3, _MM_SHUFFLE(1,0,1,0));                      \
+    D = V##_shuffle(t2, t3, _MM_SHUFFLE(3,2,3,2));                      \
+  }
+
+#define ROWS_TO_COLUMNS_1(V, r)
+#define COLUMNS_TO_ROWS_1(V, r)
+
+// Rows: L0 R0 L1 R1 | L2 R2 L3 R3
+#define ROWS_TO_COLUMNS_2(V, r){                                        \
+    V##_t a = V##_shuffle(r[0], r[1], _MM_SHUFFLE(2,0,2,0));            \
+    V##_t b = V##_shuffle(r[0], r[1], _MM_SHUFFLE(3,1,3,1));            \
+    r[0] = a; r[1] = b;                                                 \
+  }
+
+#define COLUMNS_TO_ROWS_2(V, r){                                        \
+    V##_t a = V##_unpacklo(r[0], r[1]);                                 \
+    V##_t b = V##_unpackhi(r[0], r[1]);                                 \
+    r[0] = a; r[1] = b;                                                 \
+  }
+
+// Rows: f0c0-3 | f0c4-5 f1c0-1 | f1c2-5 | f2c0-3 | f2c4-5 f3c0-1 | f3c2-5
+#define ROWS_TO_COLUMNS_6(V, r){                                        \
+    V##_t f0 = r[0], f2 = r[3];                                         \
+    V##_t f1 = V##_shuffle(r[1], r[2], _MM_SHUFFLE(1,0,3,2));           \
+    V##_t f3 = V##_shuffle(r[4], r[5], _MM_SHUFFLE(1,0,3,2));           \
+    V##_t x = V##_shuffle(r[1], r[2], _MM_SHUFFLE(3,2,1,0));            \
+    V##_t y = V##_shuffle(r[4], r[5], _MM_SHUFFLE(3,2,1,0));            \
+    TRANSPOSE4(V, f0, f1, f2, f3);                                      \
+    r[0] = f0; r[1] = f1; r[2] = f2; r[3] = f3;                         \
+    r[4] = V##_shuffle(x, y, _MM_SHUFFLE(2,0,2,0));                     \
+    r[5] = V##_shuffle(x, y, _MM_SHUFFLE(3,1,3,1));                     \
+  }
+
+#define COLUMNS_TO_ROWS_6(V, r){                                        \
+    V##_t f0 = r[0], f1 = r[1], f2 = r[2], f3 = r[3];                   \
+    V##_t x = V##_unpacklo(r[4], r[5]);                                 \
+    V##_t y = V##_unpackhi(r[4], r[5]);                                 \
+    TRANSPOSE4(V, f0, f1, f2, f3);                                      \
+    r[0] = f0;                                                          \
+    r[1] = V##_shuffle(x, f1, _MM_SHUFFLE(1,0,1,0));                    \
+    r[2] = V##_shuffle(f1, x, _MM_SHUFFLE(3,2,3,2));                    \
+    r[3] = f2;                                                          \
+    r[4] = V##_shuffle(y, f3, _MM_SHUFFLE(1,0,1,0));                    \
+    r[5] = V##_shuffle(f3, y, _MM_SHUFFLE(3,2,3,2));                    \
+  }
+
+// Rows: f0c0-3 | f0c4-7 | f1c0-3 | f1c4-7 | ...
+#define ROWS_TO_COLUMNS_8(V, r){                                        \
+    V##_t a0 = r[0], a1 = r[2], a2 = r[4], a3 = r[6];                   \
+    V##_t b0 = r[1], b1 = r[3], b2 = r[5], b3 = r[7];                   \
+    TRANSPOSE4(V, a0, a1, a2, a3);                                      \
+    TRANSPOSE4(V, b0, b1, b2, b3);                                      \
+    r[0] = a0; r[1] = a1; r[2] = a2; r[3] = a3;                         \
+    r[4] = b0; r[5] = b1; r[6] = b2; r[7] = b3;                         \
+  }
+
+#define COLUMNS_TO_ROWS_8(V, r){                                        \
+    V##_t a0 = r[0], a1 = r[1], a2 = r[2], a3 = r[3];                   \
+    V##_t b0 = r[4], b1 = r[5], b2 = r[6], b3 = r[7];                   \
+    TRANSPOSE4(V, a0, a1, a2, a3);                                      \
+    TRANSPOSE4(V, b0, b1, b2, b3);                                      \
+    r[0] = a0; r[2] = a1; r[4] = a2; r[6] = a3;                         \
+    r[1] = b0; r[3] = b1; r[5] = b2; r[7] = b3;                         \
+  }
+
+//// Kernels
+#define DEF_KERNEL_FROM(V, NAME, SIZE, C)                               \
+  V##_TARGET static uint32_t V##_from_##NAME##_##C(void *in, float **outs, channel_t channels, uint32_t frames, float volume){ \
+    IGNORE(channels);                                                   \
+    const uint32_t block = 4*V##_lanes;                                 \
+    V##_t vol = V##_set1(volume);                                       \
+    char *data = (char *)in;                                            \
+    uint32_t i = 0;                                                     \
+    for(; i+block <= frames; i+=block){                                 \
+      V##_t r[C];                                                       \
+      for(uint32_t k=0; k<C; ++k)                                       \
+        r[k] = V##_row(chunk_from_##NAME, data+4*k*SIZE, 4*C*SIZE);     \
+      ROWS_TO_COLUMNS_##C(V, r);                                        \
+      for(uint32_t c=0; c<C; ++c)                                       \
+        V##_storeu(outs[c]+i, V##_mul(r[c], vol));                      \
+      data += block*C*SIZE;                                             \
+    }                                                                   \
+    return i;                                                           \
+  }
+
+#define DEF_KERNEL_TO(V, NAME, SIZE, C)                                 \
+  V##_TARGET static uint32_t V##_to_##NAME##_##C(float **ins, void *out, channel_t channels, uint32_t frames, float volume){ \
+    IGNORE(channels);                                                   \
+    const uint32_t block = 4*V##_lanes;                                 \
+    V##_t vol = V##_set1(volume);                                       \
+    char *data = (char *)out;                                           \
+    uint32_t i = 0;                                                     \
+    for(; i+block <= frames; i+=block){                                 \
+      V##_t r[C];                                                       \
+      for(uint32_t c=0; c<C; ++c)                                       \
+        r[c] = V##_mul(V##_loadu(ins[c]+i), vol);                       \
+      COLUMNS_TO_ROWS_##C(V, r);                                        \
+      for(uint32_t k=0; k<C; ++k)                                       \
+        V##_unrow(chunk_to_##NAME, data+4*k*SIZE, 4*C*SIZE, r[k]);      \
+      data += block*C*SIZE;                                             \
+    }                                                                   \
+    return i;                                                           \
+  }
+
+// Other channel counts of at least four are handled four channels
+// at a time. Four frames of four adjacent channels form a block that
+// a single transpose turns into columns. If the count is not a
+// multiple of four, the last group overlaps the one before it, which
+// merely converts a few samples twice.
+#define DEF_KERNEL_FROM_WIDE(V, NAME, SIZE)                             \
+  V##_TARGET static uint32_t V##_from_##NAME##_wide(void *in, float **outs, channel_t channels, uint32_t frames, float volume){ \
+    const uint32_t block = 4*V##_lanes;                                 \
+    const uint32_t stride = channels*SIZE;                              \
+    V##_t vol = V##_set1(volume);                                       \
+    char *data = (char *)in;                                            \
+    uint32_t i = 0;                                                     \
+    for(; i+block <= frames; i+=block){                                 \
+      for(uint32_t g=0; g<channels; g+=4){                              \
+        uint32_t c = MIN(g, (uint32_t)channels-4);                      \
+        char *p = data+c*SIZE;                                          \
+        V##_t r0 = V##_row(chunk_from_##NAME, p, 4*stride);             \
+        V##_t r1 = V##_row(chunk_from_##NAME, p+stride, 4*stride);      \
+        V##_t r2 = V##_row(chunk_from_##NAME, p+2*stride, 4*stride);    \
+        V##_t r3 = V##_row(chunk_from_##NAME, p+3*stride, 4*stride);    \
+        TRANSPOSE4(V, r0, r1, r2, r3);                                  \
+        V##_storeu(outs[c+0]+i, V##_mul(r0, vol));                      \
+        V##_storeu(outs[c+1]+i, V##_mul(r1, vol));                      \
+        V##_storeu(outs[c+2]+i, V##_mul(r2, vol));                      \
+        V##_storeu(outs[c+3]+i, V##_mul(r3, vol));                      \
+      }                                                                 \
+      data += block*stride;                                             \
+    }                                                                   \
+    return i;                                                           \
+  }
+
+#define DEF_KERNEL_TO_WIDE(V, NAME, SIZE)                               \
+  V##_TARGET static uint32_t V##_to_##NAME##_wide(float **ins, void *out, channel_t channels, uint32_t frames, float volume){ \
+    const uint32_t block = 4*V##_lanes;                                 \
+    const uint32_t stride = channels*SIZE;                              \
+    V##_t vol = V##_set1(volume);                                       \
+    char *data = (char *)out;                                           \
+    uint32_t i = 0;                                                     \
+    for(; i+block <= frames; i+=block){                                 \
+      for(uint32_t g=0; g<channels; g+=4){                              \
+        uint32_t c = MIN(g, (uint32_t)channels-4);                      \
+        char *p = data+c*SIZE;                                          \
+        V##_t r0 = V##_mul(V##_loadu(ins[c+0]+i), vol);                 \
+        V##_t r1 = V##_mul(V##_loadu(ins[c+1]+i), vol);                 \
+        V##_t r2 = V##_mul(V##_loadu(ins[c+2]+i), vol);                 \
+        V##_t r3 = V##_mul(V##_loadu(ins[c+3]+i), vol);                 \
+        TRANSPOSE4(V, r0, r1, r2, r3);                                  \
+        V##_unrow(chunk_to_##NAME, p, 4*stride, r0);                    \
+        V##_unrow(chunk_to_##NAME, p+stride, 4*stride, r1);             \
+        V##_unrow(chunk_to_##NAME, p+2*stride, 4*stride, r2);           \
+        V##_unrow(chunk_to_##NAME, p+3*stride, 4*stride, r3);           \
+      }                                                                 \
+      data += block*stride;                                             \
+    }                                                                   \
+    return i;                                                           \
+  }
+
+// Every lane runs the same xorshift generator as dither_noise in
+// transfer.c, with its own state from the channel's lane array.
+#define DITHER_XORSHIFT(V, X){                                          \
+    X = V##_xori(X, V##_slli(X, 13));                                   \
+    X = V##_xori(X, V##_srli(X, 17));                                   \
+    X = V##_xori(X, V##_slli(X, 5));                                    \
+  }
+
+#define DEF_DITHER_KERNEL(V, C)                                         \
+  V##_TARGET static uint32_t V##_dither_int16_##C(float **ins, void *out, uint32_t frames, float volume, struct dither_channel *dither){ \
+    const uint32_t block = 4*V##_lanes;                                 \
+    V##_t vol = V##_set1(volume);                                       \
+    V##_t lsb = V##_set1(1.0f/(16777216.0f*32768.0f));                  \
+    V##_i rng[C];                                                       \
+    for(uint32_t c=0; c<C; ++c)                                         \
+      rng[c] = V##_loadi(dither[c].rng);                                \
+    char *data = (char *)out;                                           \
+    uint32_t i = 0;                                                     \
+    for(; i+block <= frames; i+=block){                                 \
+      V##_t r[C];                                                       \
+      for(uint32_t c=0; c<C; ++c){                                      \
+        V##_i a = rng[c], b;                                            \
+        DITHER_XORSHIFT(V, a);                                          \
+        b = a;                                                          \
+        DITHER_XORSHIFT(V, b);                                          \
+        rng[c] = b;                                                     \
+        V##_t noise = V##_sub(V##_cvti(V##_srli(a, 8)), V##_cvti(V##_srli(b, 8))); \
+        r[c] = V##_add(V##_mul(V##_loadu(ins[c]+i), vol), V##_mul(noise, lsb)); \
+      }                                                                 \
+      COLUMNS_TO_ROWS_##C(V, r);                                        \
+      for(uint32_t k=0; k<C; ++k)                                       \
+        V##_unrow(chunk_round_int16, data+4*k*sizeof(int16_t), 4*C*sizeof(int16_t), r[k]); \
+      data += block*C*sizeof(int16_t);                                  \
+    }                                                                   \
+    for(uint32_t c=0; c<C; ++c)                                         \
+      V##_storei(dither[c].rng, rng[c]);                                \
+    return i;                                                           \
+  }
+
+#define DEF_KERNELS_CHANNELS(V, NAME, SIZE)                             \
+  DEF_KERNEL_FROM(V, NAME, SIZE, 1)                                     \
+  DEF_KERNEL_FROM(V, NAME, SIZE, 2)                                     \
+  DEF_KERNEL_FROM(V, NAME, SIZE, 6)                                     \
+  DEF_KERNEL_FROM(V, NAME, SIZE, 8)                                     \
+  DEF_KERNEL_TO(V, NAME, SIZE, 1)                                       \
+  DEF_KERNEL_TO(V, NAME, SIZE, 2)                                       \
+  DEF_KERNEL_TO(V, NAME, SIZE, 6)                                       \
+  DEF_KERNEL_TO(V, NAME, SIZE, 8)                                       \
+  DEF_KERNEL_FROM_WIDE(V, NAME, SIZE)                                   \
+  DEF_KERNEL_TO_WIDE(V, NAME, SIZE)
+
+#define KERNEL_ROW(V, DIRECTION, NAME)                                  \
+  {V##_##DIRECTION##_##NAME##_1, V##_##DIRECTION##_##NAME##_2,          \
+   V##_##DIRECTION##_##NAME##_6, V##_##DIRECTION##_##NAME##_8,          \
+   V##_##DIRECTION##_##NAME##_wide}
+
+#define DITHER_ROW(V)                                                   \
+  {V##_dither_int16_1, V##_dither_int16_2,                              \
+   V##_dither_int16_6, V##_dither_int16_8}
+
+#define KERNEL_ROWS(V, DIRECTION)                                       \
+  {KERNEL_ROW(V, DIRECTION, int16), KERNEL_ROW(V, DIRECTION, int32),    \
+   KERNEL_ROW(V, DIRECTION, float), KERNEL_ROW(V, DIRECTION, int24),    \
+   KERNEL_ROW(V, DIRECTION, int16_be), KERNEL_ROW(V, DIRECTION, int24_be), \
+   KERNEL_ROW(V, DIRECTION, int32_be), KERNEL_ROW(V, DIRECTION, int24_32), \
+   KERNEL_ROW(V, DIRECTION, int20), KERNEL_ROW(V, DIRECTION, mulaw),    \
+   KERNEL_ROW(V, DIRECTION, alaw)}
+
+#define DEF_KERNELS(V)                                                  \
+  DEF_KERNELS_CHANNELS(V, int16, 2)                                     \
+  DEF_KERNELS_CHANNELS(V, int32, 4)                                     \
+  DEF_KERNELS_CHANNELS(V, float, 4)                                     \
+  DEF_KERNELS_CHANNELS(V, int24, 3)                                     \
+  DEF_KERNELS_CHANNELS(V, int16_be, 2)                                  \
+  DEF_KERNELS_CHANNELS(V, int24_be, 3)                                  \
+  DEF_KERNELS_CHANNELS(V, int32_be, 4)                                  \
+  DEF_KERNELS_CHANNELS(V, int24_32, 4)                                  \
+  DEF_KERNELS_CHANNELS(V, int20, 3)                                     \
+  DEF_KERNELS_CHANNELS(V, mulaw, 1)                                     \
+  DEF_KERNELS_CHANNELS(V, alaw, 1)                                      \
+  DEF_DITHER_KERNEL(V, 1)                                               \
+  DEF_DITHER_KERNEL(V, 2)                                               \
+  DEF_DITHER_KERNEL(V, 6)                                               \
+  DEF_DITHER_KERNEL(V, 8)                                               \
+  static struct kernel_table V##_kernels = {                            \
+    KERNEL_ROWS(V, from),                                               \
+    KERNEL_ROWS(V, to),                                                 \
+    DITHER_ROW(V)                                                       \
+  };
+
+#define KERNEL_ENCODINGS 11
+
+struct kernel_table{
+  mixed_deinterleave_function from[KERNEL_ENCODINGS][5];
+  mixed_interleave_function to[KERNEL_ENCODINGS][5];
+  mixed_dither_interleave_function dither[4];
+};
+
+DEF_KERNELS(sse)
+
+static struct kernel_table *select_kernels(){
+  return &sse_kernels;
+}
+
+static int encoding_index(enum mixed_encoding encoding){
+  switch(encoding){
+  case MIXED_INT16: return 0;
+  case MIXED_INT32: return 1;
+  case MIXED_FLOAT: return 2;
+  case MIXED_INT24: return 3;
+  case MIXED_INT16_BE: return 4;
+  case MIXED_INT24_BE: return 5;
+  case MIXED_INT32_BE: return 6;
+  case MIXED_INT24_32: return 7;
+  case MIXED_INT20: return 8;
+  case MIXED_MULAW: return 9;
+  case MIXED_ALAW: return 10;
+  default: return -1;
+  }
+}
+
+static int channels_index(channel_t channels){
+  switch(channels){
+  case 1: return 0;
+  case 2: return 1;
+  case 6: return 2;
+  case 8: return 3;
+  default: return -1;
+  }
+}
+
+// Like channels_index, but falls back to the wide kernels.
+static int any_channels_index(channel_t channels){
+  int c = channels_index(channels);
+  return (c < 0 && 4 <= channels)? 4 : c;
+}
+
+mixed_deinterleave_function deinterleave_kernel(enum mixed_encoding encoding, channel_t channels){
+  int e = encoding_index(encoding), c = any_channels_index(channels);
+  if(e < 0 || c < 0) return 0;
+  return select_kernels()->from[e][c];
+}
+
+mixed_interleave_function interleave_kernel(enum mixed_encoding encoding, channel_t channels){
+  int e = encoding_index(encoding), c = any_channels_index(channels);
+  if(e < 0 || c < 0) return 0;
+  return select_kernels()->to[e][c];
+}
+
+mixed_dither_interleave_function dither_interleave_kernel(enum mixed_encoding encoding, channel_t channels){
+  int c = channels_index(channels);
+  if(encoding != MIXED_INT16 || c < 0) return 0;
+  return select_kernels()->dither[c];
+}
+
+#else
+mixed_deinterleave_function deinterleave_kernel(enum mixed_encoding encoding, channel_t channels){
+  IGNORE(encoding, channels);
+  return 0;
+}
+
+mixed_interleave_function interleave_kernel(enum mixed_encoding encoding, channel_t channels){
+  IGNORE(encoding, channels);
+  return 0;
+}
+
+mixed_dither_interleave_function dither_interleave_kernel(enum mixed_encoding encoding, channel_t channels){
+  IGNORE(encoding, channels);
+  return 0;
+}
+#endif
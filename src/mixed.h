@@ -25,6 +25,13 @@ extern "C" {
 #include <stdlib.h>
 #include "encoding.h"
 
+// The assumed size of a cache line in bytes.
+#define MIXED_CACHE_LINE 64
+// The bytes per channel in a block of MIXED_IMA_ADPCM, and the
+// number of frames such a block holds.
+#define MIXED_ADPCM_BLOCK_SIZE 256
+#define MIXED_ADPCM_BLOCK_FRAMES 505
+
   // This enum describes all possible error codes.
   MIXED_EXPORT enum mixed_error{
     // No error has occurred yet.
@@ -95,7 +102,14 @@ extern "C" {
     // registered.
     MIXED_DUPLICATE_SEGMENT,
     // A segment with the requested name is not registered.
-    MIXED_BAD_SEGMENT
+    MIXED_BAD_SEGMENT,
+    // The file could not be opened or mapped into memory.
+    MIXED_MAPPING_FAILED,
+    // The connections of a graph segment form a cycle.
+    MIXED_GRAPH_CYCLE,
+    // The writer dropped data that was being read, so what was
+    // read may have been overwritten.
+    MIXED_BUFFER_DROPPED
   };
 
   // This enum describes the possible sample encodings.
@@ -109,7 +123,29 @@ extern "C" {
     MIXED_INT32,
     MIXED_UINT32,
     MIXED_FLOAT,
-    MIXED_DOUBLE
+    MIXED_DOUBLE,
+    // The following encodings start at 64, as the ones above share
+    // their values with the segment field types.
+    // Big-endian signed integers.
+    MIXED_INT16_BE = 64,
+    MIXED_INT24_BE,
+    MIXED_INT32_BE,
+    // Signed 24 bit samples in the low three bytes of a
+    // little-endian 32 bit word, also known as S24_32LE.
+    MIXED_INT24_32,
+    // Signed 20 bit samples in the low bits of three little-endian
+    // bytes, also known as S20_3LE.
+    MIXED_INT20,
+    // G.711 companded 8 bit samples.
+    MIXED_MULAW,
+    MIXED_ALAW,
+    // IMA ADPCM at four bits per sample, in blocks as used by WAV
+    // files. Each block takes MIXED_ADPCM_BLOCK_SIZE bytes per
+    // channel and holds MIXED_ADPCM_BLOCK_FRAMES frames. This is a
+    // block-coded encoding, so it has no sample size and no
+    // translator functions. Only the packer and unpacker segments
+    // process it, and they do so a whole block at a time.
+    MIXED_IMA_ADPCM
   };
 
   // This enum describes all possible flags of the
@@ -274,6 +310,33 @@ extern "C" {
     // Setting this may also affect the MIXED_BYPASS value.
     // The default is 1.0, should be a float.
     MIXED_MIX,
+    // Access the planar multi-channel buffer for this in/out, in
+    // place of the per-channel MIXED_BUFFER fields. Only segments
+    // with the MIXED_MULTICHANNEL flag support this.
+    // The value must be a mixed_multibuffer struct.
+    MIXED_MULTIBUFFER,
+    // Access the dithering applied when quantising to integer
+    // sample encodings. The value must be from the
+    // mixed_dither_type enum. The default is MIXED_NO_DITHER.
+    MIXED_DITHER,
+    // Access the channels of the pack that a packer or unpacker
+    // converts. The value must be a mixed_channel_map struct,
+    // whose channels are copied when set. When read, the channels
+    // point to the segment's own copy. Changing the map changes
+    // the number of ports, and drops buffers of ports that no
+    // longer exist.
+    // The unpacker may select the same channel several times, the
+    // packer writes silence to channels that are not selected.
+    // The default selects all channels in order.
+    // On a converter, the map instead selects the input channel
+    // that each output channel draws from.
+    MIXED_CHANNEL_MAP,
+    // Access the number of threads a graph segment mixes with.
+    // With more than one, the graph keeps a pool of threads while
+    // it is started, and segments that do not depend on each other
+    // are mixed on them in parallel.
+    // The value must be a uint32_t. The default is 1.
+    MIXED_THREADS,
   };
 
   // This enum descripbes the possible resampling quality options.
@@ -304,6 +367,21 @@ extern "C" {
     MIXED_LINEAR_INTERPOLATION
   };
 
+  // This enum describes the possible dithering options used when
+  // converting float samples to an integer encoding.
+  MIXED_EXPORT enum mixed_dither_type{
+    // Samples are truncated without any dither.
+    MIXED_NO_DITHER = 1,
+    // Triangular noise of one LSB amplitude is added before
+    // rounding, which decorrelates the quantisation error from
+    // the signal at the cost of a slightly raised noise floor.
+    MIXED_TPDF_DITHER,
+    // Like MIXED_TPDF_DITHER, but the quantisation error of each
+    // sample is subtracted from the next, shifting the noise
+    // towards high frequencies where it is less audible.
+    MIXED_SHAPED_DITHER
+  };
+
   // This enum describes the possible preset attenuation functions.
   MIXED_EXPORT enum mixed_attenuation{
     MIXED_NO_ATTENUATION = 1,
@@ -357,6 +435,10 @@ extern "C" {
     // its input buffers, making them unusable for virtual
     // buffers.
     MIXED_MODIFIES_INPUT = 0x2,
+    // This means that the segment accepts a mixed_multibuffer
+    // through the MIXED_MULTIBUFFER field on location 0, and then
+    // processes all of its channels with a single request.
+    MIXED_MULTICHANNEL = 0x4,
     // The field is available for inputs.
     MIXED_IN = 0x1,
     // The field is available for outputs.
@@ -369,6 +451,46 @@ extern "C" {
     MIXED_GET = 0x10,
   };
 
+  // This enum holds allocation flags for buffers.
+  //
+  // Set the flags field of the buffer struct to an OR combination
+  // of these flags before calling mixed_make_buffer.
+  MIXED_EXPORT enum mixed_buffer_flags{
+    // The data array is aligned to a 64 byte boundary and the
+    // size is rounded up to a multiple of 16 samples, so that
+    // every vector unit can use aligned loads and stores without
+    // needing a scalar tail on full-size transfers.
+    MIXED_BUFFER_ALIGNED = 0x1,
+    // Request transparent huge pages to back the data array.
+    // This only has an effect for arrays of at least 2MB and on
+    // systems that support it, and implies MIXED_BUFFER_ALIGNED.
+    MIXED_BUFFER_HUGEPAGES = 0x2,
+    // The data array belongs to a mixed_buffer_pool. This flag is
+    // set by mixed_buffer_pool_acquire and should not be set by you.
+    MIXED_BUFFER_POOLED = 0x4,
+    // Map the data array twice in a row, so that the buffer acts
+    // as a ring buffer whose available region is always one
+    // contiguous span. With this, request_read and request_write
+    // always return everything that is available, rather than
+    // stopping at the end of the array. The size is rounded up to
+    // a multiple of the system page size, and the storage does not
+    // go through the allocator. If the system does not support
+    // this, the flag is cleared and a regular buffer is made. Sizes
+    // of 2^31 samples or more fail with MIXED_INVALID_VALUE.
+    MIXED_BUFFER_MIRRORED = 0x8,
+    // The data array is referenced from outside of the buffer, for
+    // instance by the virtual outputs of a distribute segment. This
+    // keeps mixed_buffer_transfer from forwarding the array to
+    // another buffer even if MIXED_BUFFER_FORWARD is set. Distribute
+    // sets this on its input itself.
+    MIXED_BUFFER_SHARED = 0x10,
+    // Allow mixed_buffer_transfer to hand the data array over to the
+    // target buffer instead of copying. Both buffers must have this
+    // set. Only set it on buffers that are accessed from a single
+    // thread, as the array changes hands under the other side.
+    MIXED_BUFFER_FORWARD = 0x20,
+  };
+
   // Convenience enum to map common speaker channels to buffer locations.
   //
   // It is not required that a segment follow this channel
@@ -429,6 +551,9 @@ extern "C" {
     MIXED_ENCODING_ENUM,
     MIXED_ERROR_ENUM,
     MIXED_RESAMPLE_TYPE_ENUM,
+    MIXED_MULTIBUFFER_POINTER,
+    MIXED_DITHER_TYPE_ENUM,
+    MIXED_CHANNEL_MAP_POINTER,
   };
 
   typedef uint8_t channel_t;
@@ -440,14 +565,173 @@ extern "C" {
   // including the data array. Use the request functions to
   // retrieve proper pointers into the array for read/write
   // operations.
+  //
+  // A buffer is a single-producer single-consumer queue: one
+  // thread may write to it while another reads from it without
+  // any locking, but there may never be more than one of each at
+  // a time. The read and write pointers are kept on separate
+  // cache lines so that the two threads do not contend for them.
   MIXED_EXPORT struct mixed_buffer{
     float *_data;
     uint32_t size;
+    // An OR combination of mixed_buffer_flags.
+    // Segments may check for MIXED_BUFFER_ALIGNED to take a
+    // fast path that relies on aligned areas.
+    enum mixed_buffer_flags flags;
+    char _pad0[MIXED_CACHE_LINE - sizeof(float *) - 2*sizeof(uint32_t)];
+    // Owned by the reader
     uint32_t read;
+    uint32_t _write_cache;
+    char _pad1[MIXED_CACHE_LINE - 2*sizeof(uint32_t)];
+    // Owned by the writer
     uint32_t write;
     uint32_t reserved;
+    uint32_t _read_cache;
+    char _pad2[MIXED_CACHE_LINE - 3*sizeof(uint32_t)];
     // Whether the buffer owns the data array.
     char virtual;
+    // Storage handed between threads by staged resizes.
+    void *_staged;
+    void *_retired;
+  };
+
+  // Flags that describe the storage of a pack.
+  MIXED_EXPORT enum mixed_pack_flags{
+    // The data array is a read-only mapping of a file. This flag
+    // is set by mixed_make_pack_mmap and should not be set by you.
+    MIXED_PACK_MAPPED = 0x1,
+    // Allow threads to block on the pack with mixed_pack_wait_read
+    // and mixed_pack_wait_write. This makes every read and write
+    // check for sleeping threads to wake up, so only set it on
+    // packs that are actually waited on.
+    MIXED_PACK_WAITABLE = 0x2,
+    // Allow multiple threads to write to the pack at once through
+    // mixed_pack_reserve and mixed_pack_commit. The pack is then
+    // always mirrored, and mixed_make_pack fails with
+    // MIXED_NOT_IMPLEMENTED if the system does not support that.
+    // There may still only be a single reader.
+    MIXED_PACK_MULTI_PRODUCER = 0x4,
+    // Map the data array twice in a row. See MIXED_BUFFER_MIRRORED.
+    // Sizes of 2^31 bytes or more fail with MIXED_INVALID_VALUE.
+    // Set this before calling mixed_make_pack.
+    MIXED_PACK_MIRRORED = 0x8,
+    // Store each channel in its own plane rather than interleaving
+    // the frames. The size then counts the bytes of a single plane,
+    // and the planes follow each other in the data array. All planes
+    // share the read and write positions, so the areas returned by
+    // the request functions lie in the first plane, and the same
+    // area of channel c lies c*size bytes after it. Planar packs
+    // cannot be mirrored, mapped, or use block-coded encodings, and
+    // cannot be written with mixed_pack_write.
+    // Set this before calling mixed_make_pack.
+    MIXED_PACK_PLANAR = 0x10,
+  };
+
+  // How mixed_pack_write handles data that does not fit.
+  MIXED_EXPORT enum mixed_pack_overflow{
+    // Wait until enough space is available. On packs without
+    // MIXED_PACK_WAITABLE this cannot wait, so only what fits is
+    // written and the write fails with MIXED_BUFFER_FULL.
+    MIXED_OVERFLOW_BLOCK,
+    // Discard the oldest unread data to make room, in whole frames.
+    // This is only supported on mirrored packs. If the reader is
+    // between mixed_pack_request_read and mixed_pack_finish_read
+    // when data is dropped, what it read may have been overwritten.
+    // The finish then fails with MIXED_BUFFER_DROPPED, and the read
+    // data should be discarded. Reading resumes after the drop.
+    MIXED_OVERFLOW_DROP_OLDEST,
+    // Discard the part of the new data that does not fit.
+    MIXED_OVERFLOW_DROP_NEWEST
+  };
+
+  // A region of a multi-producer pack claimed by one writer.
+  //
+  // See mixed_pack_reserve.
+  MIXED_EXPORT struct mixed_pack_reservation{
+    // The area to write the data to.
+    void *area;
+    // The number of bytes in the area.
+    uint32_t size;
+    uint32_t _start;
+  };
+
+  // A planar multi-channel audio data buffer.
+  //
+  // All channels are stored in a single aligned allocation, one
+  // plane after the other, and share one set of read and write
+  // cursors, which count frames rather than samples. This means
+  // that all channels are always read and written in lockstep.
+  // As with mixed_buffer, you should not touch any of these fields
+  // yourself, except for channels, which must be set before
+  // calling mixed_make_multibuffer.
+  MIXED_EXPORT struct mixed_multibuffer{
+    float *_data;
+    // The number of frames per channel.
+    uint32_t size;
+    // Always MIXED_BUFFER_ALIGNED.
+    enum mixed_buffer_flags flags;
+    char _pad0[MIXED_CACHE_LINE - sizeof(float *) - 2*sizeof(uint32_t)];
+    // Owned by the reader
+    uint32_t read;
+    uint32_t _write_cache;
+    char _pad1[MIXED_CACHE_LINE - 2*sizeof(uint32_t)];
+    // Owned by the writer
+    uint32_t write;
+    uint32_t reserved;
+    uint32_t _read_cache;
+    char _pad2[MIXED_CACHE_LINE - 3*sizeof(uint32_t)];
+    // The number of channels.
+    uint32_t channels;
+    // The distance between two channel planes in samples.
+    uint32_t _stride;
+  };
+
+  // A pool of preallocated buffer storage.
+  //
+  // See mixed_make_buffer_pool.
+  MIXED_EXPORT struct mixed_buffer_pool{
+    // Internal pool data. You should not touch this.
+    void *_data;
+  };
+
+  // A set of buffers that are processed in lockstep.
+  //
+  // See mixed_buffer_group_request.
+  MIXED_EXPORT struct mixed_buffer_group{
+    // The buffers to read from, and their count.
+    struct mixed_buffer **in;
+    uint32_t ins;
+    // The buffers to write to, and their count.
+    struct mixed_buffer **out;
+    uint32_t outs;
+  };
+
+  // A set of memory management functions.
+  //
+  // See mixed_set_allocator.
+  MIXED_EXPORT struct mixed_allocator{
+    // Allocate a zeroed block of count*size bytes.
+    void *(*calloc)(size_t count, size_t size, void *user);
+    // Resize a block previously returned by calloc. This may be
+    // null, in which case a new block is allocated and copied.
+    void *(*realloc)(void *ptr, size_t size, void *user);
+    // Free a block previously returned by calloc or realloc.
+    void (*free)(void *ptr, void *user);
+    // Arbitrary user data passed to the functions.
+    void *user;
+  };
+
+  // A linear memory region to allocate from.
+  //
+  // See mixed_make_arena.
+  MIXED_EXPORT struct mixed_arena{
+    unsigned char *_data;
+    // The total number of bytes in the arena.
+    size_t size;
+    // The number of bytes that have been handed out so far.
+    size_t used;
+    // The allocator to pass to mixed_set_allocator.
+    struct mixed_allocator allocator;
   };
 
   // Information struct to encapsulate a "channel"
@@ -460,18 +744,55 @@ extern "C" {
   // Using this struct you can then create a converter
   // segment to include the external audio into the mix.
   MIXED_EXPORT struct mixed_pack{
-    // Bip buffer internals
+    // Bip buffer internals, see mixed_buffer
     unsigned char *_data;
     uint32_t size;
+    // An OR combination of mixed_pack_flags.
+    enum mixed_pack_flags flags;
+    char _pad0[MIXED_CACHE_LINE - sizeof(unsigned char *) - 2*sizeof(uint32_t)];
     uint32_t read;
+    uint32_t _write_cache;
+    uint32_t _read_start;
+    char _pad1[MIXED_CACHE_LINE - 3*sizeof(uint32_t)];
     uint32_t write;
     uint32_t reserved;
+    uint32_t _read_cache;
+    char _pad2[MIXED_CACHE_LINE - 3*sizeof(uint32_t)];
     // The sample encoding in the byte array.
     enum mixed_encoding encoding;
     // The number of channels that are packed into the array.
     channel_t channels;
     // The sample rate at which data is encoded in Hz.
     uint32_t samplerate;
+    // How mixed_pack_write treats data that does not fit.
+    enum mixed_pack_overflow overflow;
+    // If set, called by the reader when a read makes the number of
+    // readable bytes drop to low_watermark or below, and by the
+    // writer when a write makes it rise to high_watermark or above.
+    // Use these to schedule refills or drains instead of polling.
+    void (*on_low_watermark)(struct mixed_pack *pack);
+    void (*on_high_watermark)(struct mixed_pack *pack);
+    uint32_t low_watermark;
+    uint32_t high_watermark;
+    // Arbitrary data for use by the watermark callbacks.
+    void *user;
+    // Wait state internals
+    uint32_t _waiting;
+    uint32_t _wanted_read;
+    uint32_t _wanted_write;
+  };
+
+  // Selects the channels of a pack that a packer or unpacker works
+  // with. Port i of the segment corresponds to pack channel
+  // channels[i], so channels can be picked out in any order.
+  //
+  // See MIXED_CHANNEL_MAP
+  MIXED_EXPORT struct mixed_channel_map{
+    // The number of selected channels. Zero selects all channels
+    // of the pack in order.
+    channel_t count;
+    // The pack channel of each port.
+    channel_t *channels;
   };
 
   // Metadata struct for a segment's field.
@@ -571,11 +892,105 @@ extern "C" {
   // The frames designates the number of frames that can be stored in
   // the pack's data array. Meaning a total number of bytes of:
   //   frames*channels*mixed_samplesize(encoding)
+  // For block-coded encodings the frames are rounded up to whole
+  // blocks instead.
+  // If MIXED_PACK_PLANAR is set, each of the channels receives a
+  // plane of frames*mixed_samplesize(encoding) bytes.
   // 
   // For the write and read functions, please see the analogous buffer
   // functions.
   MIXED_EXPORT int mixed_make_pack(uint32_t frames, struct mixed_pack *pack);
   MIXED_EXPORT void mixed_free_pack(struct mixed_pack *pack);
+
+  // Create a pack that reads directly from a file.
+  //
+  // You /must/ set the pack fields encoding and channels before this.
+  // The file at path is mapped into memory starting at the given
+  // byte offset, and the mapped pages are exposed as the readable
+  // region of the pack without being copied. This is useful to
+  // stream large uncompressed files such as WAV or raw PCM, where
+  // offset would be the position of the first sample in the file.
+  //
+  // If frames is 0, the pack extends to the end of the file. Since
+  // pack sizes are limited to 2^31 bytes, longer files need to be
+  // split over several packs at successive offsets.
+  //
+  // The pack is initially full, and as it is read, the pages ahead
+  // of the read position are requested from the system while the
+  // ones behind it are released again, so the resident memory stays
+  // small regardless of the file size. The pack is read-only, so any
+  // request to write to it fails with MIXED_BUFFER_FULL.
+  //
+  // On systems without mmap this fails with MIXED_NOT_IMPLEMENTED.
+  // Free the pack with mixed_free_pack as usual.
+  MIXED_EXPORT int mixed_make_pack_mmap(char *path, uint64_t offset, uint32_t frames, struct mixed_pack *pack);
+
+  // Block until at least the given number of bytes can be read.
+  //
+  // The pack must have MIXED_PACK_WAITABLE set. The timeout is in
+  // milliseconds, and a negative timeout waits indefinitely. If the
+  // timeout expires first, this fails with MIXED_BUFFER_EMPTY. The
+  // bytes are counted across the wrap point, so you may need to
+  // request the read twice to get to all of them on packs that are
+  // not mirrored.
+  //
+  // On Linux the thread sleeps on a futex and is woken by the
+  // write that makes enough data available. Elsewhere this polls.
+  MIXED_EXPORT int mixed_pack_wait_read(uint32_t bytes, int32_t timeout, struct mixed_pack *pack);
+
+  // Block until at least the given number of bytes can be written.
+  //
+  // See mixed_pack_wait_read. If the timeout expires first, this
+  // fails with MIXED_BUFFER_FULL. On multi-producer packs, space
+  // claimed by outstanding reservations does not count as free, and
+  // every read wakes all waiting writers to check for room again.
+  MIXED_EXPORT int mixed_pack_wait_write(uint32_t bytes, int32_t timeout, struct mixed_pack *pack);
+
+  // Copy bytes from data into the pack, honouring its overflow policy.
+  //
+  // On return, bytes holds the number of bytes that were actually
+  // written. With MIXED_OVERFLOW_BLOCK this waits for space with the
+  // given timeout as in mixed_pack_wait_write, and fails with
+  // MIXED_BUFFER_FULL if it expires. If the pack is not
+  // MIXED_PACK_WAITABLE, the timeout is treated as already expired, so
+  // what fits is written and the rest fails. With MIXED_OVERFLOW_DROP_NEWEST
+  // whatever does not fit is discarded. With
+  // MIXED_OVERFLOW_DROP_OLDEST the reader's unread data is discarded
+  // instead, so that the newest data always makes it in. This is
+  // meant for live capture, where a stalled reader should miss old
+  // data rather than hold up the producer.
+  MIXED_EXPORT int mixed_pack_write(void *data, uint32_t *bytes, int32_t timeout, struct mixed_pack *pack);
+
+  // Claim an area of a multi-producer pack for writing.
+  //
+  // The pack must have MIXED_PACK_MULTI_PRODUCER set. Up to size
+  // bytes are reserved, rounded down to whole frames, and the
+  // reservation is filled in with the area to write to. Any number
+  // of threads may hold reservations at the same time and fill them
+  // in parallel. If there is no space at all, this fails with
+  // MIXED_BUFFER_FULL.
+  //
+  // Plain mixed_pack_request_write cannot be used on such a pack.
+  MIXED_EXPORT int mixed_pack_reserve(uint32_t size, struct mixed_pack_reservation *reservation, struct mixed_pack *pack);
+
+  // Make a reservation's data available to the reader.
+  //
+  // The entire reserved area is committed, so it must be filled in
+  // completely. Reservations become readable in the order they were
+  // made, so this waits for all earlier reservations to be committed
+  // first. Commit promptly, as a slow writer holds up the ones after
+  // it.
+  MIXED_EXPORT int mixed_pack_commit(struct mixed_pack_reservation *reservation, struct mixed_pack *pack);
+
+  // Move the read position of a mapped pack to the given frame.
+  //
+  // For block-coded encodings the read position moves to the start
+  // of the block containing the frame.
+  // Everything from that frame until the end of the mapping becomes
+  // available for reading again. This fails with MIXED_INVALID_VALUE
+  // if the frame lies beyond the end of the pack, or if the pack is
+  // not mapped.
+  MIXED_EXPORT int mixed_pack_seek(uint32_t frame, struct mixed_pack *pack);
   MIXED_EXPORT int mixed_pack_clear(struct mixed_pack *pack);
   MIXED_EXPORT uint32_t mixed_pack_available_write(struct mixed_pack *pack);
   MIXED_EXPORT uint32_t mixed_pack_available_read(struct mixed_pack *pack);
@@ -584,6 +999,29 @@ extern "C" {
   MIXED_EXPORT int mixed_pack_request_read(void **area, uint32_t *size, struct mixed_pack *pack);
   MIXED_EXPORT int mixed_pack_finish_read(uint32_t size, struct mixed_pack *pack); 
 
+  // Expose one channel of a pack as a buffer without copying.
+  //
+  // The pack must be planar and use MIXED_FLOAT, and the buffer must
+  // not own any storage. The buffer becomes a virtual view of the
+  // channel's plane and is marked MIXED_BUFFER_SHARED. Samples read
+  // through the view are exactly what the producer wrote to the
+  // pack, without any volume or clamping being applied. The view
+  // does not follow the pack on its own, see mixed_pack_sync_views.
+  // The view must not be used after the pack is freed, and should
+  // be freed with mixed_free_buffer as usual.
+  MIXED_EXPORT int mixed_make_buffer_view(struct mixed_pack *pack, channel_t channel, struct mixed_buffer *buffer);
+
+  // Bring the views of a pack up to date.
+  //
+  // All views must have been made from the pack with
+  // mixed_make_buffer_view and be in sync with it. The pack's read
+  // position is advanced by what the slowest of the views has read
+  // since the last sync, and afterwards all views see the pack's
+  // current read and write positions again. Call this from the
+  // reading thread before and after reading through the views. The
+  // unpacker segment does so on its own if its outputs are views.
+  MIXED_EXPORT int mixed_pack_sync_views(struct mixed_pack *pack, struct mixed_buffer **views, channel_t count);
+
   // Note that while this API deals with sound and you will probably
   // want to use threads to handle the playback, it is in itself not
   // thread safe and does not do any kind of locking or mutual
@@ -609,18 +1047,110 @@ extern "C" {
   // function again.
 
   // Allocate the buffer's internal storage array.
+  //
+  // You may set the buffer's flags field before this in order to
+  // request a specific kind of storage. See mixed_buffer_flags.
+  // Note that with MIXED_BUFFER_ALIGNED the buffer's size may be
+  // larger than requested.
   MIXED_EXPORT int mixed_make_buffer(uint32_t size, struct mixed_buffer *buffer);
 
   // Free the buffer's internal storage array.
+  //
+  // The flags you set to request a kind of storage are kept, so that
+  // making the buffer again gives the same kind of storage.
   MIXED_EXPORT void mixed_free_buffer(struct mixed_buffer *buffer);
 
+  // Allocate a pool of buffer storage.
+  //
+  // The pool is made up of size classes, each of which holds a fixed
+  // number of equally sized, aligned sample arrays. sizes and counts
+  // must be arrays of classes length, and sizes must be in ascending
+  // order. All storage is allocated up front, so that acquiring and
+  // releasing buffers from the pool never touches the system
+  // allocator.
+  //
+  // Acquiring and releasing buffers is lock-free and may be done
+  // from any number of threads at the same time.
+  MIXED_EXPORT int mixed_make_buffer_pool(uint32_t classes, uint32_t *sizes, uint32_t *counts, struct mixed_buffer_pool *pool);
+
+  // Free the pool's storage.
+  //
+  // All buffers acquired from the pool become invalid.
+  MIXED_EXPORT void mixed_free_buffer_pool(struct mixed_buffer_pool *pool);
+
+  // Initialise the buffer with storage from the pool.
+  //
+  // The storage is taken from the smallest size class that can hold
+  // the requested number of samples and still has free blocks. If no
+  // such block remains, the error is set to MIXED_OUT_OF_MEMORY.
+  // The buffer must not already be allocated.
+  MIXED_EXPORT int mixed_buffer_pool_acquire(uint32_t size, struct mixed_buffer *buffer, struct mixed_buffer_pool *pool);
+
+  // Return the buffer's storage to the pool.
+  //
+  // This also frees the buffer. Calling mixed_free_buffer on a
+  // pooled buffer instead will not return the storage to the pool.
+  MIXED_EXPORT int mixed_buffer_pool_release(struct mixed_buffer *buffer, struct mixed_buffer_pool *pool);
+
+  // Set the allocator used for all internal data.
+  //
+  // Every allocation libmixed performs on this thread after this
+  // call, be it for segment state, buffer storage, or packs, goes
+  // through the given allocator. Passing a null pointer restores
+  // the default allocator, which uses the C library functions.
+  //
+  // The allocator is remembered for every allocation, so it is safe
+  // to change the allocator at any time. However, the allocator
+  // struct must stay valid until everything allocated through it
+  // has been freed.
+  //
+  // Note that resampling states are managed by libsamplerate and do
+  // not go through this allocator.
+  MIXED_EXPORT int mixed_set_allocator(struct mixed_allocator *allocator);
+
+  // Return the allocator currently used on this thread.
+  MIXED_EXPORT struct mixed_allocator *mixed_get_allocator();
+
+  // Allocate a new arena of the given number of bytes.
+  //
+  // An arena hands out memory linearly from one contiguous region
+  // and never frees individual blocks. To use it, pass the arena's
+  // allocator to mixed_set_allocator while constructing a graph.
+  // This keeps the state of all segments and buffers of the graph
+  // close together in memory, and lets you tear it down again with
+  // a single call to mixed_free_arena.
+  //
+  // The used field tells you how many bytes have been handed out,
+  // so you can measure the memory used by a segment by comparing it
+  // before and after the segment has been made.
+  //
+  // Once the arena is exhausted, allocations through it fail with
+  // MIXED_OUT_OF_MEMORY.
+  MIXED_EXPORT int mixed_make_arena(size_t size, struct mixed_arena *arena);
+
+  // Free the arena's memory.
+  //
+  // Everything that was allocated from the arena becomes invalid.
+  // If the arena is the current allocator of the calling thread, the
+  // default allocator is restored. The allocator is set per thread,
+  // so every other thread that set the arena's allocator must set a
+  // different one before the arena is freed.
+  MIXED_EXPORT void mixed_free_arena(struct mixed_arena *arena);
+
+  // Mark all of the arena's memory as unused again.
+  //
+  // Everything that was allocated from the arena becomes invalid.
+  MIXED_EXPORT int mixed_arena_reset(struct mixed_arena *arena);
+
   // Convert the packed data to buffer data.
   //
   // This appropriately converts sample format and channel layout.
   // You are responsible for passing in an array of buffers that is
   // at least as long as the channel's channel count.
   // The volume is a multiplier you can pass to adjust the volume
-  // in the resulting buffers.
+  // in the resulting buffers. If it differs from the target volume, it
+  // is ramped linearly towards the target, by 1/1024 per frame,
+  // and updated to the volume reached at the end.
   // pack.frames should be set to the number of frames in the input
   // pack, and will be set to the number of frames that have actually
   // been read from the packed buffer. This may be less if the
@@ -633,13 +1163,33 @@ extern "C" {
   // You are responsible for passing in an array of buffers that is
   // at least as long as the channel's channel count.
   // The volume is a multiplier you can pass to adjust the volume
-  // in the resulting channel.
+  // in the resulting channel. If it differs from the target volume, it
+  // is ramped linearly towards the target, by 1/1024 per frame,
+  // and updated to the volume reached at the end.
   // pack.frames should be set to the number of frames in the output
   // pack, and will be set to the number of frames that have actually
   // been written to the pack. This may be less if the input buffers
   // do not have enough data available.
   MIXED_EXPORT int mixed_buffer_to_pack(struct mixed_buffer **ins, struct mixed_pack *out, float *volume, float target_volume);
 
+  // Convert packed data directly to another pack.
+  //
+  // This converts sample format and channel layout in one pass,
+  // staging only a small chunk of frames at a time rather than
+  // going through a set of buffers. If the output has more channels
+  // than the input, a mono input is repeated on all of them, and
+  // otherwise the extra channels are silent. Input channels that
+  // the output does not have are dropped. To reorder channels, use
+  // a converter segment with a MIXED_CHANNEL_MAP.
+  // The volume is handled as in mixed_buffer_from_pack.
+  // As much is converted as both packs allow.
+  //
+  // Both packs must share the same sample rate, otherwise the
+  // error is set to MIXED_BAD_RESAMPLE_FACTOR. Use the converter
+  // segment to resample in between. Block-coded encodings are not
+  // supported and fail with MIXED_UNKNOWN_ENCODING.
+  MIXED_EXPORT int mixed_pack_convert(struct mixed_pack *in, struct mixed_pack *out, float *volume, float target_volume);
+
   // Transfers data from one buffer to the other.
   //
   // This is equivalent to requesting a read from the from buffer,
@@ -647,6 +1197,13 @@ extern "C" {
   // possible over, and finally committing the read/write ops.
   // Note that doing this will effectively remove all transferred
   // data from the from buffer.
+  //
+  // If both buffers have MIXED_BUFFER_FORWARD set, the to buffer is
+  // empty, and both own storage of the same size and flags, the data
+  // arrays are swapped instead, so that the data is forwarded without
+  // copying. This makes bypassed and pass-through segments nearly
+  // free. Since the arrays change hands, do not hold on to areas of
+  // such buffers across a transfer.
   MIXED_EXPORT int mixed_buffer_transfer(struct mixed_buffer *from, struct mixed_buffer *to);
 
   // Copies data from one buffer to the other.
@@ -718,12 +1275,124 @@ extern "C" {
   // read is illegal.
   MIXED_EXPORT int mixed_buffer_finish_read(uint32_t size, struct mixed_buffer *buffer);
 
+  // Request reads and writes on a group of buffers at once.
+  //
+  // The in_areas and out_areas arrays must have room for as many
+  // pointers as the group has inputs and outputs respectively. They
+  // are filled with the read and write areas, all of which hold at
+  // least the number of frames stored in frames on return. Null
+  // entries in the group are skipped and get a null area.
+  //
+  // This is equivalent to requesting each buffer individually while
+  // narrowing the frame count, but it visits each buffer only once,
+  // so multi-channel segments do not need to request every buffer a
+  // second time after the common frame count is known.
+  // Every member keeps its own read and write positions, so the
+  // group still synchronises with the other side once per member. To
+  // share a single position across all channels, use a
+  // mixed_multibuffer instead.
+  //
+  // Returns 0 if no frame can be processed.
+  MIXED_EXPORT int mixed_buffer_group_request(float **in_areas, float **out_areas, uint32_t *frames, struct mixed_buffer_group *group);
+
+  // Finish reads and writes on a group of buffers at once.
+  //
+  // Every input is finished as a read and every output is finished
+  // as a write of the given number of frames. This publishes each
+  // member's position separately.
+  MIXED_EXPORT int mixed_buffer_group_finish(uint32_t frames, struct mixed_buffer_group *group);
+
+  // Allocate the storage of a planar multi-channel buffer.
+  //
+  // The channels field of the buffer must be set beforehand. The
+  // size is the number of frames per channel. Every channel plane
+  // starts on a 64 byte boundary.
+  MIXED_EXPORT int mixed_make_multibuffer(uint32_t size, struct mixed_multibuffer *buffer);
+
+  // Free the multibuffer's internal storage array.
+  MIXED_EXPORT void mixed_free_multibuffer(struct mixed_multibuffer *buffer);
+
+  // Clears the multibuffer to make it empty again.
+  MIXED_EXPORT int mixed_multibuffer_clear(struct mixed_multibuffer *buffer);
+
+  // Request frames to write to in all channels at once.
+  //
+  // The areas array must have room for as many pointers as the
+  // buffer has channels, and is filled with the write area of each
+  // channel. Otherwise this behaves like mixed_buffer_request_write.
+  MIXED_EXPORT int mixed_multibuffer_request_write(float **areas, uint32_t *frames, struct mixed_multibuffer *buffer);
+
+  // Commit frames written to all channels.
+  //
+  // See mixed_buffer_finish_write.
+  MIXED_EXPORT int mixed_multibuffer_finish_write(uint32_t frames, struct mixed_multibuffer *buffer);
+
+  // Request frames to read from in all channels at once.
+  //
+  // The areas array must have room for as many pointers as the
+  // buffer has channels, and is filled with the read area of each
+  // channel. Otherwise this behaves like mixed_buffer_request_read.
+  MIXED_EXPORT int mixed_multibuffer_request_read(float **areas, uint32_t *frames, struct mixed_multibuffer *buffer);
+
+  // Commit frames read from all channels.
+  //
+  // See mixed_buffer_finish_read.
+  MIXED_EXPORT int mixed_multibuffer_finish_read(uint32_t frames, struct mixed_multibuffer *buffer);
+
+  // Returns the number of frames available to read.
+  MIXED_EXPORT uint32_t mixed_multibuffer_available_read(struct mixed_multibuffer *buffer);
+
+  // Returns the number of frames available to write.
+  MIXED_EXPORT uint32_t mixed_multibuffer_available_write(struct mixed_multibuffer *buffer);
+
+  // Transfers data from one multibuffer to the other.
+  //
+  // Only as many channels as both buffers have are copied. The
+  // remaining channels of the to buffer are filled with silence.
+  // See mixed_buffer_transfer.
+  MIXED_EXPORT int mixed_multibuffer_transfer(struct mixed_multibuffer *from, struct mixed_multibuffer *to);
+
   // Resize the buffer to a new size.
   //
+  // The unread data is moved to the front of the new storage, so
+  // no buffered samples are lost unless the new size is too small
+  // to hold them all, in which case the newest ones are dropped.
+  // Any pending write reservation is discarded.
+  //
   // If the resizing operation fails due to a lack of memory, the
   // old data is preserved and the buffer is not changed.
   MIXED_EXPORT int mixed_buffer_resize(uint32_t size, struct mixed_buffer *buffer);
 
+  // Prepare a resize of a buffer that is in use on another thread.
+  //
+  // This allocates the new storage on the calling thread, but does
+  // not touch the buffer's data. The thread that reads and writes
+  // the buffer then switches over to the new storage by calling
+  // mixed_buffer_apply_resize, which does not allocate. Any storage
+  // that was left behind by a previous apply is freed first.
+  //
+  // Only one resize may be staged at a time. If one is still
+  // pending, this fails with MIXED_BUFFER_ALLOCATED.
+  MIXED_EXPORT int mixed_buffer_stage_resize(uint32_t size, struct mixed_buffer *buffer);
+
+  // Switch a buffer over to the storage prepared by
+  // mixed_buffer_stage_resize.
+  //
+  // This must be called from the thread that uses the buffer, while
+  // no read or write is in progress, for instance between two mixes
+  // of the segments that the buffer connects. The unread data is
+  // moved over as by mixed_buffer_resize. The old storage is not
+  // freed here, but on the next call to mixed_buffer_stage_resize,
+  // mixed_buffer_reclaim_resize, or mixed_free_buffer.
+  //
+  // Returns 1 if a staged resize was applied, and 0 otherwise.
+  MIXED_EXPORT int mixed_buffer_apply_resize(struct mixed_buffer *buffer);
+
+  // Free the storage left behind by mixed_buffer_apply_resize.
+  //
+  // This should be called from the thread that staged the resize.
+  MIXED_EXPORT int mixed_buffer_reclaim_resize(struct mixed_buffer *buffer);
+
   // Convenience macro for the common operation of transferring
   // from one buffer to another.
   //
@@ -875,6 +1544,11 @@ extern "C" {
   // The sample rate given denotes the target sample rate of the
   // buffers connected to the outputs of this segment. The source
   // sample rate is the sample rate stored in the channel.
+  //
+  // If every output is a view of the matching pack plane, as made
+  // by mixed_make_buffer_view, nothing is converted and the segment
+  // only keeps the views in sync with the pack. Volume changes then
+  // have no effect, and the sample rates must match.
   MIXED_EXPORT int mixed_make_segment_unpacker(struct mixed_pack *packed, uint32_t samplerate, struct mixed_segment *segment);
 
   // An audio packer.
@@ -887,8 +1561,27 @@ extern "C" {
   // The sample rate given denotes the source sample rate of the
   // buffers connected to the inputs of this segment. The target
   // sample rate is the sample rate stored in the channel.
+  //
+  // Views of the pack, as made by mixed_make_buffer_view, cannot be
+  // used as inputs, and starting fails with MIXED_INVALID_VALUE.
+  //
+  // Block-coded packs are written a whole block at a time. When the
+  // segment is ended, the frames of a remaining partial block are
+  // padded with silence and encoded, provided the pack has room.
   MIXED_EXPORT int mixed_make_segment_packer(struct mixed_pack *packed, uint32_t samplerate, struct mixed_segment *segment);
 
+  // A pack to pack converter.
+  //
+  // This segment converts the data from one pack directly into
+  // another, as with mixed_pack_convert. If the sample rates of
+  // the two packs differ, the data is resampled in between, which
+  // is not supported for planar packs.
+  // With MIXED_CHANNEL_MAP set, output channel i draws from input
+  // channel channels[i] instead, so channels can be reordered or
+  // repeated. Output channels past the map's count are silent.
+  // The segment has no inputs or outputs.
+  MIXED_EXPORT int mixed_make_segment_converter(struct mixed_pack *in, struct mixed_pack *out, struct mixed_segment *segment);
+
   // A basic, additive mixer
   //
   // This segment simply linearly mixes every input together into
@@ -1127,6 +1820,21 @@ extern "C" {
   // A chain segment is useful for operating on many segments at once.
   MIXED_EXPORT int mixed_make_segment_chain(struct mixed_segment *segment);
 
+  // Create a graph segment
+  //
+  // A graph segment runs a set of segments in the order their
+  // connections demand, rather than in the order they were added.
+  // See mixed_graph_connect.
+  //
+  // If MIXED_THREADS is set above one, the mixing thread and the
+  // graph's own threads share out the segments, each taking those
+  // whose connections have all been mixed already. Idle threads
+  // spin for a moment before they go to sleep until the next mix.
+  // Only the connections made through mixed_graph_connect are
+  // known to the graph, so segments that share buffers or other
+  // state in any other way must not be mixed with several threads.
+  MIXED_EXPORT int mixed_make_segment_graph(struct mixed_segment *segment);
+
   // A segment to quantize the amplitude
   //
   // The signal will be quantized into STEPS number of discrete amplitudes.
@@ -1152,6 +1860,45 @@ extern "C" {
   MIXED_EXPORT int mixed_chain_remove(struct mixed_segment *segment, struct mixed_segment *chain);
   MIXED_EXPORT int mixed_chain_remove_at(uint32_t i, struct mixed_segment *chain);
 
+  // Add a segment to the graph.
+  //
+  // A segment can only be added to the same graph once. Segments
+  // that do not depend on each other run in the order they were
+  // added in.
+  //
+  // It is /NOT/ safe to change a graph from multiple threads at
+  // once, or while it is mixing.
+  MIXED_EXPORT int mixed_graph_add(struct mixed_segment *segment, struct mixed_segment *graph);
+
+  // Remove a segment and all of its connections from the graph.
+  MIXED_EXPORT int mixed_graph_remove(struct mixed_segment *segment, struct mixed_segment *graph);
+
+  // Connect an output of one segment to an input of another.
+  //
+  // Both segments must have been added to the graph. The buffer is
+  // set as the MIXED_BUFFER of both ports, and the graph records
+  // that the to segment has to run after the from segment. Any
+  // earlier connection of either port is replaced.
+  //
+  // The order is only worked out again when the connections or
+  // segments have changed, at the latest on the next start or mix
+  // of the graph. If the connections form a cycle, that fails with
+  // MIXED_GRAPH_CYCLE. Segments added to a graph that has already
+  // been started must be started by you.
+  MIXED_EXPORT int mixed_graph_connect(struct mixed_segment *from, uint32_t out, struct mixed_segment *to, uint32_t in, struct mixed_buffer *buffer, struct mixed_segment *graph);
+
+  // Remove the connection to the given input.
+  //
+  // The buffer stays set on both ports, but the segments no longer
+  // have to run in any particular order.
+  MIXED_EXPORT int mixed_graph_disconnect(struct mixed_segment *to, uint32_t in, struct mixed_segment *graph);
+
+  // Access the order the graph runs its segments in.
+  //
+  // The order is worked out first if necessary. The array belongs
+  // to the graph and is only valid until it is changed.
+  MIXED_EXPORT int mixed_graph_plan(struct mixed_segment ***segments, uint32_t *count, struct mixed_segment *graph);
+
   typedef int (*mixed_make_segment_function)(void *args, struct mixed_segment *segment);
   typedef int (*mixed_register_segment_function)(char *name, uint32_t argc, struct mixed_segment_field_info *args, mixed_make_segment_function function);
   typedef int (*mixed_deregister_segment_function)(char *name);
@@ -1219,12 +1966,20 @@ extern "C" {
   MIXED_EXPORT int mixed_make_segment(char *name, void *args, struct mixed_segment *segment);
 
   // Return the size of a sample in the given encoding in bytes.
+  // Returns 0 for block-coded encodings such as MIXED_IMA_ADPCM.
   MIXED_EXPORT uint8_t mixed_samplesize(enum mixed_encoding encoding);
   
+  // Sample format converter functions.
+  //
+  // These convert samples between an array that holds every
+  // stride-th sample and a contiguous float array. The volume is
+  // ramped towards the target volume as described in
+  // mixed_buffer_from_pack, and the volume reached is returned.
   typedef float (*mixed_transfer_function_from)(void *in, float *out, uint8_t stride, uint32_t samples, float volume, float target_volume);
   typedef float (*mixed_transfer_function_to)(float *in, void *out, uint8_t stride, uint32_t samples, float volume, float target_volume);
 
   // Retrieve a sample format converter function.
+  // Returns 0 if the encoding is not known.
   MIXED_EXPORT mixed_transfer_function_from mixed_translator_from(enum mixed_encoding encoding);
   MIXED_EXPORT mixed_transfer_function_to mixed_translator_to(enum mixed_encoding encoding);
 
@@ -0,0 +1,112 @@
+#include "internal.h"
+#include "bip.h"
+
+MIXED_EXPORT int mixed_make_multibuffer(uint32_t size, struct mixed_multibuffer *buffer){
+  mixed_err(MIXED_NO_ERROR);
+  if(buffer->_data){
+    mixed_err(MIXED_BUFFER_ALLOCATED);
+    return 0;
+  }
+  if(buffer->channels == 0 || size == 0){
+    mixed_err(MIXED_INVALID_VALUE);
+    return 0;
+  }
+  // Pad each plane so that every channel starts aligned.
+  uint32_t stride = ((size + BUFFER_ALIGNMENT_SAMPLES - 1) / BUFFER_ALIGNMENT_SAMPLES) * BUFFER_ALIGNMENT_SAMPLES;
+  buffer->_data = aligned_calloc((size_t)stride*buffer->channels, sizeof(float), BUFFER_ALIGNMENT);
+  if(!buffer->_data){
+    mixed_err(MIXED_OUT_OF_MEMORY);
+    return 0;
+  }
+  buffer->_stride = stride;
+  buffer->size = size;
+  buffer->flags = MIXED_BUFFER_ALIGNED;
+  mixed_multibuffer_clear(buffer);
+  return 1;
+}
+
+MIXED_EXPORT void mixed_free_multibuffer(struct mixed_multibuffer *buffer){
+  if(buffer->_data)
+    aligned_free(buffer->_data);
+  buffer->_data = 0;
+  buffer->size = 0;
+  buffer->_stride = 0;
+  buffer->flags = 0;
+  mixed_multibuffer_clear(buffer);
+}
+
+MIXED_EXPORT int mixed_multibuffer_clear(struct mixed_multibuffer *buffer){
+  buffer->read = 0;
+  buffer->write = 0;
+  buffer->reserved = 0;
+  buffer->_read_cache = 0;
+  buffer->_write_cache = 0;
+  return 1;
+}
+
+static inline void fill_areas(float **areas, uint32_t off, struct mixed_multibuffer *buffer){
+  float *data = buffer->_data+off;
+  for(uint32_t c=0; c<buffer->channels; ++c){
+    areas[c] = data;
+    data += buffer->_stride;
+  }
+}
+
+MIXED_EXPORT int mixed_multibuffer_request_write(float **areas, uint32_t *frames, struct mixed_multibuffer *buffer){
+  uint32_t off = 0;
+  if(!bip_request_write(&off, frames, (struct bip*)buffer)){
+    for(uint32_t c=0; c<buffer->channels; ++c)
+      areas[c] = 0;
+    return 0;
+  }
+  fill_areas(areas, off, buffer);
+  return 1;
+}
+
+MIXED_EXPORT int mixed_multibuffer_finish_write(uint32_t frames, struct mixed_multibuffer *buffer){
+  return bip_finish_write(frames, (struct bip*)buffer);
+}
+
+MIXED_EXPORT int mixed_multibuffer_request_read(float **areas, uint32_t *frames, struct mixed_multibuffer *buffer){
+  uint32_t off = 0;
+  if(!bip_request_read(&off, frames, (struct bip*)buffer)){
+    for(uint32_t c=0; c<buffer->channels; ++c)
+      areas[c] = 0;
+    return 0;
+  }
+  fill_areas(areas, off, buffer);
+  return 1;
+}
+
+MIXED_EXPORT int mixed_multibuffer_finish_read(uint32_t frames, struct mixed_multibuffer *buffer){
+  return bip_finish_read(frames, (struct bip*)buffer);
+}
+
+MIXED_EXPORT uint32_t mixed_multibuffer_available_read(struct mixed_multibuffer *buffer){
+  return bip_available_read((struct bip*)buffer);
+}
+
+MIXED_EXPORT uint32_t mixed_multibuffer_available_write(struct mixed_multibuffer *buffer){
+  return bip_available_write((struct bip*)buffer);
+}
+
+MIXED_EXPORT int mixed_multibuffer_transfer(struct mixed_multibuffer *from, struct mixed_multibuffer *to){
+  mixed_err(MIXED_NO_ERROR);
+  if(from != to){
+    uint32_t frames = UINT32_MAX;
+    uint32_t from_off = 0, to_off = 0;
+    bip_request_read(&from_off, &frames, (struct bip*)from);
+    bip_request_write(&to_off, &frames, (struct bip*)to);
+    uint32_t channels = MIN(from->channels, to->channels);
+    for(uint32_t c=0; c<to->channels; ++c){
+      float *write = to->_data + (size_t)c*to->_stride + to_off;
+      if(c < channels)
+        memcpy(write, from->_data + (size_t)c*from->_stride + from_off, sizeof(float)*frames);
+      else
+        memset(write, 0, sizeof(float)*frames);
+    }
+    bip_finish_read(frames, (struct bip*)from);
+    bip_finish_write(frames, (struct bip*)to);
+  }
+  return 1;
+}
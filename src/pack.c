@@ -1,54 +1,491 @@
 #include "internal.h"
 #include "bip.h"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// The number of bytes to request ahead of the read pointer on mapped packs.
+#define READAHEAD_SIZE (1024*1024)
+// The reader sets the low bit of _waiting, writers count above it.
+#define WAITING_READ 0x1
+#define WAITING_WRITE 0x2
+// How often to spin on a pending commit before yielding the thread.
+#define SPIN_COUNT 64
+
+#ifndef _WIN32
+static inline uintptr_t page_start(void *ptr){
+  uintptr_t page = sysconf(_SC_PAGESIZE);
+  return (uintptr_t)ptr & ~(page-1);
+}
+
+// Release the pages between from and to, and prefetch the ones after to.
+static void advise_mapping(uint32_t from, uint32_t to, struct mixed_pack *pack){
+  uintptr_t start = page_start(pack->_data+from);
+  uintptr_t end = page_start(pack->_data+to);
+  if(start < end)
+    madvise((void*)start, end-start, MADV_DONTNEED);
+  start = end;
+  end = (uintptr_t)pack->_data + MIN((uint64_t)pack->size, (uint64_t)to+2*READAHEAD_SIZE);
+  if(start < end)
+    madvise((void*)start, end-start, MADV_WILLNEED);
+}
+#else
+static void advise_mapping(uint32_t from, uint32_t to, struct mixed_pack *pack){
+  IGNORE(from, to, pack);
+}
+#endif
 
 MIXED_EXPORT int mixed_make_pack(uint32_t frames, struct mixed_pack *pack){
   mixed_err(MIXED_NO_ERROR);
-  pack->_data = calloc(frames*pack->channels, mixed_samplesize(pack->encoding));
+  if(pack->flags & MIXED_PACK_MULTI_PRODUCER)
+    pack->flags |= MIXED_PACK_MIRRORED;
+  uint32_t unit = pack_unit_frames(pack);
+  size_t size = (((uint64_t)frames + unit - 1) / unit) * pack_unit_bytes(pack);
+  if(pack->flags & MIXED_PACK_PLANAR){
+    // The planes cannot be mirrored individually, and blocks
+    // interleave their channels by definition.
+    if((pack->flags & MIXED_PACK_MIRRORED) || pack->encoding == MIXED_IMA_ADPCM){
+      mixed_err(MIXED_NOT_IMPLEMENTED);
+      return 0;
+    }
+    pack->_data = mixed_calloc(size, pack->channels);
+    if(!pack->_data){
+      mixed_err(MIXED_OUT_OF_MEMORY);
+      return 0;
+    }
+    pack->size = size;
+    return 1;
+  }
+  if(pack->flags & MIXED_PACK_MIRRORED){
+    size_t bytes = size;
+    if(MIRROR_MAX_SIZE <= size){
+      mixed_err(MIXED_INVALID_VALUE);
+      return 0;
+    }
+    pack->_data = mirror_alloc(&bytes, MIRROR_MAX_SIZE);
+    if(pack->_data){
+      pack->size = bytes;
+      return 1;
+    }
+    // Reservations must not be split at the wrap point, so we cannot fall back.
+    if(pack->flags & MIXED_PACK_MULTI_PRODUCER){
+      mixed_err(MIXED_NOT_IMPLEMENTED);
+      return 0;
+    }
+    // Mirroring is not supported, fall back to a regular pack.
+    pack->flags &= ~MIXED_PACK_MIRRORED;
+  }
+  pack->_data = mixed_calloc(size, 1);
   if(!pack->_data){
     mixed_err(MIXED_OUT_OF_MEMORY);
     return 0;
   }
-  pack->size = frames*pack->channels*mixed_samplesize(pack->encoding);
+  pack->size = size;
   return 1;
 }
 
 MIXED_EXPORT void mixed_free_pack(struct mixed_pack *pack){
+#ifndef _WIN32
+  if(pack->flags & MIXED_PACK_MAPPED){
+    uintptr_t base = page_start(pack->_data);
+    munmap((void*)base, ((uintptr_t)pack->_data - base) + pack->size);
+    pack->_data = 0;
+  }
+#endif
+  if(pack->flags & MIXED_PACK_MIRRORED){
+    mirror_free(pack->_data, pack->size);
+    pack->_data = 0;
+  }
   if(pack->_data)
-    free(pack->_data);
+    mixed_free(pack->_data);
   pack->_data = 0;
   pack->size = 0;
+  pack->flags &= ~(MIXED_PACK_MAPPED | MIXED_PACK_MIRRORED);
   mixed_pack_clear(pack);
 }
 
+MIXED_EXPORT int mixed_make_pack_mmap(char *path, uint64_t offset, uint32_t frames, struct mixed_pack *pack){
+  mixed_err(MIXED_NO_ERROR);
+#ifdef _WIN32
+  IGNORE(path, offset, frames, pack);
+  mixed_err(MIXED_NOT_IMPLEMENTED);
+  return 0;
+#else
+  uint32_t framesize = pack_unit_bytes(pack);
+  uint32_t unit = pack_unit_frames(pack);
+  struct stat info = {0};
+  if(pack->flags & MIXED_PACK_PLANAR){
+    mixed_err(MIXED_NOT_IMPLEMENTED);
+    return 0;
+  }
+  if(framesize == 0){
+    mixed_err(MIXED_INVALID_VALUE);
+    return 0;
+  }
+  
+  int fd = open(path, O_RDONLY);
+  if(fd < 0 || fstat(fd, &info) < 0){
+    if(0 <= fd) close(fd);
+    mixed_err(MIXED_MAPPING_FAILED);
+    return 0;
+  }
+
+  uint64_t available = ((uint64_t)info.st_size < offset)? 0 : ((uint64_t)info.st_size - offset) / framesize;
+  // For block-coded encodings we count in whole blocks.
+  uint64_t units = ((uint64_t)frames + unit - 1) / unit;
+  if(units == 0)
+    units = MIN(available, 0x7FFFFFFF / framesize);
+  if(units == 0 || available < units || 0x7FFFFFFF / framesize < units){
+    close(fd);
+    mixed_err(MIXED_INVALID_VALUE);
+    return 0;
+  }
+  
+  uint32_t size = units*framesize;
+  uint64_t start = offset - offset % sysconf(_SC_PAGESIZE);
+  size_t length = (offset - start) + size;
+  void *map = mmap(0, length, PROT_READ, MAP_SHARED, fd, start);
+  close(fd);
+  if(map == MAP_FAILED){
+    mixed_err(MIXED_MAPPING_FAILED);
+    return 0;
+  }
+  madvise(map, length, MADV_SEQUENTIAL);
+
+  pack->_data = (unsigned char *)map + (offset - start);
+  pack->size = size;
+  mixed_pack_clear(pack);
+  pack->write = size;
+  pack->flags |= MIXED_PACK_MAPPED;
+  advise_mapping(0, 0, pack);
+  return 1;
+#endif
+}
+
+MIXED_EXPORT int mixed_pack_seek(uint32_t frame, struct mixed_pack *pack){
+  mixed_err(MIXED_NO_ERROR);
+  uint64_t position = (uint64_t)(frame / pack_unit_frames(pack))*pack_unit_bytes(pack);
+  if(!(pack->flags & MIXED_PACK_MAPPED) || pack->size < position){
+    mixed_err(MIXED_INVALID_VALUE);
+    return 0;
+  }
+  atomic_write(pack->read, (uint32_t)position);
+  atomic_write(pack->write, pack->size);
+  advise_mapping(position, position, pack);
+  return 1;
+}
+
 MIXED_EXPORT int mixed_pack_clear(struct mixed_pack *pack){
   pack->read = 0;
   pack->write = 0;
   pack->reserved = 0;
+  pack->_read_cache = 0;
+  pack->_write_cache = 0;
+  pack->_read_start = 0;
   return 1;
 }
 
 MIXED_EXPORT int mixed_pack_request_write(void **area, uint32_t *size, struct mixed_pack *pack){
   uint32_t off = 0;
+  if(pack->flags & MIXED_PACK_MAPPED){
+    mixed_err(MIXED_BUFFER_FULL);
+    *size = 0;
+    return 0;
+  }
+  if(pack->flags & MIXED_PACK_MULTI_PRODUCER){
+    mixed_err(MIXED_INVALID_VALUE);
+    *size = 0;
+    return 0;
+  }
   if(!bip_request_write(&off, size, (struct bip*)pack))
      return 0;
   *area = pack->_data+off;
   return 1;
 }
 
+static void notify_write(uint32_t before, uint32_t size, struct mixed_pack *pack){
+  if(pack->on_high_watermark && before < pack->high_watermark && pack->high_watermark <= before+size)
+    pack->on_high_watermark(pack);
+  if(pack->flags & MIXED_PACK_WAITABLE){
+    // Make sure our write is visible before we check for a waiting reader.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if((atomic_read(pack->_waiting) & WAITING_READ) && pack->_wanted_read <= bip_used((struct bip*)pack))
+      futex_wake(&pack->write);
+  }
+}
+
 MIXED_EXPORT int mixed_pack_finish_write(uint32_t size, struct mixed_pack *pack){
-  return bip_finish_write(size, (struct bip*)pack);
+  // This would commit past the outstanding reservations.
+  if(pack->flags & MIXED_PACK_MULTI_PRODUCER){
+    mixed_err(MIXED_INVALID_VALUE);
+    return 0;
+  }
+  uint32_t before = (pack->on_high_watermark)? bip_used((struct bip*)pack) : 0;
+  if(!bip_finish_write(size, (struct bip*)pack))
+    return 0;
+  notify_write(before, size, pack);
+  return 1;
+}
+
+// On multi-producer packs the reserved field holds the claim pointer,
+// which runs ahead of the write pointer by the outstanding reservations.
+MIXED_EXPORT int mixed_pack_reserve(uint32_t size, struct mixed_pack_reservation *reservation, struct mixed_pack *pack){
+  mixed_err(MIXED_NO_ERROR);
+  struct bip *buffer = (struct bip*)pack;
+  uint32_t framesize = pack_unit_bytes(pack);
+  uint32_t claim = atomic_acquire(buffer->reserved);
+  uint32_t next;
+  if(!(pack->flags & MIXED_PACK_MULTI_PRODUCER)){
+    mixed_err(MIXED_INVALID_VALUE);
+    return 0;
+  }
+  do{
+    uint32_t available = buffer->size - ring_used(atomic_acquire(buffer->read), claim, buffer);
+    size = MIN(size, available);
+    size -= size % framesize;
+    if(size == 0){
+      mixed_err(MIXED_BUFFER_FULL);
+      return 0;
+    }
+    next = ring_advance(claim, size, buffer);
+  }while(!__atomic_compare_exchange_n(&buffer->reserved, &claim, next, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+  reservation->area = pack->_data + (claim % buffer->size);
+  reservation->size = size;
+  reservation->_start = claim;
+  return 1;
+}
+
+MIXED_EXPORT int mixed_pack_commit(struct mixed_pack_reservation *reservation, struct mixed_pack *pack){
+  mixed_err(MIXED_NO_ERROR);
+  struct bip *buffer = (struct bip*)pack;
+  uint32_t before = (pack->on_high_watermark)? bip_used(buffer) : 0;
+  // Wait for the reservations before ours to be committed.
+  for(uint32_t i=0; atomic_acquire(buffer->write) != reservation->_start; ++i){
+    if(SPIN_COUNT < i) thread_yield();
+  }
+  atomic_release(buffer->write, ring_advance(reservation->_start, reservation->size, buffer));
+  notify_write(before, reservation->size, pack);
+  reservation->area = 0;
+  reservation->size = 0;
+  return 1;
+}
+
+// With MIXED_OVERFLOW_DROP_OLDEST the writer may advance the read
+// pointer under us. We remember where the read started, so that the
+// finish can tell whether the writer dropped data in between.
+static inline bool read_contended(struct mixed_pack *pack){
+  return pack->overflow == MIXED_OVERFLOW_DROP_OLDEST && (pack->flags & MIXED_PACK_MIRRORED);
+}
+
+static int request_read_contended(uint32_t *off, uint32_t *size, struct bip *buffer, struct mixed_pack *pack){
+  uint32_t read = atomic_acquire(buffer->read);
+  uint32_t available = ring_used(read, atomic_acquire(buffer->write), buffer);
+  pack->_read_start = read;
+  if(available == 0){
+    *size = 0;
+    *off = 0;
+    return 0;
+  }
+  *size = MIN(*size, available);
+  *off = read % buffer->size;
+  return 1;
+}
+
+static int finish_read_contended(uint32_t size, struct bip *buffer, struct mixed_pack *pack){
+  uint32_t read = pack->_read_start;
+  if(ring_used(read, atomic_acquire(buffer->write), buffer) < size){
+    mixed_err(MIXED_BUFFER_OVERCOMMIT);
+    return 0;
+  }
+  uint32_t next = ring_advance(read, size, buffer);
+  if(!__atomic_compare_exchange_n(&buffer->read, &read, next, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED)){
+    // The drop already moved the read pointer past what we read.
+    mixed_err(MIXED_BUFFER_DROPPED);
+    return 0;
+  }
+  pack->_read_start = next;
+  return 1;
 }
 
 MIXED_EXPORT int mixed_pack_request_read(void **area, uint32_t *size, struct mixed_pack *pack){
   uint32_t off = 0;
-  if(!bip_request_read(&off, size, (struct bip*)pack))
+  if(read_contended(pack)){
+    if(!request_read_contended(&off, size, (struct bip*)pack, pack))
+      return 0;
+  }else if(!bip_request_read(&off, size, (struct bip*)pack))
     return 0;
   *area = pack->_data+off;
   return 1;
 }
 
 MIXED_EXPORT int mixed_pack_finish_read(uint32_t size, struct mixed_pack *pack){
-  return bip_finish_read(size, (struct bip*)pack);
+  uint32_t read = pack->read;
+  uint32_t before = (pack->on_low_watermark)? bip_used((struct bip*)pack) : 0;
+  if(read_contended(pack)){
+    if(!finish_read_contended(size, (struct bip*)pack, pack))
+      return 0;
+  }else if(!bip_finish_read(size, (struct bip*)pack))
+    return 0;
+  if((pack->flags & MIXED_PACK_MAPPED) && read / READAHEAD_SIZE != (read+size) / READAHEAD_SIZE)
+    advise_mapping(read - read % READAHEAD_SIZE, read+size, pack);
+  if(pack->on_low_watermark && pack->low_watermark < before && before-size <= pack->low_watermark)
+    pack->on_low_watermark(pack);
+  if(pack->flags & MIXED_PACK_WAITABLE){
+    // Make sure our read is visible before we check for a waiting writer.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    // Multiple producers may be waiting for different amounts, so wake them all.
+    if((atomic_read(pack->_waiting) & ~WAITING_READ)
+       && ((pack->flags & MIXED_PACK_MULTI_PRODUCER) || pack->_wanted_write <= pack->size - bip_used((struct bip*)pack)))
+      futex_wake(&pack->read);
+  }
+  return 1;
+}
+
+// Block on the word until the condition holds, announcing which side we are.
+#define WAIT_ON(WORD, SIDE, WANTED, CONDITION, ERROR)                     \
+  mixed_err(MIXED_NO_ERROR);                                            \
+  if(!(pack->flags & MIXED_PACK_WAITABLE) || pack->size < bytes){        \
+    mixed_err(MIXED_INVALID_VALUE);                                     \
+    return 0;                                                           \
+  }                                                                     \
+  uint64_t deadline = monotonic_ms() + timeout;                         \
+  for(;;){                                                              \
+    uint32_t value = atomic_read(WORD);                                 \
+    if(CONDITION) return 1;                                             \
+    int32_t remaining = -1;                                             \
+    if(0 <= timeout){                                                   \
+      uint64_t now = monotonic_ms();                                    \
+      remaining = (now < deadline)? deadline - now : 0;                 \
+      if(remaining == 0){                                               \
+        mixed_err(ERROR);                                               \
+        return 0;                                                       \
+      }                                                                 \
+    }                                                                   \
+    WANTED = bytes;                                                     \
+    __atomic_fetch_add(&pack->_waiting, SIDE, __ATOMIC_SEQ_CST);        \
+    if(!(CONDITION))                                                    \
+      futex_wait(&WORD, value, remaining);                              \
+    __atomic_fetch_sub(&pack->_waiting, SIDE, __ATOMIC_SEQ_CST);        \
+  }
+
+MIXED_EXPORT int mixed_pack_wait_read(uint32_t bytes, int32_t timeout, struct mixed_pack *pack){
+  WAIT_ON(pack->write, WAITING_READ, pack->_wanted_read,
+          bytes <= bip_used((struct bip*)pack),
+          MIXED_BUFFER_EMPTY);
+}
+
+// Outstanding reservations of multi-producer packs take up space
+// that has not been committed yet, so count from the claim pointer.
+static inline uint32_t free_space(struct mixed_pack *pack){
+  struct bip *buffer = (struct bip*)pack;
+  if(pack->flags & MIXED_PACK_MULTI_PRODUCER)
+    return buffer->size - ring_used(atomic_acquire(buffer->read), atomic_acquire(buffer->reserved), buffer);
+  return buffer->size - bip_used(buffer);
+}
+
+MIXED_EXPORT int mixed_pack_wait_write(uint32_t bytes, int32_t timeout, struct mixed_pack *pack){
+  WAIT_ON(pack->read, WAITING_WRITE, pack->_wanted_write,
+          bytes <= free_space(pack),
+          MIXED_BUFFER_FULL);
+}
+
+// Copy as much as currently fits, going across the wrap point.
+static uint32_t write_available(unsigned char *data, uint32_t bytes, struct mixed_pack *pack){
+  uint32_t written = 0;
+  if(pack->flags & MIXED_PACK_MULTI_PRODUCER){
+    struct mixed_pack_reservation reservation = {0};
+    if(mixed_pack_reserve(bytes, &reservation, pack)){
+      memcpy(reservation.area, data, reservation.size);
+      written = reservation.size;
+      mixed_pack_commit(&reservation, pack);
+    }
+    return written;
+  }
+  while(written < bytes){
+    void *area;
+    uint32_t size = bytes - written;
+    if(!mixed_pack_request_write(&area, &size, pack))
+      break;
+    memcpy(area, data+written, size);
+    mixed_pack_finish_write(size, pack);
+    written += size;
+  }
+  return written;
+}
+
+// Advance the reader far enough to fit the given number of bytes.
+// Whole frames are dropped, so that the reader stays aligned.
+static void drop_oldest(uint32_t bytes, struct mixed_pack *pack){
+  struct bip *buffer = (struct bip*)pack;
+  uint32_t unit = pack_unit_bytes(pack);
+  uint32_t write = atomic_owned(buffer->write);
+  uint32_t read = atomic_acquire(buffer->read);
+  uint32_t next;
+  do{
+    uint32_t used = ring_used(read, write, buffer);
+    uint32_t free = buffer->size - used;
+    if(bytes <= free) return;
+    uint32_t drop = ((bytes - free + unit - 1) / unit) * unit;
+    next = ring_advance(read, MIN(drop, used), buffer);
+  }while(!__atomic_compare_exchange_n(&buffer->read, &read, next, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+  buffer->read_cache = next;
+}
+
+MIXED_EXPORT int mixed_pack_write(void *data, uint32_t *bytes, int32_t timeout, struct mixed_pack *pack){
+  mixed_err(MIXED_NO_ERROR);
+  unsigned char *source = (unsigned char *)data;
+  uint32_t total = *bytes;
+  if(pack->flags & MIXED_PACK_PLANAR){
+    mixed_err(MIXED_INVALID_VALUE);
+    *bytes = 0;
+    return 0;
+  }
+  switch(pack->overflow){
+  case MIXED_OVERFLOW_DROP_OLDEST:
+    if(!(pack->flags & MIXED_PACK_MIRRORED) || (pack->flags & MIXED_PACK_MULTI_PRODUCER)){
+      mixed_err(MIXED_INVALID_VALUE);
+      *bytes = 0;
+      return 0;
+    }
+    // Only the tail of the data can survive anyway.
+    if(pack->size < total){
+      source += total - pack->size;
+      total = pack->size;
+    }
+    drop_oldest(total, pack);
+    *bytes = write_available(source, total, pack);
+    return 1;
+  case MIXED_OVERFLOW_DROP_NEWEST:
+    *bytes = write_available(source, total, pack);
+    return 1;
+  default:{
+    uint64_t deadline = monotonic_ms() + timeout;
+    uint32_t written = write_available(source, total, pack);
+    // Without waiting support, behave as if the timeout expired at once.
+    if(written < total && !(pack->flags & MIXED_PACK_WAITABLE)){
+      mixed_err(MIXED_BUFFER_FULL);
+      *bytes = written;
+      return 0;
+    }
+    while(written < total){
+      int32_t remaining = -1;
+      if(0 <= timeout){
+        uint64_t now = monotonic_ms();
+        remaining = (now < deadline)? deadline - now : 0;
+      }
+      if(!mixed_pack_wait_write(MIN(total-written, pack->size), remaining, pack)){
+        *bytes = written;
+        return 0;
+      }
+      written += write_available(source+written, total-written, pack);
+    }
+    *bytes = written;
+    return 1;
+  }
+  }
 }
 
 MIXED_EXPORT uint32_t mixed_pack_available_read(struct mixed_pack *pack){
@@ -56,5 +493,75 @@ MIXED_EXPORT uint32_t mixed_pack_available_read(struct mixed_pack *pack){
 }
 
 MIXED_EXPORT uint32_t mixed_pack_available_write(struct mixed_pack *pack){
+  if(pack->flags & MIXED_PACK_MAPPED)
+    return 0;
   return bip_available_write((struct bip*)pack);
 }
+
+// Pack positions count bytes, view positions count floats. The wrap
+// bit of the write position carries over unchanged.
+static inline uint32_t view_position(uint32_t position){
+  return (position & 0x80000000) | ((position & 0x7FFFFFFF) / sizeof(float));
+}
+
+// Hand the pack's current positions to the views. The write position
+// is also kept in the view's cache, which views do not otherwise use.
+static void publish_views(struct mixed_pack *pack, struct mixed_buffer **views, channel_t count){
+  uint32_t read = view_position(atomic_read(pack->read));
+  uint32_t write = view_position(atomic_read(pack->write));
+  for(channel_t c=0; c<count; ++c){
+    struct mixed_buffer *view = views[c];
+    atomic_write(view->write, write);
+    atomic_write(view->read, read);
+    view->_write_cache = write;
+    view->_read_cache = read;
+  }
+}
+
+MIXED_EXPORT int mixed_make_buffer_view(struct mixed_pack *pack, channel_t channel, struct mixed_buffer *buffer){
+  mixed_err(MIXED_NO_ERROR);
+  if(buffer->_data && !buffer->virtual){
+    mixed_err(MIXED_BUFFER_ALLOCATED);
+    return 0;
+  }
+  if(!(pack->flags & MIXED_PACK_PLANAR) || pack->encoding != MIXED_FLOAT || !pack->_data || pack->channels <= channel){
+    mixed_err(MIXED_INVALID_VALUE);
+    return 0;
+  }
+  buffer->_data = (float *)(pack->_data + (size_t)channel*pack->size);
+  buffer->size = pack->size / sizeof(float);
+  buffer->flags = MIXED_BUFFER_SHARED;
+  buffer->virtual = 1;
+  mixed_buffer_clear(buffer);
+  publish_views(pack, &buffer, 1);
+  return 1;
+}
+
+MIXED_EXPORT int mixed_pack_sync_views(struct mixed_pack *pack, struct mixed_buffer **views, channel_t count){
+  mixed_err(MIXED_NO_ERROR);
+  // The views all started out at the pack's read position, so the
+  // slowest of them tells how much we may consume. Reads only ever
+  // wrap at the end of the plane, which clears the wrap bit the view
+  // was handed. This tells a view that read all the way around apart
+  // from one that did not read at all.
+  uint32_t size = pack->size / sizeof(float);
+  uint32_t read = view_position(atomic_read(pack->read));
+  uint32_t consumed = (0 < count)? UINT32_MAX : 0;
+  for(channel_t c=0; c<count; ++c){
+    uint32_t view = atomic_read(views[c]->read);
+    bool passed = (views[c]->_write_cache & 0x80000000) && !(atomic_read(views[c]->write) & 0x80000000);
+    consumed = MIN(consumed, passed? size - read + view : view - read);
+  }
+  // Consuming across the wrap takes two steps.
+  consumed *= sizeof(float);
+  while(0 < consumed){
+    void *area;
+    uint32_t bytes = consumed;
+    if(!mixed_pack_request_read(&area, &bytes, pack))
+      break;
+    mixed_pack_finish_read(bytes, pack);
+    consumed -= bytes;
+  }
+  publish_views(pack, views, count);
+  return 1;
+}
@@ -27,6 +27,17 @@ struct segment_vector{
 struct plugin_vector plugins = {0};
 struct segment_vector segments = {0};
 
+// The registries outlive whatever allocator the caller has set, so
+// their storage always comes from the system allocator. Growing it
+// later reuses the allocator it came from.
+static int registry_add(void *entry, struct vector *vector){
+  struct mixed_allocator *current = mixed_get_allocator();
+  mixed_set_allocator(0);
+  int result = vector_add(entry, vector);
+  mixed_set_allocator(current);
+  return result;
+}
+
 MIXED_EXPORT int mixed_load_plugin(char *file){
   struct plugin_entry *entry = 0;
   void *handle = 0;
@@ -50,7 +61,7 @@ MIXED_EXPORT int mixed_load_plugin(char *file){
 
   entry->file = strdup(file);
   entry->handle = handle;
-  if(!vector_add(entry, (struct vector *)&plugins)){
+  if(!registry_add(entry, (struct vector *)&plugins)){
     goto cleanup;
   }
   
@@ -115,7 +126,7 @@ MIXED_EXPORT int mixed_register_segment(char *name, uint32_t argc, struct mixed_
   entry->argc = argc;
   memcpy(entry->args, args, argc*sizeof(struct mixed_segment_field_info));
   entry->function = function;
-  if(!vector_add(entry, (struct vector *)&segments)){
+  if(!registry_add(entry, (struct vector *)&segments)){
     goto cleanup;
   }
 
@@ -0,0 +1,137 @@
+#include "internal.h"
+
+struct pool_class{
+  float *data;
+  uint32_t *next;
+  uint32_t size;
+  uint32_t count;
+  uint64_t head;
+};
+
+struct pool_data{
+  struct pool_class *classes;
+  uint32_t count;
+};
+
+// The free list of each class is a Treiber stack of block indices.
+// The head stores the index+1 of the top block in the low half, and
+// a modification counter in the high half to avoid ABA problems.
+static uint32_t pool_pop(struct pool_class *class){
+  uint64_t head = __atomic_load_n(&class->head, __ATOMIC_ACQUIRE);
+  uint64_t new;
+  do{
+    uint32_t top = (uint32_t)head;
+    if(top == 0) return 0;
+    uint32_t next = __atomic_load_n(&class->next[top-1], __ATOMIC_RELAXED);
+    new = (((head >> 32) + 1) << 32) | next;
+  }while(!__atomic_compare_exchange_n(&class->head, &head, new, 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+  return (uint32_t)head;
+}
+
+static void pool_push(uint32_t block, struct pool_class *class){
+  uint64_t head = __atomic_load_n(&class->head, __ATOMIC_RELAXED);
+  uint64_t new;
+  do{
+    __atomic_store_n(&class->next[block-1], (uint32_t)head, __ATOMIC_RELAXED);
+    new = (((head >> 32) + 1) << 32) | block;
+  }while(!__atomic_compare_exchange_n(&class->head, &head, new, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+MIXED_EXPORT int mixed_make_buffer_pool(uint32_t classes, uint32_t *sizes, uint32_t *counts, struct mixed_buffer_pool *pool){
+  mixed_err(MIXED_NO_ERROR);
+  struct pool_data *data = mixed_calloc(1, sizeof(struct pool_data));
+  if(!data) goto cleanup;
+  data->classes = mixed_calloc(classes, sizeof(struct pool_class));
+  if(!data->classes) goto cleanup;
+  data->count = classes;
+
+  for(uint32_t i=0; i<classes; ++i){
+    struct pool_class *class = &data->classes[i];
+    if(i && sizes[i] < sizes[i-1]){
+      pool->_data = data;
+      mixed_free_buffer_pool(pool);
+      mixed_err(MIXED_INVALID_VALUE);
+      return 0;
+    }
+    class->size = ((sizes[i] + BUFFER_ALIGNMENT_SAMPLES - 1) / BUFFER_ALIGNMENT_SAMPLES) * BUFFER_ALIGNMENT_SAMPLES;
+    class->count = counts[i];
+    class->data = aligned_calloc((size_t)class->size*class->count, sizeof(float), BUFFER_ALIGNMENT);
+    class->next = mixed_calloc(class->count, sizeof(uint32_t));
+    if(!class->data || !class->next){
+      pool->_data = data;
+      mixed_free_buffer_pool(pool);
+      mixed_err(MIXED_OUT_OF_MEMORY);
+      return 0;
+    }
+    for(uint32_t b=class->count; 0<b; --b)
+      pool_push(b, class);
+  }
+
+  pool->_data = data;
+  return 1;
+
+ cleanup:
+  mixed_err(MIXED_OUT_OF_MEMORY);
+  if(data) mixed_free(data);
+  return 0;
+}
+
+MIXED_EXPORT void mixed_free_buffer_pool(struct mixed_buffer_pool *pool){
+  struct pool_data *data = (struct pool_data *)pool->_data;
+  if(data){
+    if(data->classes){
+      for(uint32_t i=0; i<data->count; ++i){
+        aligned_free(data->classes[i].data);
+        if(data->classes[i].next)
+          mixed_free(data->classes[i].next);
+      }
+      mixed_free(data->classes);
+    }
+    mixed_free(data);
+  }
+  pool->_data = 0;
+}
+
+MIXED_EXPORT int mixed_buffer_pool_acquire(uint32_t size, struct mixed_buffer *buffer, struct mixed_buffer_pool *pool){
+  mixed_err(MIXED_NO_ERROR);
+  struct pool_data *data = (struct pool_data *)pool->_data;
+  if(buffer->_data && !buffer->virtual){
+    mixed_err(MIXED_BUFFER_ALLOCATED);
+    return 0;
+  }
+  for(uint32_t i=0; i<data->count; ++i){
+    struct pool_class *class = &data->classes[i];
+    if(size <= class->size){
+      uint32_t block = pool_pop(class);
+      if(block){
+        buffer->_data = class->data + (size_t)(block-1)*class->size;
+        buffer->size = size;
+        buffer->flags = MIXED_BUFFER_ALIGNED | MIXED_BUFFER_POOLED;
+        buffer->virtual = 0;
+        mixed_buffer_clear(buffer);
+        return 1;
+      }
+    }
+  }
+  mixed_err(MIXED_OUT_OF_MEMORY);
+  return 0;
+}
+
+MIXED_EXPORT int mixed_buffer_pool_release(struct mixed_buffer *buffer, struct mixed_buffer_pool *pool){
+  mixed_err(MIXED_NO_ERROR);
+  struct pool_data *data = (struct pool_data *)pool->_data;
+  if(!(buffer->flags & MIXED_BUFFER_POOLED)){
+    mixed_err(MIXED_INVALID_VALUE);
+    return 0;
+  }
+  for(uint32_t i=0; i<data->count; ++i){
+    struct pool_class *class = &data->classes[i];
+    if(class->data <= buffer->_data && buffer->_data < class->data + (size_t)class->size*class->count){
+      pool_push((buffer->_data - class->data) / class->size + 1, class);
+      mixed_free_buffer(buffer);
+      return 1;
+    }
+  }
+  mixed_err(MIXED_INVALID_VALUE);
+  return 0;
+}
@@ -78,33 +78,35 @@ VECTORIZE int basic_mixer_mix(struct mixed_segment *segment){
   float volume = data->volume;
   float div = volume;
 
-  for(channel_t c=0; c<channels; ++c){
-    float *in=0, *out=0;
-    uint32_t samples = UINT32_MAX;
-    
-    // Compute how much we can mix on this channel.
-    mixed_buffer_request_write(&out, &samples, data->out[c]);
-    for(uint32_t i=c; i<data->count; i+=channels){
-      struct mixed_buffer *buffer = data->in[i];
-      if(!buffer) continue;
-      
-      mixed_buffer_request_read(&in, &samples, buffer);
-      if(samples == 0) break;
-    }
+  struct mixed_buffer_group group = {data->in, data->count, data->out, channels};
+  float *ins[data->count+1], *outs[channels];
+  uint32_t samples = UINT32_MAX;
 
+  // Compute how much we can mix on all channels.
+  mixed_buffer_group_request(ins, outs, &samples, &group);
+  for(channel_t c=0; c<channels; ++c){
+    float *out = outs[c];
     memset(out, 0, samples*sizeof(float));
+    // If the output is aligned we can tell the compiler to skip the peeling.
+    int aligned = (data->out[c]->flags & MIXED_BUFFER_ALIGNED)
+      && is_aligned(out) && samples % BUFFER_ALIGNMENT_SAMPLES == 0;
     for(uint32_t i=c; i<data->count; i+=channels){
-      struct mixed_buffer *buffer = data->in[i];
-      if(!buffer) continue;
+      float *in = ins[i];
+      if(!in) continue;
       
-      mixed_buffer_request_read(&in, &samples, buffer);
-      for(uint32_t j=0; j<samples; ++j){
-        out[j] += in[j] * div;
+      if(aligned){
+        float *restrict aout = __builtin_assume_aligned(out, BUFFER_ALIGNMENT);
+        for(uint32_t j=0; j<samples; ++j){
+          aout[j] += in[j] * div;
+        }
+      }else{
+        for(uint32_t j=0; j<samples; ++j){
+          out[j] += in[j] * div;
+        }
       }
-      mixed_buffer_finish_read(samples, buffer);
     }
-    mixed_buffer_finish_write(samples, data->out[c]);
   }
+  mixed_buffer_group_finish(samples, &group);
   return 1;
 }
 
@@ -156,7 +158,7 @@ int basic_mixer_info(struct mixed_segment_info *info, struct mixed_segment *segm
 }
 
 MIXED_EXPORT int mixed_make_segment_basic_mixer(channel_t channels, struct mixed_segment *segment){
-  struct basic_mixer_data *data = calloc(1, sizeof(struct basic_mixer_data));
+  struct basic_mixer_data *data = mixed_calloc(1, sizeof(struct basic_mixer_data));
   if(!data){
     mixed_err(MIXED_OUT_OF_MEMORY);
     return 0;
@@ -164,10 +166,10 @@ MIXED_EXPORT int mixed_make_segment_basic_mixer(channel_t channels, struct mixed
 
   data->volume = 1.0f;
   data->channels = channels;
-  data->out = calloc(channels, sizeof(struct mixed_buffer *));
+  data->out = mixed_calloc(channels, sizeof(struct mixed_buffer *));
   if(!data->out){
     mixed_err(MIXED_OUT_OF_MEMORY);
-    free(data);
+    mixed_free(data);
     return 0;
   }
   
@@ -1,48 +1,55 @@
 #include "../internal.h"
 
+// All variants start out like channel_data. The largest layout we
+// convert to is 7.1, so eight buffers always suffice.
 struct channel_data{
-  struct mixed_buffer *in[14];
-  struct mixed_buffer *out[14];
+  struct mixed_buffer *in[8];
+  struct mixed_buffer *out[8];
   channel_t in_channels;
   channel_t out_channels;
+  uint32_t delay_i;
+  uint32_t delay_size;
+  float *delay;
 };
 
 struct channel_data_2_to_7_1{
-  struct mixed_buffer *in[14];
-  struct mixed_buffer *out[14];
+  struct mixed_buffer *in[8];
+  struct mixed_buffer *out[8];
   channel_t in_channels;
   channel_t out_channels;
-  struct lowpass_data lp[3];
   uint32_t delay_i;
   uint32_t delay_size;
   float *delay;
+  struct lowpass_data lp[3];
 };
 
 struct channel_data_2_to_5_1{
-  struct mixed_buffer *in[14];
-  struct mixed_buffer *out[14];
+  struct mixed_buffer *in[8];
+  struct mixed_buffer *out[8];
   channel_t in_channels;
   channel_t out_channels;
-  struct lowpass_data lp[3];
   uint32_t delay_i;
   uint32_t delay_size;
   float *delay;
+  struct lowpass_data lp[3];
 };
 
 struct channel_data_2_to_4_0{
-  struct mixed_buffer *in[14];
-  struct mixed_buffer *out[14];
+  struct mixed_buffer *in[8];
+  struct mixed_buffer *out[8];
   channel_t in_channels;
   channel_t out_channels;
-  struct lowpass_data lp;
   uint32_t delay_i;
   uint32_t delay_size;
   float *delay;
+  struct lowpass_data lp;
 };
 
 int channel_free(struct mixed_segment *segment){
-  if(segment->data){
-    free(segment->data);
+  struct channel_data *data = (struct channel_data *)segment->data;
+  if(data){
+    if(data->delay) mixed_free(data->delay);
+    mixed_free(data);
   }
   segment->data = 0;
   return 1;
@@ -102,17 +109,18 @@ int channel_set_in(uint32_t field, uint32_t location, void *buffer, struct mixed
 int channel_mix_stereo_mono(struct mixed_segment *segment){
   struct channel_data *data = (struct channel_data *)segment->data;
 
+  struct mixed_buffer_group group = {data->in, data->in_channels, data->out, data->out_channels};
+  float *ins[2], *outs[8];
   uint32_t frames = UINT32_MAX;
   float *l, *r, *out;
-  mixed_buffer_request_read(&l, &frames, data->in[MIXED_LEFT]);
-  mixed_buffer_request_read(&r, &frames, data->in[MIXED_RIGHT]);
-  mixed_buffer_request_write(&out, &frames, data->out[MIXED_MONO]);
+  mixed_buffer_group_request(ins, outs, &frames, &group);
+  l = ins[MIXED_LEFT];
+  r = ins[MIXED_RIGHT];
+  out = outs[MIXED_MONO];
   for(uint32_t i=0; i<frames; ++i){
     out[i] = (l[i]+r[i])*0.5;
   }
-  mixed_buffer_finish_read(frames, data->in[MIXED_LEFT]);
-  mixed_buffer_finish_read(frames, data->in[MIXED_RIGHT]);
-  mixed_buffer_finish_write(frames, data->out[MIXED_MONO]);
+  mixed_buffer_group_finish(frames, &group);
   
   return 1;
 }
@@ -120,18 +128,19 @@ int channel_mix_stereo_mono(struct mixed_segment *segment){
 int channel_mix_mono_stereo(struct mixed_segment *segment){
   struct channel_data *data = (struct channel_data *)segment->data;
 
+  struct mixed_buffer_group group = {data->in, data->in_channels, data->out, data->out_channels};
+  float *ins[2], *outs[8];
   uint32_t frames = UINT32_MAX;
   float *l, *r, *in;
-  mixed_buffer_request_write(&l, &frames, data->out[MIXED_LEFT]);
-  mixed_buffer_request_write(&r, &frames, data->out[MIXED_RIGHT]);
-  mixed_buffer_request_read(&in, &frames, data->in[MIXED_MONO]);
+  mixed_buffer_group_request(ins, outs, &frames, &group);
+  l = outs[MIXED_LEFT];
+  r = outs[MIXED_RIGHT];
+  in = ins[MIXED_MONO];
   for(uint32_t i=0; i<frames; ++i){
     l[i] = in[i];
     r[i] = in[i];
   }
-  mixed_buffer_finish_write(frames, data->out[MIXED_LEFT]);
-  mixed_buffer_finish_write(frames, data->out[MIXED_RIGHT]);
-  mixed_buffer_finish_read(frames, data->in[MIXED_MONO]);
+  mixed_buffer_group_finish(frames, &group);
   
   return 1;
 }
@@ -140,16 +149,19 @@ int channel_mix_stereo_4_0(struct mixed_segment *segment){
   struct channel_data_2_to_4_0 *data = (struct channel_data_2_to_4_0 *)segment->data;
   const float invsqrt = 1.0/sqrt(2);
   
+  struct mixed_buffer_group group = {data->in, data->in_channels, data->out, data->out_channels};
+  float *ins[2], *outs[8];
   uint32_t frames = UINT32_MAX;
   uint32_t delay_i = data->delay_i;
   const uint32_t delay_size = data->delay_size;
   float *l, *r, *fl, *fr, *rl, *rr;
-  mixed_buffer_request_read(&l, &frames, data->in[MIXED_LEFT]);
-  mixed_buffer_request_read(&r, &frames, data->in[MIXED_RIGHT]);
-  mixed_buffer_request_write(&fl, &frames, data->out[MIXED_LEFT_FRONT]);
-  mixed_buffer_request_write(&fr, &frames, data->out[MIXED_RIGHT_FRONT]);
-  mixed_buffer_request_write(&rl, &frames, data->out[MIXED_LEFT_REAR]);
-  mixed_buffer_request_write(&rr, &frames, data->out[MIXED_RIGHT_REAR]);
+  mixed_buffer_group_request(ins, outs, &frames, &group);
+  l = ins[MIXED_LEFT];
+  r = ins[MIXED_RIGHT];
+  fl = outs[MIXED_LEFT_FRONT];
+  fr = outs[MIXED_RIGHT_FRONT];
+  rl = outs[MIXED_LEFT_REAR];
+  rr = outs[MIXED_RIGHT_REAR];
   for(uint32_t i=0; i<frames; ++i){
     float li = l[i];
     float ri = r[i];
@@ -166,12 +178,7 @@ int channel_mix_stereo_4_0(struct mixed_segment *segment){
     rl[i] = rli;
     rr[i] = rri;
   }
-  mixed_buffer_finish_read(frames, data->in[MIXED_LEFT]);
-  mixed_buffer_finish_read(frames, data->in[MIXED_RIGHT]);
-  mixed_buffer_finish_write(frames, data->out[MIXED_LEFT_FRONT]);
-  mixed_buffer_finish_write(frames, data->out[MIXED_RIGHT_FRONT]);
-  mixed_buffer_finish_write(frames, data->out[MIXED_LEFT_REAR]);
-  mixed_buffer_finish_write(frames, data->out[MIXED_RIGHT_REAR]);
+  mixed_buffer_group_finish(frames, &group);
   data->delay_i = delay_i;
 
   return 1;
@@ -183,18 +190,21 @@ int channel_mix_stereo_5_1(struct mixed_segment *segment){
   struct channel_data_2_to_5_1 *data = (struct channel_data_2_to_5_1 *)segment->data;
   const float invsqrt = 1.0/sqrt(2);
   
+  struct mixed_buffer_group group = {data->in, data->in_channels, data->out, data->out_channels};
+  float *ins[2], *outs[8];
   uint32_t frames = UINT32_MAX;
   uint32_t delay_i = data->delay_i;
   const uint32_t delay_size = data->delay_size;
   float *l, *r, *fl, *fr, *rl, *rr, *ce, *lfe;
-  mixed_buffer_request_read(&l, &frames, data->in[MIXED_LEFT]);
-  mixed_buffer_request_read(&r, &frames, data->in[MIXED_RIGHT]);
-  mixed_buffer_request_write(&fl, &frames, data->out[MIXED_LEFT_FRONT]);
-  mixed_buffer_request_write(&fr, &frames, data->out[MIXED_RIGHT_FRONT]);
-  mixed_buffer_request_write(&rl, &frames, data->out[MIXED_LEFT_REAR]);
-  mixed_buffer_request_write(&rr, &frames, data->out[MIXED_RIGHT_REAR]);
-  mixed_buffer_request_write(&ce, &frames, data->out[MIXED_CENTER]);
-  mixed_buffer_request_write(&lfe, &frames, data->out[MIXED_SUBWOOFER]);
+  mixed_buffer_group_request(ins, outs, &frames, &group);
+  l = ins[MIXED_LEFT];
+  r = ins[MIXED_RIGHT];
+  fl = outs[MIXED_LEFT_FRONT];
+  fr = outs[MIXED_RIGHT_FRONT];
+  rl = outs[MIXED_LEFT_REAR];
+  rr = outs[MIXED_RIGHT_REAR];
+  ce = outs[MIXED_CENTER];
+  lfe = outs[MIXED_SUBWOOFER];
   for(uint32_t i=0; i<frames; ++i){
     float li = l[i];
     float ri = r[i];
@@ -218,14 +228,7 @@ int channel_mix_stereo_5_1(struct mixed_segment *segment){
     ce[i] = ci;
     lfe[i] = lfei;
   }
-  mixed_buffer_finish_read(frames, data->in[MIXED_LEFT]);
-  mixed_buffer_finish_read(frames, data->in[MIXED_RIGHT]);
-  mixed_buffer_finish_write(frames, data->out[MIXED_LEFT_FRONT]);
-  mixed_buffer_finish_write(frames, data->out[MIXED_RIGHT_FRONT]);
-  mixed_buffer_finish_write(frames, data->out[MIXED_LEFT_REAR]);
-  mixed_buffer_finish_write(frames, data->out[MIXED_RIGHT_REAR]);
-  mixed_buffer_finish_write(frames, data->out[MIXED_CENTER]);
-  mixed_buffer_finish_write(frames, data->out[MIXED_SUBWOOFER]);
+  mixed_buffer_group_finish(frames, &group);
   data->delay_i = delay_i;
 
   return 1;
@@ -235,20 +238,23 @@ int channel_mix_stereo_7_1(struct mixed_segment *segment){
   struct channel_data_2_to_7_1 *data = (struct channel_data_2_to_7_1 *)segment->data;
   const float invsqrt = 1.0/sqrt(2);
   
+  struct mixed_buffer_group group = {data->in, data->in_channels, data->out, data->out_channels};
+  float *ins[2], *outs[8];
   uint32_t frames = UINT32_MAX;
   uint32_t delay_i = data->delay_i;
   const uint32_t delay_size = data->delay_size;
   float *l, *r, *fl, *fr, *sl, *sr, *rl, *rr, *ce, *lfe;
-  mixed_buffer_request_read(&l, &frames, data->in[MIXED_LEFT]);
-  mixed_buffer_request_read(&r, &frames, data->in[MIXED_RIGHT]);
-  mixed_buffer_request_write(&fl, &frames, data->out[MIXED_LEFT_FRONT]);
-  mixed_buffer_request_write(&fr, &frames, data->out[MIXED_RIGHT_FRONT]);
-  mixed_buffer_request_write(&sl, &frames, data->out[MIXED_LEFT_SIDE]);
-  mixed_buffer_request_write(&sr, &frames, data->out[MIXED_RIGHT_SIDE]);
-  mixed_buffer_request_write(&rl, &frames, data->out[MIXED_LEFT_REAR]);
-  mixed_buffer_request_write(&rr, &frames, data->out[MIXED_RIGHT_REAR]);
-  mixed_buffer_request_write(&ce, &frames, data->out[MIXED_CENTER]);
-  mixed_buffer_request_write(&lfe, &frames, data->out[MIXED_SUBWOOFER]);
+  mixed_buffer_group_request(ins, outs, &frames, &group);
+  l = ins[MIXED_LEFT];
+  r = ins[MIXED_RIGHT];
+  fl = outs[MIXED_LEFT_FRONT];
+  fr = outs[MIXED_RIGHT_FRONT];
+  sl = outs[MIXED_LEFT_SIDE];
+  sr = outs[MIXED_RIGHT_SIDE];
+  rl = outs[MIXED_LEFT_REAR];
+  rr = outs[MIXED_RIGHT_REAR];
+  ce = outs[MIXED_CENTER];
+  lfe = outs[MIXED_SUBWOOFER];
   for(uint32_t i=0; i<frames; ++i){
     float li = l[i];
     float ri = r[i];
@@ -274,16 +280,7 @@ int channel_mix_stereo_7_1(struct mixed_segment *segment){
     ce[i] = ci;
     lfe[i] = lfei;
   }
-  mixed_buffer_finish_read(frames, data->in[MIXED_LEFT]);
-  mixed_buffer_finish_read(frames, data->in[MIXED_RIGHT]);
-  mixed_buffer_finish_write(frames, data->out[MIXED_LEFT_FRONT]);
-  mixed_buffer_finish_write(frames, data->out[MIXED_RIGHT_FRONT]);
-  mixed_buffer_finish_write(frames, data->out[MIXED_LEFT_SIDE]);
-  mixed_buffer_finish_write(frames, data->out[MIXED_RIGHT_SIDE]);
-  mixed_buffer_finish_write(frames, data->out[MIXED_LEFT_REAR]);
-  mixed_buffer_finish_write(frames, data->out[MIXED_RIGHT_REAR]);
-  mixed_buffer_finish_write(frames, data->out[MIXED_CENTER]);
-  mixed_buffer_finish_write(frames, data->out[MIXED_SUBWOOFER]);
+  mixed_buffer_group_finish(frames, &group);
   data->delay_i = delay_i;
 
   return 1;
@@ -307,7 +304,7 @@ int channel_info(struct mixed_segment_info *info, struct mixed_segment *segment)
 
 MIXED_EXPORT int mixed_make_segment_channel_convert(channel_t in, channel_t out, uint32_t samplerate, struct mixed_segment *segment){
   if(in == 1 && out == 2){
-    struct channel_data *data = calloc(1, sizeof(struct channel_data));
+    struct channel_data *data = mixed_calloc(1, sizeof(struct channel_data));
     if(!data){
       mixed_err(MIXED_OUT_OF_MEMORY);
       return 0;
@@ -318,7 +315,7 @@ MIXED_EXPORT int mixed_make_segment_channel_convert(channel_t in, channel_t out,
     segment->mix = channel_mix_mono_stereo;
     segment->data = data;
   }else if(in == 2 && out == 1){
-    struct channel_data *data = calloc(1, sizeof(struct channel_data));
+    struct channel_data *data = mixed_calloc(1, sizeof(struct channel_data));
     if(!data){
       mixed_err(MIXED_OUT_OF_MEMORY);
       return 0;
@@ -329,7 +326,7 @@ MIXED_EXPORT int mixed_make_segment_channel_convert(channel_t in, channel_t out,
     segment->mix = channel_mix_stereo_mono;
     segment->data = data;
   }else if(in == 2 && out == 4){
-    struct channel_data_2_to_4_0 *data = calloc(1, sizeof(struct channel_data_2_to_4_0));
+    struct channel_data_2_to_4_0 *data = mixed_calloc(1, sizeof(struct channel_data_2_to_4_0));
     if(!data){
       mixed_err(MIXED_OUT_OF_MEMORY);
       return 0;
@@ -338,9 +335,9 @@ MIXED_EXPORT int mixed_make_segment_channel_convert(channel_t in, channel_t out,
     data->in_channels = in;
     data->out_channels = out;
     data->delay_size = (samplerate*12)/1000;
-    data->delay = calloc(data->delay_size, sizeof(float));
+    data->delay = mixed_calloc(data->delay_size, sizeof(float));
     if(!data->delay){
-      free(data);
+      mixed_free(data);
       mixed_err(MIXED_OUT_OF_MEMORY);
       return 0;
     }
@@ -348,7 +345,7 @@ MIXED_EXPORT int mixed_make_segment_channel_convert(channel_t in, channel_t out,
     segment->mix = channel_mix_stereo_4_0;
     segment->data = data;
   }else if(in == 2 && out == 6){
-    struct channel_data_2_to_5_1 *data = calloc(1, sizeof(struct channel_data_2_to_5_1));
+    struct channel_data_2_to_5_1 *data = mixed_calloc(1, sizeof(struct channel_data_2_to_5_1));
     if(!data){
       mixed_err(MIXED_OUT_OF_MEMORY);
       return 0;
@@ -357,9 +354,9 @@ MIXED_EXPORT int mixed_make_segment_channel_convert(channel_t in, channel_t out,
     data->in_channels = in;
     data->out_channels = out;
     data->delay_size = (samplerate*12)/1000;
-    data->delay = calloc(data->delay_size, sizeof(float));
+    data->delay = mixed_calloc(data->delay_size, sizeof(float));
     if(!data->delay){
-      free(data);
+      mixed_free(data);
       mixed_err(MIXED_OUT_OF_MEMORY);
       return 0;
     }
@@ -369,7 +366,7 @@ MIXED_EXPORT int mixed_make_segment_channel_convert(channel_t in, channel_t out,
     segment->mix = channel_mix_stereo_5_1;
     segment->data = data;
   }else if(in == 2 && out == 8){
-    struct channel_data_2_to_7_1 *data = calloc(1, sizeof(struct channel_data_2_to_7_1));
+    struct channel_data_2_to_7_1 *data = mixed_calloc(1, sizeof(struct channel_data_2_to_7_1));
     if(!data){
       mixed_err(MIXED_OUT_OF_MEMORY);
       return 0;
@@ -378,9 +375,9 @@ MIXED_EXPORT int mixed_make_segment_channel_convert(channel_t in, channel_t out,
     data->in_channels = in;
     data->out_channels = out;
     data->delay_size = (samplerate*12)/1000;
-    data->delay = calloc(data->delay_size, sizeof(float));
+    data->delay = mixed_calloc(data->delay_size, sizeof(float));
     if(!data->delay){
-      free(data);
+      mixed_free(data);
       mixed_err(MIXED_OUT_OF_MEMORY);
       return 0;
     }
@@ -0,0 +1,308 @@
+#include "../internal.h"
+#include "samplerate.h"
+
+// Frames per channel that are resampled in one go.
+#define RESAMPLE_FRAMES 2048
+
+struct converter_segment_data{
+  struct mixed_pack *in;
+  struct mixed_pack *out;
+  SRC_STATE *resample_state;
+  float volume;
+  float target_volume;
+  int quality;
+  channel_t *map;
+  channel_t mapped;
+  // Interleaved staging around the resampler, each holding
+  // RESAMPLE_FRAMES of the wider of the two packs' frames.
+  channel_t resample_channels;
+  float *resample_in;
+  float *resample_out;
+};
+
+int converter_segment_free(struct mixed_segment *segment){
+  struct converter_segment_data *data = (struct converter_segment_data *)segment->data;
+  if(data){
+    if(data->resample_state)
+      src_delete(data->resample_state);
+    if(data->map)
+      mixed_free(data->map);
+    if(data->resample_in)
+      mixed_free(data->resample_in);
+    mixed_free(data);
+  }
+  segment->data = 0;
+  return 1;
+}
+
+int converter_segment_start(struct mixed_segment *segment){
+  struct converter_segment_data *data = (struct converter_segment_data *)segment->data;
+  if(data->in == 0 || data->out == 0){
+    mixed_err(MIXED_BUFFER_MISSING);
+    return 0;
+  }
+
+  double ratio = ((double)data->out->samplerate)/((double)data->in->samplerate);
+  if(ratio <= 0.003 || 256.0 < ratio){
+    mixed_err(MIXED_BAD_RESAMPLE_FACTOR);
+    return 0;
+  }
+  // The resampler works on interleaved frames only.
+  if(ratio != 1.0 && ((data->in->flags | data->out->flags) & MIXED_PACK_PLANAR)){
+    mixed_err(MIXED_NOT_IMPLEMENTED);
+    return 0;
+  }
+
+  if(data->resample_state)
+    src_reset(data->resample_state);
+  else{
+    int e = 0;
+    SRC_STATE *src_state = src_new(data->quality, data->in->channels, &e);
+    if(!src_state){
+      fprintf(stderr, "libsamplerate: %s\n", src_strerror(e));
+      mixed_err(MIXED_OUT_OF_MEMORY);
+      return 0;
+    }
+    data->resample_state = src_state;
+  }
+  return 1;
+}
+
+int converter_segment_end(struct mixed_segment *segment){
+  struct converter_segment_data *data = (struct converter_segment_data *)segment->data;
+  if(data->resample_state){
+    src_delete(data->resample_state);
+    data->resample_state = 0;
+  }
+  return 1;
+}
+
+// Same channel mapping as pack_convert, on interleaved frames.
+static void map_channels(float *in, channel_t in_channels, float *out, channel_t out_channels, channel_t *map, channel_t count, uint32_t frames){
+  for(uint32_t i=0; i<frames; ++i){
+    float *from = in+i*in_channels;
+    float *to = out+i*out_channels;
+    for(channel_t c=0; c<out_channels; ++c){
+      if(count)
+        to[c] = (c < count)? from[map[c]] : 0.0f;
+      else
+        to[c] = (c < in_channels)? from[c] : (in_channels == 1)? from[0] : 0.0f;
+    }
+  }
+}
+
+int converter_segment_mix(struct mixed_segment *segment){
+  struct converter_segment_data *data = (struct converter_segment_data *)segment->data;
+  struct mixed_pack *in = data->in;
+  struct mixed_pack *out = data->out;
+
+  if(in->samplerate == out->samplerate)
+    return pack_convert(in, out, (data->mapped)? data->map : 0, data->mapped, &data->volume, data->target_volume);
+
+  channel_t in_channels = in->channels;
+  channel_t out_channels = out->channels;
+  uint32_t in_frame = in_channels * mixed_samplesize(in->encoding);
+  uint32_t out_frame = out_channels * mixed_samplesize(out->encoding);
+  uint32_t frames, buffer_frames = RESAMPLE_FRAMES * data->resample_channels / MAX(in_channels, out_channels);
+  float *planes[in_channels];
+  for(channel_t c=0; c<in_channels; ++c)
+    planes[c] = data->resample_out + c*buffer_frames;
+  mixed_transfer_function_to encoder = mixed_translator_to(out->encoding);
+  SRC_DATA src_data = {0};
+  src_data.src_ratio = ((double)out->samplerate)/((double)in->samplerate);
+  src_data.data_in = data->resample_in;
+  src_data.data_out = data->resample_out;
+  do{
+    void *in_data = 0, *out_data = 0;
+    uint32_t in_bytes = UINT32_MAX, out_bytes = UINT32_MAX;
+    // Step 1: determine available data and space
+    mixed_pack_request_read(&in_data, &in_bytes, in);
+    mixed_pack_request_write(&out_data, &out_bytes, out);
+    frames = MIN(buffer_frames, in_bytes / in_frame);
+    src_data.output_frames = MIN(buffer_frames, out_bytes / out_frame);
+    if(!in_data || !out_data || src_data.output_frames == 0)
+      break;
+    // Step 2: decode per frame, so that the volume ramp applies
+    // evenly to all channels, and interleave for the resampler.
+    // The output array is free until the resampler fills it.
+    float volume = data->volume;
+    unpack_frames(in, (char *)in_data, 0, in_channels, planes, frames, &volume, data->target_volume);
+    for(uint32_t i=0; i<frames; ++i)
+      for(channel_t c=0; c<in_channels; ++c)
+        data->resample_in[i*in_channels+c] = planes[c][i];
+    // Step 3: resample
+    src_data.input_frames = frames;
+    int e = src_process(data->resample_state, &src_data);
+    if(e){
+      fprintf(stderr, "libsamplerate: %s\n", src_strerror(e));
+      mixed_err(MIXED_RESAMPLE_FAILED);
+      return 0;
+    }
+    // Step 4: map channels and encode
+    frames = src_data.input_frames_used;
+    // Frames the resampler did not take are decoded again next time.
+    data->volume = ramp_volume(data->volume, data->target_volume, frames);
+    uint32_t out_frames = src_data.output_frames_gen;
+    float *source = data->resample_out;
+    if(in_channels != out_channels || data->mapped){
+      map_channels(source, in_channels, data->resample_in, out_channels, data->map, data->mapped, out_frames);
+      source = data->resample_in;
+    }
+    encoder(source, out_data, 1, out_frames*out_channels, 1.0, 1.0);
+    // Step 5: update consumed data
+    mixed_pack_finish_read(frames * in_frame, in);
+    mixed_pack_finish_write(out_frames * out_frame, out);
+  }while(frames);
+  return 1;
+}
+
+int converter_segment_set(uint32_t field, void *value, struct mixed_segment *segment){
+  struct converter_segment_data *data = (struct converter_segment_data *)segment->data;
+  
+  switch(field){
+  case MIXED_RESAMPLE_TYPE: {
+    int error;
+    data->quality = *(enum mixed_resample_type *)value;
+    if(data->resample_state){
+      SRC_STATE *new = src_new(data->quality, data->in->channels, &error);
+      if(!new) {
+        mixed_err(MIXED_RESAMPLE_FAILED);
+        return 0;
+      }
+      src_delete(data->resample_state);
+      data->resample_state = new;
+    }
+  }
+    return 1;
+  case MIXED_VOLUME:
+    data->target_volume = *((float *)value);
+    return 1;
+  case MIXED_CHANNEL_MAP: {
+    struct mixed_channel_map *map = (struct mixed_channel_map *)value;
+    if(data->out->channels < map->count){
+      mixed_err(MIXED_INVALID_VALUE);
+      return 0;
+    }
+    for(channel_t c=0; c<map->count; ++c){
+      if(data->in->channels <= map->channels[c]){
+        mixed_err(MIXED_INVALID_VALUE);
+        return 0;
+      }
+    }
+    memcpy(data->map, map->channels, map->count*sizeof(channel_t));
+    data->mapped = map->count;
+  }
+    return 1;
+  case MIXED_BYPASS:
+    if(*(bool *)value){
+      segment->mix = mix_noop;
+    }else{
+      segment->mix = converter_segment_mix;
+    }
+    return 1;
+  default:
+    mixed_err(MIXED_INVALID_FIELD);
+    return 0;
+  }
+}
+
+int converter_segment_get(uint32_t field, void *value, struct mixed_segment *segment){
+  struct converter_segment_data *data = (struct converter_segment_data *)segment->data;
+  
+  switch(field){
+  case MIXED_RESAMPLE_TYPE:
+    *((int *)value) = data->quality;
+    return 1;
+  case MIXED_VOLUME:
+    *((float *)value) = data->target_volume;
+    return 1;
+  case MIXED_CHANNEL_MAP: {
+    struct mixed_channel_map *map = (struct mixed_channel_map *)value;
+    map->count = data->mapped;
+    map->channels = data->map;
+  }
+    return 1;
+  case MIXED_BYPASS:
+    *(bool *)value = (segment->mix == mix_noop);
+    return 1;
+  default:
+    mixed_err(MIXED_INVALID_FIELD);
+    return 0;
+  }
+}
+
+int converter_segment_info(struct mixed_segment_info *info, struct mixed_segment *segment){
+  IGNORE(segment);
+  info->name = "converter";
+  info->description = "Convert one pack directly into another.";
+  info->min_inputs = 0;
+  info->max_inputs = 0;
+  info->outputs = 0;
+  
+  struct mixed_segment_field_info *field = info->fields;
+  set_info_field(field++, MIXED_VOLUME,
+                 MIXED_FLOAT, 1, MIXED_SEGMENT | MIXED_SET | MIXED_GET,
+                 "The volume scaling factor.");
+
+  set_info_field(field++, MIXED_RESAMPLE_TYPE,
+                 MIXED_RESAMPLE_TYPE_ENUM, 1, MIXED_SEGMENT | MIXED_SET | MIXED_GET,
+                 "The type of resampling algorithm used.");
+
+  set_info_field(field++, MIXED_BYPASS,
+                 MIXED_BOOL, 1, MIXED_SEGMENT | MIXED_SET | MIXED_GET,
+                 "Bypass the segment's processing.");
+
+  set_info_field(field++, MIXED_CHANNEL_MAP,
+                 MIXED_CHANNEL_MAP_POINTER, 1, MIXED_SEGMENT | MIXED_SET | MIXED_GET,
+                 "The input channels that the output channels draw from.");
+  clear_info_field(field++);
+  return 1;
+}
+
+MIXED_EXPORT int mixed_make_segment_converter(struct mixed_pack *in, struct mixed_pack *out, struct mixed_segment *segment){
+  if(!mixed_translator_from(in->encoding) || !mixed_translator_to(out->encoding)){
+    mixed_err(MIXED_UNKNOWN_ENCODING);
+    return 0;
+  }
+
+  struct converter_segment_data *data = mixed_calloc(1, sizeof(struct converter_segment_data));
+  if(!data){
+    mixed_err(MIXED_OUT_OF_MEMORY);
+    return 0;
+  }
+
+  data->map = mixed_calloc(out->channels, sizeof(channel_t));
+  data->resample_channels = MAX(in->channels, out->channels);
+  data->resample_in = mixed_calloc(2*(size_t)data->resample_channels*RESAMPLE_FRAMES, sizeof(float));
+  if(!data->map || !data->resample_in){
+    segment->data = data;
+    converter_segment_free(segment);
+    mixed_err(MIXED_OUT_OF_MEMORY);
+    return 0;
+  }
+  data->resample_out = data->resample_in + (size_t)data->resample_channels*RESAMPLE_FRAMES;
+
+  data->in = in;
+  data->out = out;
+  data->volume = 1.0;
+  data->target_volume = 1.0;
+  data->quality = MIXED_SINC_FASTEST;
+  
+  segment->free = converter_segment_free;
+  segment->start = converter_segment_start;
+  segment->mix = converter_segment_mix;
+  segment->end = converter_segment_end;
+  segment->set = converter_segment_set;
+  segment->get = converter_segment_get;
+  segment->info = converter_segment_info;
+  segment->data = data;
+  return 1;
+}
+
+int __make_converter(void *args, struct mixed_segment *segment){
+  return mixed_make_segment_converter(ARG(struct mixed_pack*, 0), ARG(struct mixed_pack*, 1), segment);
+}
+
+REGISTER_SEGMENT(converter, __make_converter, 2, {
+    {.description = "in", .type = MIXED_PACK_POINTER},
+    {.description = "out", .type = MIXED_PACK_POINTER}})
@@ -6,9 +6,21 @@ struct distribute_data{
   uint32_t size;
   struct mixed_buffer *in;
   uint32_t was_available;
+  // Whether the input was already shared before we marked it.
+  bool was_shared;
 };
 
+// Our outputs alias the input's array, so it must stay put while it
+// is attached, but may move again once it is released.
+static void release_in(struct distribute_data *data){
+  if(data->in && !data->was_shared)
+    data->in->flags &= ~MIXED_BUFFER_SHARED;
+  data->in = 0;
+}
+
 int distribute_free(struct mixed_segment *segment){
+  if(segment->data)
+    release_in((struct distribute_data *)segment->data);
   free_vector((struct vector *)segment->data);
   return 1;
 }
@@ -22,7 +34,12 @@ int distribute_set_in(uint32_t field, uint32_t location, void *buffer, struct mi
       mixed_err(MIXED_INVALID_LOCATION);
       return 0;
     }
+    release_in(data);
     data->in = (struct mixed_buffer *)buffer;
+    if(data->in){
+      data->was_shared = (data->in->flags & MIXED_BUFFER_SHARED) != 0;
+      data->in->flags |= MIXED_BUFFER_SHARED;
+    }
     return 1;
   default:
     mixed_err(MIXED_INVALID_FIELD);
@@ -76,6 +93,9 @@ int distribute_start(struct mixed_segment *segment){
     buffer->size = in->size;
     buffer->read = in->read;
     buffer->write = in->write;
+    buffer->_read_cache = in->read;
+    buffer->_write_cache = in->write;
+    buffer->flags = in->flags;
   }
 
   data->was_available = 0;
@@ -85,7 +105,7 @@ int distribute_start(struct mixed_segment *segment){
 int distribute_mix(struct mixed_segment *segment){
   struct distribute_data *data = (struct distribute_data *)segment->data;
   struct mixed_buffer *in = data->in;
-  // FIXME: This explicitly does /not/ support reads from both bip regions at once.
+  // FIXME: Unless the input is mirrored, this does /not/ support reads from both bip regions at once.
   uint32_t max_available = mixed_buffer_available_read(data->out[0]);
   for(uint32_t i=1; i<data->count; ++i){
     max_available = MAX(max_available, mixed_buffer_available_read(data->out[i]));
@@ -99,6 +119,7 @@ int distribute_mix(struct mixed_segment *segment){
     struct mixed_buffer *buffer = data->out[i];
     atomic_write(buffer->write, write);
     atomic_write(buffer->read, read);
+    buffer->_write_cache = write;
   }
   return 1;
 }
@@ -121,7 +142,7 @@ int distribute_info(struct mixed_segment_info *info, struct mixed_segment *segme
 }
 
 MIXED_EXPORT int mixed_make_segment_distribute(struct mixed_segment *segment){
-  struct distribute_data *data = calloc(1, sizeof(struct distribute_data));
+  struct distribute_data *data = mixed_calloc(1, sizeof(struct distribute_data));
   if(!data){
     mixed_err(MIXED_OUT_OF_MEMORY);
     return 0;
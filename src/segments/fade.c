@@ -3,6 +3,8 @@
 struct fade_segment_data{
   struct mixed_buffer *in;
   struct mixed_buffer *out;
+  struct mixed_multibuffer *multi_in;
+  struct mixed_multibuffer *multi_out;
   float from;
   float to;
   float time;
@@ -13,7 +15,7 @@ struct fade_segment_data{
 
 int fade_segment_free(struct mixed_segment *segment){
   if(segment->data)
-    free(segment->data);
+    mixed_free(segment->data);
   segment->data = 0;
   return 1;
 }
@@ -22,7 +24,7 @@ int fade_segment_start(struct mixed_segment *segment){
   struct fade_segment_data *data = (struct fade_segment_data *)segment->data;
   data->time_passed = 0.0;
 
-  if(data->in == 0 || data->out == 0){
+  if((data->in == 0 || data->out == 0) && (data->multi_in == 0 || data->multi_out == 0)){
     mixed_err(MIXED_BUFFER_MISSING);
     return 0;
   }
@@ -41,6 +43,13 @@ int fade_segment_set_in(uint32_t field, uint32_t location, void *buffer, struct
     }
     mixed_err(MIXED_INVALID_LOCATION);
     return 0;
+  case MIXED_MULTIBUFFER:
+    if(location == 0){
+      data->multi_in = (struct mixed_multibuffer *)buffer;
+      return 1;
+    }
+    mixed_err(MIXED_INVALID_LOCATION);
+    return 0;
   default:
     mixed_err(MIXED_INVALID_FIELD);
     return 0;
@@ -58,6 +67,13 @@ int fade_segment_set_out(uint32_t field, uint32_t location, void *buffer, struct
     }
     mixed_err(MIXED_INVALID_LOCATION);
     return 0;
+  case MIXED_MULTIBUFFER:
+    if(location == 0){
+      data->multi_out = (struct mixed_multibuffer *)buffer;
+      return 1;
+    }
+    mixed_err(MIXED_INVALID_LOCATION);
+    return 0;
   default:
     mixed_err(MIXED_INVALID_FIELD);
     return 0;
@@ -104,6 +120,28 @@ int fade_segment_mix(struct mixed_segment *segment){
   case MIXED_CUBIC_IN_OUT: ease = fade_cubic_in_out; break;
   }
   
+  if(data->multi_in && data->multi_out){
+    struct mixed_multibuffer *in = data->multi_in, *out = data->multi_out;
+    float *ins[in->channels], *outs[out->channels];
+    uint32_t channels = MIN(in->channels, out->channels);
+    uint32_t frames = UINT32_MAX;
+    mixed_multibuffer_request_read(ins, &frames, in);
+    mixed_multibuffer_request_write(outs, &frames, out);
+    for(uint32_t i=0; i<frames; ++i){
+      float x = (time < endtime)? time/endtime : 1.0f;
+      float fade = from+ease(x)*range;
+      for(uint32_t c=0; c<channels; ++c)
+        outs[c][i] = ins[c][i]*fade;
+      time += sampletime;
+    }
+    for(uint32_t c=channels; c<out->channels; ++c)
+      memset(outs[c], 0, frames*sizeof(float));
+    mixed_multibuffer_finish_read(frames, in);
+    mixed_multibuffer_finish_write(frames, out);
+    data->time_passed = time;
+    return 1;
+  }
+
   // NOTE: You could probably get away with having the same fade factor
   //       for the entirety of the sample range if the total duration
   //       of the buffer is small enough (~1ms?) as the human ear
@@ -120,7 +158,9 @@ int fade_segment_mix(struct mixed_segment *segment){
 
 int fade_segment_mix_bypass(struct mixed_segment *segment){
   struct fade_segment_data *data = (struct fade_segment_data *)segment->data;
-  
+
+  if(data->multi_in && data->multi_out)
+    return mixed_multibuffer_transfer(data->multi_in, data->multi_out);
   return mixed_buffer_transfer(data->in, data->out);
 }
 
@@ -128,7 +168,7 @@ int fade_segment_info(struct mixed_segment_info *info, struct mixed_segment *seg
   IGNORE(segment);
   info->name = "fade";
   info->description = "Fade the volume of buffers.";
-  info->flags = MIXED_INPLACE;
+  info->flags = MIXED_INPLACE | MIXED_MULTICHANNEL;
   info->min_inputs = 1;
   info->max_inputs = 1;
   info->outputs = 1;
@@ -138,6 +178,10 @@ int fade_segment_info(struct mixed_segment_info *info, struct mixed_segment *seg
                  MIXED_BUFFER_POINTER, 1, MIXED_IN | MIXED_OUT | MIXED_SET,
                  "The buffer for audio data attached to the location.");
 
+  set_info_field(field++, MIXED_MULTIBUFFER,
+                 MIXED_MULTIBUFFER_POINTER, 1, MIXED_IN | MIXED_OUT | MIXED_SET,
+                 "The multi-channel buffer to fade all channels of at once.");
+
   set_info_field(field++, MIXED_FADE_FROM,
                  MIXED_FLOAT, 1, MIXED_SEGMENT | MIXED_SET | MIXED_GET,
                  "The starting volume from which the fade begins.");
@@ -222,7 +266,7 @@ int fade_segment_set(uint32_t field, void *value, struct mixed_segment *segment)
 }
 
 MIXED_EXPORT int mixed_make_segment_fade(float from, float to, float time, enum mixed_fade_type type, uint32_t samplerate, struct mixed_segment *segment){
-  struct fade_segment_data *data = calloc(1, sizeof(struct fade_segment_data));
+  struct fade_segment_data *data = mixed_calloc(1, sizeof(struct fade_segment_data));
   if(!data){
     mixed_err(MIXED_OUT_OF_MEMORY);
     return 0;
@@ -12,7 +12,7 @@ struct frequency_pass_segment_data{
 
 int frequency_pass_segment_free(struct mixed_segment *segment){
   if(segment->data){
-    free(segment->data);
+    mixed_free(segment->data);
   }
   segment->data = 0;
   return 1;
@@ -234,7 +234,7 @@ MIXED_EXPORT int mixed_make_segment_frequency_pass(enum mixed_frequency_pass pas
     return 0;
   }
   
-  struct frequency_pass_segment_data *data = calloc(1, sizeof(struct frequency_pass_segment_data));
+  struct frequency_pass_segment_data *data = mixed_calloc(1, sizeof(struct frequency_pass_segment_data));
   if(!data){
     mixed_err(MIXED_OUT_OF_MEMORY);
     return 0;
@@ -31,7 +31,7 @@ float linear_to_db(float linear){
 
 int gate_segment_free(struct mixed_segment *segment){
   if(segment->data){
-    free(segment->data);
+    mixed_free(segment->data);
   }
   segment->data = 0;
   return 1;
@@ -270,7 +270,7 @@ int gate_segment_set(uint32_t field, void *value, struct mixed_segment *segment)
 }
 
 MIXED_EXPORT int mixed_make_segment_gate(uint32_t samplerate, struct mixed_segment *segment){
-  struct gate_segment_data *data = calloc(1, sizeof(struct gate_segment_data));
+  struct gate_segment_data *data = mixed_calloc(1, sizeof(struct gate_segment_data));
   if(!data){
     mixed_err(MIXED_OUT_OF_MEMORY);
     return 0;
@@ -0,0 +1,624 @@
+#include "../internal.h"
+
+// How often an idle worker looks for work before it yields, and how
+// often it yields before it parks until the next mix.
+#define GRAPH_SPINS 64
+#define GRAPH_YIELDS 256
+
+struct graph_edge{
+  struct mixed_segment *from;
+  uint32_t out;
+  struct mixed_segment *to;
+  uint32_t in;
+};
+
+struct graph_data{
+  // The segments in the order they were added.
+  struct vector segments;
+  // Connections between the segments, as struct graph_edge.
+  struct vector edges;
+  // The segments in the order they are run in. This is only
+  // rebuilt when the topology has changed since the last plan.
+  struct vector plan;
+  bool dirty;
+  // For each planned segment, the number of connections it waits
+  // on, and the range of its successors' plan indices.
+  uint32_t *dependencies;
+  uint32_t *successor_start;
+  uint32_t *successors;
+  uint32_t threads;
+  struct graph_pool *pool;
+};
+
+struct graph_worker{
+  struct graph_pool *pool;
+  void *thread;
+  uint32_t id;
+  // A Chase-Lev deque of plan indices. The owner pushes and pops at
+  // the bottom, other workers steal from the top. Every segment is
+  // pushed at most once per mix and the deque is reset between
+  // mixes, so it never has to wrap around.
+  int32_t top;
+  int32_t bottom;
+  uint32_t *tasks;
+};
+
+struct graph_pool{
+  struct graph_data *graph;
+  // The workers, the first of which is the mixing thread itself.
+  struct graph_worker *workers;
+  uint32_t count;
+  // The number of segments the arrays have room for.
+  uint32_t capacity;
+  // For each planned segment, how many of its dependencies have yet
+  // to be mixed in the current mix.
+  uint32_t *pending;
+  uint32_t remaining;
+  uint32_t generation;
+  uint32_t sleepers;
+  uint32_t finished;
+  uint32_t error;
+  uint32_t quit;
+};
+
+static int32_t segment_index(struct mixed_segment *segment, struct vector *vector){
+  for(uint32_t i=0; i<vector->count; ++i){
+    if(vector->data[i] == segment)
+      return i;
+  }
+  return -1;
+}
+
+static void remove_edges(struct mixed_segment *segment, uint32_t location, bool out, struct graph_data *data){
+  for(uint32_t i=0; i<data->edges.count;){
+    struct graph_edge *edge = (struct graph_edge *)data->edges.data[i];
+    if(out? (edge->from == segment && edge->out == location)
+          : (edge->to == segment && edge->in == location)){
+      mixed_free(edge);
+      vector_remove_pos(i, &data->edges);
+    }else{
+      ++i;
+    }
+  }
+}
+
+static void free_schedule(struct graph_data *data){
+  if(data->dependencies) mixed_free(data->dependencies);
+  if(data->successor_start) mixed_free(data->successor_start);
+  if(data->successors) mixed_free(data->successors);
+  data->dependencies = 0;
+  data->successor_start = 0;
+  data->successors = 0;
+}
+
+// Translate the connections into plan indices for the parallel
+// executor. The order holds the segment index of each plan entry.
+static int graph_schedule(struct graph_data *data, uint32_t *order, int32_t *sources, int32_t *targets){
+  uint32_t count = data->plan.count;
+  uint32_t edges = data->edges.count;
+  uint32_t positions[count];
+  free_schedule(data);
+  data->dependencies = mixed_calloc(count, sizeof(uint32_t));
+  data->successor_start = mixed_calloc(count+1, sizeof(uint32_t));
+  data->successors = mixed_calloc(edges+1, sizeof(uint32_t));
+  if(!data->dependencies || !data->successor_start || !data->successors){
+    free_schedule(data);
+    mixed_err(MIXED_OUT_OF_MEMORY);
+    return 0;
+  }
+  for(uint32_t i=0; i<count; ++i)
+    positions[order[i]] = i;
+  for(uint32_t e=0; e<edges; ++e){
+    ++data->dependencies[positions[targets[e]]];
+    ++data->successor_start[positions[sources[e]]+1];
+  }
+  for(uint32_t i=0; i<count; ++i)
+    data->successor_start[i+1] += data->successor_start[i];
+  uint32_t fill[count];
+  memcpy(fill, data->successor_start, sizeof(fill));
+  for(uint32_t e=0; e<edges; ++e){
+    uint32_t from = positions[sources[e]];
+    data->successors[fill[from]++] = positions[targets[e]];
+  }
+  return 1;
+}
+
+// Order the segments with Kahn's algorithm. Segments that do not
+// depend on each other keep the order they were added in.
+static int graph_plan(struct graph_data *data){
+  uint32_t count = data->segments.count;
+  if(!data->dirty)
+    return 1;
+  vector_clear(&data->plan);
+  if(count == 0){
+    data->dirty = false;
+    return 1;
+  }
+
+  uint32_t *degrees = mixed_calloc(count, sizeof(uint32_t));
+  uint32_t *queue = mixed_calloc(count, sizeof(uint32_t));
+  int32_t *targets = mixed_calloc(data->edges.count+1, sizeof(int32_t));
+  int32_t *sources = mixed_calloc(data->edges.count+1, sizeof(int32_t));
+  if(!degrees || !queue || !targets || !sources){
+    mixed_err(MIXED_OUT_OF_MEMORY);
+    goto cleanup;
+  }
+
+  for(uint32_t e=0; e<data->edges.count; ++e){
+    struct graph_edge *edge = (struct graph_edge *)data->edges.data[e];
+    sources[e] = segment_index(edge->from, &data->segments);
+    targets[e] = segment_index(edge->to, &data->segments);
+    ++degrees[targets[e]];
+  }
+
+  uint32_t head = 0, tail = 0;
+  for(uint32_t i=0; i<count; ++i){
+    if(degrees[i] == 0)
+      queue[tail++] = i;
+  }
+  while(head < tail){
+    uint32_t i = queue[head++];
+    if(!vector_add(data->segments.data[i], &data->plan))
+      goto cleanup;
+    for(uint32_t e=0; e<data->edges.count; ++e){
+      if(sources[e] == (int32_t)i && --degrees[targets[e]] == 0)
+        queue[tail++] = targets[e];
+    }
+  }
+
+  if(data->plan.count < count){
+    mixed_err(MIXED_GRAPH_CYCLE);
+    vector_clear(&data->plan);
+    goto cleanup;
+  }
+  if(!graph_schedule(data, queue, sources, targets)){
+    vector_clear(&data->plan);
+    goto cleanup;
+  }
+  data->dirty = false;
+
+ cleanup:
+  if(degrees) mixed_free(degrees);
+  if(queue) mixed_free(queue);
+  if(targets) mixed_free(targets);
+  if(sources) mixed_free(sources);
+  return !data->dirty;
+}
+
+MIXED_EXPORT int mixed_graph_add(struct mixed_segment *segment, struct mixed_segment *graph){
+  mixed_err(MIXED_NO_ERROR);
+  struct graph_data *data = (struct graph_data *)graph->data;
+  if(segment == graph || 0 <= segment_index(segment, &data->segments)){
+    mixed_err(MIXED_INVALID_VALUE);
+    return 0;
+  }
+  if(!vector_add(segment, &data->segments))
+    return 0;
+  data->dirty = true;
+  return 1;
+}
+
+MIXED_EXPORT int mixed_graph_remove(struct mixed_segment *segment, struct mixed_segment *graph){
+  mixed_err(MIXED_NO_ERROR);
+  struct graph_data *data = (struct graph_data *)graph->data;
+  if(segment_index(segment, &data->segments) < 0){
+    mixed_err(MIXED_INVALID_VALUE);
+    return 0;
+  }
+  for(uint32_t i=0; i<data->edges.count;){
+    struct graph_edge *edge = (struct graph_edge *)data->edges.data[i];
+    if(edge->from == segment || edge->to == segment){
+      mixed_free(edge);
+      vector_remove_pos(i, &data->edges);
+    }else{
+      ++i;
+    }
+  }
+  data->dirty = true;
+  return vector_remove_item(segment, &data->segments);
+}
+
+MIXED_EXPORT int mixed_graph_connect(struct mixed_segment *from, uint32_t out, struct mixed_segment *to, uint32_t in, struct mixed_buffer *buffer, struct mixed_segment *graph){
+  mixed_err(MIXED_NO_ERROR);
+  struct graph_data *data = (struct graph_data *)graph->data;
+  if(segment_index(from, &data->segments) < 0 || segment_index(to, &data->segments) < 0){
+    mixed_err(MIXED_INVALID_VALUE);
+    return 0;
+  }
+  struct graph_edge *edge = mixed_calloc(1, sizeof(struct graph_edge));
+  if(!edge){
+    mixed_err(MIXED_OUT_OF_MEMORY);
+    return 0;
+  }
+  if(!mixed_segment_set_out(MIXED_BUFFER, out, buffer, from)
+     || !mixed_segment_set_in(MIXED_BUFFER, in, buffer, to)){
+    mixed_free(edge);
+    return 0;
+  }
+  // The ports now carry a different buffer, so earlier connections
+  // of either of them are gone.
+  remove_edges(from, out, true, data);
+  remove_edges(to, in, false, data);
+  data->dirty = true;
+  edge->from = from;
+  edge->out = out;
+  edge->to = to;
+  edge->in = in;
+  if(!vector_add(edge, &data->edges)){
+    mixed_free(edge);
+    return 0;
+  }
+  return 1;
+}
+
+MIXED_EXPORT int mixed_graph_disconnect(struct mixed_segment *to, uint32_t in, struct mixed_segment *graph){
+  mixed_err(MIXED_NO_ERROR);
+  struct graph_data *data = (struct graph_data *)graph->data;
+  uint32_t count = data->edges.count;
+  remove_edges(to, in, false, data);
+  if(count == data->edges.count){
+    mixed_err(MIXED_INVALID_LOCATION);
+    return 0;
+  }
+  data->dirty = true;
+  return 1;
+}
+
+MIXED_EXPORT int mixed_graph_plan(struct mixed_segment ***segments, uint32_t *count, struct mixed_segment *graph){
+  mixed_err(MIXED_NO_ERROR);
+  struct graph_data *data = (struct graph_data *)graph->data;
+  if(!graph_plan(data))
+    return 0;
+  *segments = (struct mixed_segment **)data->plan.data;
+  *count = data->plan.count;
+  return 1;
+}
+
+static void deque_push(struct graph_worker *worker, uint32_t task){
+  int32_t bottom = atomic_owned(worker->bottom);
+  worker->tasks[bottom] = task;
+  atomic_release(worker->bottom, bottom+1);
+}
+
+static int32_t deque_pop(struct graph_worker *worker){
+  int32_t bottom = atomic_owned(worker->bottom)-1;
+  atomic_write(worker->bottom, bottom);
+  int32_t top = atomic_read(worker->top);
+  if(bottom < top){
+    atomic_write(worker->bottom, bottom+1);
+    return -1;
+  }
+  int32_t task = worker->tasks[bottom];
+  // The last task may be stolen at the same time.
+  if(bottom == top){
+    if(!atomic_cas(worker->top, top, top+1))
+      task = -1;
+    atomic_write(worker->bottom, bottom+1);
+  }
+  return task;
+}
+
+static int32_t deque_steal(struct graph_worker *worker){
+  int32_t top = atomic_read(worker->top);
+  int32_t bottom = atomic_read(worker->bottom);
+  if(top < bottom){
+    int32_t task = worker->tasks[top];
+    if(atomic_cas(worker->top, top, top+1))
+      return task;
+  }
+  return -1;
+}
+
+// Mix segments until all of the current mix is done. Once a segment
+// fails, the rest are only retired so that the mix still ends.
+static void run_tasks(struct graph_worker *worker){
+  struct graph_pool *pool = worker->pool;
+  struct graph_data *data = pool->graph;
+  uint32_t idle = 0;
+  while(0 < atomic_read(pool->remaining)){
+    int32_t task = deque_pop(worker);
+    for(uint32_t i=1; task < 0 && i<pool->count; ++i)
+      task = deque_steal(&pool->workers[(worker->id+i) % pool->count]);
+    if(task < 0){
+      if(++idle % GRAPH_SPINS == 0)
+        thread_yield();
+      continue;
+    }
+    idle = 0;
+    struct mixed_segment *segment = (struct mixed_segment *)data->plan.data[task];
+    if(segment->mix && atomic_read(pool->error) == 0 && !segment->mix(segment)){
+      int error = mixed_error();
+      atomic_cas(pool->error, 0, (error == MIXED_NO_ERROR)? MIXED_MIXING_FAILED : error);
+    }
+    for(uint32_t s=data->successor_start[task]; s<data->successor_start[task+1]; ++s){
+      uint32_t next = data->successors[s];
+      if(atomic_decrement(pool->pending[next]) == 0)
+        deque_push(worker, next);
+    }
+    atomic_decrement(pool->remaining);
+  }
+}
+
+// Helpers spin for a bit between mixes, so that back to back mixes
+// of small blocks do not have to wait for them to be woken up.
+static void *graph_worker_main(void *argument){
+  struct graph_worker *worker = (struct graph_worker *)argument;
+  struct graph_pool *pool = worker->pool;
+  uint32_t seen = 0;
+  for(;;){
+    for(uint32_t i=0; atomic_read(pool->generation) == seen; ++i){
+      if(i < GRAPH_SPINS*GRAPH_YIELDS){
+        if(i % GRAPH_SPINS == 0) thread_yield();
+      }else{
+        atomic_increment(pool->sleepers);
+        futex_wait(&pool->generation, seen, -1);
+        atomic_decrement(pool->sleepers);
+      }
+    }
+    seen = atomic_read(pool->generation);
+    if(atomic_read(pool->quit))
+      break;
+    run_tasks(worker);
+    atomic_increment(pool->finished);
+  }
+  return 0;
+}
+
+static void free_pool_tasks(struct graph_pool *pool){
+  for(uint32_t i=0; i<pool->count; ++i){
+    if(pool->workers[i].tasks)
+      mixed_free(pool->workers[i].tasks);
+    pool->workers[i].tasks = 0;
+  }
+  if(pool->pending)
+    mixed_free(pool->pending);
+  pool->pending = 0;
+  pool->capacity = 0;
+}
+
+// Only called while the helpers wait for the next mix.
+static int reserve_pool(struct graph_pool *pool, uint32_t capacity){
+  if(capacity <= pool->capacity)
+    return 1;
+  free_pool_tasks(pool);
+  pool->pending = mixed_calloc(capacity, sizeof(uint32_t));
+  if(!pool->pending)
+    goto cleanup;
+  for(uint32_t i=0; i<pool->count; ++i){
+    pool->workers[i].tasks = mixed_calloc(capacity, sizeof(uint32_t));
+    if(!pool->workers[i].tasks)
+      goto cleanup;
+  }
+  pool->capacity = capacity;
+  return 1;
+
+ cleanup:
+  free_pool_tasks(pool);
+  mixed_err(MIXED_OUT_OF_MEMORY);
+  return 0;
+}
+
+static void free_pool(struct graph_data *data){
+  struct graph_pool *pool = data->pool;
+  if(!pool) return;
+  atomic_write(pool->quit, 1);
+  atomic_increment(pool->generation);
+  futex_wake(&pool->generation);
+  for(uint32_t i=1; i<pool->count; ++i){
+    if(pool->workers[i].thread)
+      thread_join(pool->workers[i].thread);
+  }
+  free_pool_tasks(pool);
+  mixed_free(pool->workers);
+  mixed_free(pool);
+  data->pool = 0;
+}
+
+static int make_pool(struct graph_data *data){
+  struct graph_pool *pool = mixed_calloc(1, sizeof(struct graph_pool));
+  struct graph_worker *workers = mixed_calloc(data->threads, sizeof(struct graph_worker));
+  if(!pool || !workers){
+    if(pool) mixed_free(pool);
+    if(workers) mixed_free(workers);
+    mixed_err(MIXED_OUT_OF_MEMORY);
+    return 0;
+  }
+  pool->graph = data;
+  pool->workers = workers;
+  pool->count = data->threads;
+  data->pool = pool;
+  for(uint32_t i=0; i<pool->count; ++i){
+    workers[i].pool = pool;
+    workers[i].id = i;
+  }
+  if(!reserve_pool(pool, data->plan.count)){
+    free_pool(data);
+    return 0;
+  }
+  for(uint32_t i=1; i<pool->count; ++i){
+    if(!thread_create(&workers[i].thread, graph_worker_main, &workers[i])){
+      free_pool(data);
+      mixed_err(MIXED_OUT_OF_MEMORY);
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int mix_parallel(struct graph_data *data){
+  struct graph_pool *pool = data->pool;
+  uint32_t count = data->plan.count;
+  if(count == 0)
+    return 1;
+  if(!reserve_pool(pool, count))
+    return 0;
+  for(uint32_t i=0; i<pool->count; ++i){
+    pool->workers[i].top = 0;
+    pool->workers[i].bottom = 0;
+  }
+  // Spread the segments that can start right away over all workers.
+  uint32_t next = 0;
+  for(uint32_t i=0; i<count; ++i){
+    pool->pending[i] = data->dependencies[i];
+    if(pool->pending[i] == 0)
+      deque_push(&pool->workers[next++ % pool->count], i);
+  }
+  pool->error = 0;
+  pool->finished = 0;
+  atomic_write(pool->remaining, count);
+  atomic_increment(pool->generation);
+  if(atomic_read(pool->sleepers))
+    futex_wake(&pool->generation);
+  run_tasks(&pool->workers[0]);
+  for(uint32_t i=0; atomic_read(pool->finished) < pool->count-1; ++i){
+    if(i % GRAPH_SPINS == 0) thread_yield();
+  }
+  if(pool->error){
+    mixed_err(pool->error);
+    return 0;
+  }
+  return 1;
+}
+
+int graph_segment_free(struct mixed_segment *segment){
+  struct graph_data *data = (struct graph_data *)segment->data;
+  if(data){
+    free_pool(data);
+    free_schedule(data);
+    for(uint32_t i=0; i<data->edges.count; ++i)
+      mixed_free(data->edges.data[i]);
+    free_vector(&data->segments);
+    free_vector(&data->edges);
+    free_vector(&data->plan);
+    mixed_free(data);
+  }
+  segment->data = 0;
+  return 1;
+}
+
+int graph_segment_start(struct mixed_segment *segment){
+  struct graph_data *data = (struct graph_data *)segment->data;
+  if(!graph_plan(data))
+    return 0;
+  if(1 < data->threads && !data->pool && !make_pool(data))
+    return 0;
+  for(uint32_t i=0; i<data->plan.count; ++i){
+    struct mixed_segment *segment = (struct mixed_segment *)data->plan.data[i];
+    if(segment->start){
+      if(!segment->start(segment)){
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+int graph_segment_mix(struct mixed_segment *segment){
+  struct graph_data *data = (struct graph_data *)segment->data;
+  if(data->dirty && !graph_plan(data))
+    return 0;
+  if(data->pool)
+    return mix_parallel(data);
+  uint32_t count = data->plan.count;
+  for(uint32_t i=0; i<count; ++i){
+    struct mixed_segment *segment = (struct mixed_segment *)data->plan.data[i];
+    if(segment->mix){
+      if(!segment->mix(segment)){
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+int graph_segment_end(struct mixed_segment *segment){
+  struct graph_data *data = (struct graph_data *)segment->data;
+  free_pool(data);
+  for(uint32_t i=0; i<data->plan.count; ++i){
+    struct mixed_segment *segment = (struct mixed_segment *)data->plan.data[i];
+    if(segment->end){
+      if(!segment->end(segment)){
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+int graph_segment_info(struct mixed_segment_info *info, struct mixed_segment *segment){
+  IGNORE(segment);
+
+  info->name = "graph";
+  info->description = "Run connected segments in dependency order.";
+  info->flags = 0;
+  info->min_inputs = 0;
+  info->max_inputs = 0;
+  info->outputs = 0;
+
+  struct mixed_segment_field_info *field = info->fields;
+  set_info_field(field++, MIXED_THREADS,
+                 MIXED_UINT32, 1, MIXED_SEGMENT | MIXED_SET | MIXED_GET,
+                 "The number of threads to mix with.");
+
+  clear_info_field(field++);
+  return 1;
+}
+
+int graph_segment_get(uint32_t field, void *value, struct mixed_segment *segment){
+  struct graph_data *data = (struct graph_data *)segment->data;
+  switch(field){
+  case MIXED_THREADS: *((uint32_t *)value) = data->threads; break;
+  default: mixed_err(MIXED_INVALID_FIELD); return 0;
+  }
+  return 1;
+}
+
+int graph_segment_set(uint32_t field, void *value, struct mixed_segment *segment){
+  struct graph_data *data = (struct graph_data *)segment->data;
+  switch(field){
+  case MIXED_THREADS: {
+    uint32_t threads = *(uint32_t *)value;
+    if(threads == 0){
+      mixed_err(MIXED_INVALID_VALUE);
+      return 0;
+    }
+    // A running pool is replaced by one of the new size.
+    bool running = (data->pool != 0);
+    free_pool(data);
+    data->threads = threads;
+    if(running && 1 < threads)
+      return make_pool(data);
+  }
+    break;
+  default:
+    mixed_err(MIXED_INVALID_FIELD);
+    return 0;
+  }
+  return 1;
+}
+
+MIXED_EXPORT int mixed_make_segment_graph(struct mixed_segment *segment){
+  struct graph_data *data = mixed_calloc(1, sizeof(struct graph_data));
+  if(!data){
+    mixed_err(MIXED_OUT_OF_MEMORY);
+    return 0;
+  }
+
+  segment->free = graph_segment_free;
+  segment->start = graph_segment_start;
+  segment->mix = graph_segment_mix;
+  segment->end = graph_segment_end;
+  segment->info = graph_segment_info;
+  segment->get = graph_segment_get;
+  segment->set = graph_segment_set;
+  data->threads = 1;
+  segment->data = data;
+  return 1;
+}
+
+int __make_graph(void *args, struct mixed_segment *segment){
+  IGNORE(args);
+  return mixed_make_segment_graph(segment);
+}
+
+REGISTER_SEGMENT(graph, __make_graph, 0, {0})
@@ -15,7 +15,7 @@ struct noise_segment_data{
 
 int noise_segment_free(struct mixed_segment *segment){
   if(segment->data)
-    free(segment->data);
+    mixed_free(segment->data);
   segment->data = 0;
   return 1;
 }
@@ -166,7 +166,7 @@ int noise_segment_set(uint32_t field, void *value, struct mixed_segment *segment
 }
 
 MIXED_EXPORT int mixed_make_segment_noise(enum mixed_noise_type type, struct mixed_segment *segment){
-  struct noise_segment_data *data = calloc(1, sizeof(struct noise_segment_data));
+  struct noise_segment_data *data = mixed_calloc(1, sizeof(struct noise_segment_data));
   if(!data){
     mixed_err(MIXED_OUT_OF_MEMORY);
     return 0;
@@ -1,25 +1,93 @@
 #include "../internal.h"
 #include "samplerate.h"
 
+// Frames per channel that are resampled in one go.
+#define RESAMPLE_FRAMES 2048
+
 struct pack_segment_data{
   struct mixed_pack *pack;
-  struct mixed_buffer *buffers[12];
-  SRC_STATE *resample_state;
+  // The pack's channel count at creation, which the per-port arrays
+  // below are sized to.
+  channel_t channels;
+  // The number of ports, and the pack channel each one maps to if
+  // a channel map is set.
+  channel_t ports;
+  bool mapped;
+  channel_t *map;
+  struct mixed_buffer **buffers;
+  // Whether the buffers are all views of the pack's planes, in which
+  // case there is nothing to convert.
+  bool views;
+  // One state per channel, so that the resampler can work on the
+  // planar buffer data directly.
+  SRC_STATE **resample_states;
   uint32_t samplerate;
   float volume;
   float target_volume;
   int quality;
-  float resample_in[512];
-  float resample_out[512];
+  enum mixed_dither_type dither;
+  struct dither_channel *dither_state;
+  // Decoded frames of block-coded packs, which are converted a
+  // whole block at a time.
+  struct mixed_pack blocks;
+  // Planar staging between the pack and the resampler, holding
+  // RESAMPLE_FRAMES per port.
+  float *resample_data;
 };
 
+static inline channel_t *pack_map(struct pack_segment_data *data){
+  return data->mapped? data->map : 0;
+}
+
+static void free_resample_states(struct pack_segment_data *data){
+  for(channel_t c=0; c<data->channels; ++c){
+    if(data->resample_states[c])
+      src_delete(data->resample_states[c]);
+    data->resample_states[c] = 0;
+  }
+  if(data->resample_data)
+    mixed_free(data->resample_data);
+  data->resample_data = 0;
+}
+
+static int make_resample_states(struct pack_segment_data *data){
+  SRC_STATE *states[data->channels];
+  memset(states, 0, sizeof(states));
+  float *staging = mixed_calloc((size_t)data->ports*RESAMPLE_FRAMES, sizeof(float));
+  if(!staging)
+    return 0;
+  for(channel_t c=0; c<data->ports; ++c){
+    int e = 0;
+    states[c] = src_new(data->quality, 1, &e);
+    if(!states[c]){
+      fprintf(stderr, "libsamplerate: %s\n", src_strerror(e));
+      for(channel_t i=0; i<c; ++i)
+        src_delete(states[i]);
+      mixed_free(staging);
+      return 0;
+    }
+  }
+  free_resample_states(data);
+  memcpy(data->resample_states, states, sizeof(states));
+  data->resample_data = staging;
+  return 1;
+}
+
+static void free_pack_data(struct pack_segment_data *data){
+  if(data->resample_states)
+    free_resample_states(data);
+  mixed_free_pack(&data->blocks);
+  if(data->map) mixed_free(data->map);
+  if(data->buffers) mixed_free(data->buffers);
+  if(data->resample_states) mixed_free(data->resample_states);
+  if(data->dither_state) mixed_free(data->dither_state);
+  mixed_free(data);
+}
+
 int pack_segment_free(struct mixed_segment *segment){
   struct pack_segment_data *data = (struct pack_segment_data *)segment->data;
-  if(data){
-    if(data->resample_state)
-      src_delete(data->resample_state);
-    free(data);
-  }
+  if(data)
+    free_pack_data(data);
   segment->data = 0;
   return 1;
 }
@@ -29,7 +97,7 @@ int pack_segment_set_buffer(uint32_t field, uint32_t location, void *buffer, str
 
   switch(field){
   case MIXED_BUFFER:
-    if(location<data->pack->channels && location<12){
+    if(location<data->ports){
       data->buffers[location] = (struct mixed_buffer *)buffer;
       return 1;
     }else{
@@ -42,6 +110,18 @@ int pack_segment_set_buffer(uint32_t field, uint32_t location, void *buffer, str
   }
 }
 
+// Returns the pack channel the buffer is a view of, or -1.
+static int32_t view_channel(struct mixed_pack *pack, struct mixed_buffer *buffer){
+  unsigned char *data = (unsigned char *)buffer->_data;
+  if(!buffer->virtual || !(pack->flags & MIXED_PACK_PLANAR) || pack->encoding != MIXED_FLOAT)
+    return -1;
+  for(channel_t c=0; c<pack->channels; ++c){
+    if(data == pack->_data + (size_t)c*pack->size)
+      return c;
+  }
+  return -1;
+}
+
 int pack_segment_start(struct mixed_segment *segment){
   struct pack_segment_data *data = (struct pack_segment_data *)segment->data;
   if(data->pack == 0){
@@ -49,12 +129,12 @@ int pack_segment_start(struct mixed_segment *segment){
     return 0;
   }
   
-  if(12 < data->pack->channels){
+  if(data->pack->channels != data->channels){
     mixed_err(MIXED_INVALID_VALUE);
     return 0;
   }
 
-  for(int i=0; i<data->pack->channels; ++i){
+  for(int i=0; i<data->ports; ++i){
     if(data->buffers[i] == 0){
       mixed_err(MIXED_BUFFER_MISSING);
       return 0;
@@ -67,77 +147,157 @@ int pack_segment_start(struct mixed_segment *segment){
     return 0;
   }
 
-  if(data->resample_state)
-    src_reset(data->resample_state);
-  else{
-    int e = 0;
-    SRC_STATE *src_state = src_new(data->quality, data->pack->channels, &e);
-    if(!src_state){
+  // Either all ports are views of their own channel, or none may be
+  // a view at all, as the pack would otherwise be written to.
+  channel_t *map = pack_map(data);
+  channel_t views = 0;
+  for(channel_t c=0; c<data->ports; ++c){
+    int32_t channel = view_channel(data->pack, data->buffers[c]);
+    if(channel == (map? map[c] : c))
+      ++views;
+    else if(0 <= channel)
+      views = data->ports+1;
+  }
+  if(views != 0 && views != data->ports){
+    mixed_err(MIXED_INVALID_VALUE);
+    return 0;
+  }
+  data->views = (0 < views);
+  if(data->views){
+    // Only the unpacker can read through views, the packer would
+    // copy the pack onto itself.
+    if(segment->set_in){
+      mixed_err(MIXED_INVALID_VALUE);
+      return 0;
+    }
+    // Views cannot be resampled, and must all start out in sync.
+    if(data->samplerate != data->pack->samplerate){
+      mixed_err(MIXED_BAD_RESAMPLE_FACTOR);
+      return 0;
+    }
+    for(channel_t c=0; c<data->ports; ++c)
+      mixed_make_buffer_view(data->pack, map? map[c] : c, data->buffers[c]);
+  }
+
+  if(data->resample_states[0]){
+    for(channel_t c=0; c<data->ports; ++c)
+      src_reset(data->resample_states[c]);
+  }else if(!make_resample_states(data)){
+    mixed_err(MIXED_OUT_OF_MEMORY);
+    return 0;
+  }
+  return 1;
+}
+
+// Resample every channel by the same amount. Since the states only
+// differ in the sample values they see, all of them consume and
+// produce the same number of frames.
+static int resample_channels(struct pack_segment_data *data, float **ins, uint32_t in_frames, float **outs, uint32_t out_frames, double ratio, uint32_t *used, uint32_t *generated){
+  *used = 0;
+  *generated = 0;
+  for(channel_t c=0; c<data->ports; ++c){
+    SRC_DATA src_data = {0};
+    src_data.data_in = ins[c];
+    src_data.data_out = outs[c];
+    src_data.input_frames = in_frames;
+    src_data.output_frames = out_frames;
+    src_data.src_ratio = ratio;
+    int e = src_process(data->resample_states[c], &src_data);
+    if(e){
       fprintf(stderr, "libsamplerate: %s\n", src_strerror(e));
-      mixed_err(MIXED_OUT_OF_MEMORY);
+      mixed_err(MIXED_RESAMPLE_FAILED);
       return 0;
     }
-    data->resample_state = src_state;
+    *used = src_data.input_frames_used;
+    *generated = src_data.output_frames_gen;
   }
   return 1;
 }
 
-// FIXME: by using separate states per channel we could alias the
-//        SRC_DATA arrays with the input buffer arrays and avoid
-//        extra allocation and copying on at least one side.
+// Decode as many whole blocks as there is room for.
+static void decode_blocks(struct pack_segment_data *data){
+  struct mixed_pack *pack = data->pack;
+  uint32_t block_bytes = pack_unit_bytes(pack);
+  uint32_t frame_bytes = MIXED_ADPCM_BLOCK_FRAMES*pack->channels*sizeof(float);
+  data->blocks.samplerate = pack->samplerate;
+  for(;;){
+    void *in, *out;
+    uint32_t in_bytes = block_bytes, out_bytes = frame_bytes;
+    mixed_pack_request_read(&in, &in_bytes, pack);
+    mixed_pack_request_write(&out, &out_bytes, &data->blocks);
+    if(in_bytes < block_bytes || out_bytes < frame_bytes)
+      break;
+    adpcm_decode_block(in, pack->channels, out);
+    mixed_pack_finish_write(frame_bytes, &data->blocks);
+    mixed_pack_finish_read(block_bytes, pack);
+  }
+}
+
+// Encode as many whole blocks as there are frames for.
+static void encode_blocks(struct pack_segment_data *data){
+  struct mixed_pack *pack = data->pack;
+  uint32_t block_bytes = pack_unit_bytes(pack);
+  uint32_t frame_bytes = MIXED_ADPCM_BLOCK_FRAMES*pack->channels*sizeof(float);
+  for(;;){
+    void *in, *out;
+    uint32_t in_bytes = frame_bytes, out_bytes = block_bytes;
+    mixed_pack_request_read(&in, &in_bytes, &data->blocks);
+    mixed_pack_request_write(&out, &out_bytes, pack);
+    if(in_bytes < frame_bytes || out_bytes < block_bytes)
+      break;
+    adpcm_encode_block(in, pack->channels, out);
+    mixed_pack_finish_write(block_bytes, pack);
+    mixed_pack_finish_read(frame_bytes, &data->blocks);
+  }
+}
 
 int source_segment_mix(struct mixed_segment *segment){
   struct pack_segment_data *data = (struct pack_segment_data *)segment->data;
   struct mixed_pack *pack = data->pack;
 
+  if(data->views)
+    return mixed_pack_sync_views(pack, data->buffers, data->ports);
+
+  if(data->blocks._data){
+    decode_blocks(data);
+    pack = &data->blocks;
+  }
+
   if(pack->samplerate == data->samplerate){
-    mixed_buffer_from_pack(data->pack, data->buffers, &data->volume, data->target_volume);
+    buffer_from_pack(pack, data->buffers, pack_map(data), data->ports, &data->volume, data->target_volume);
   }else{
-    void *pack_data;
-    float *target = data->resample_in;
-    channel_t channels = pack->channels;
-    uint32_t frames, buffer_frames = 512 / channels;
-    uint32_t frames_to_bytes = channels * mixed_samplesize(pack->encoding);
-    mixed_transfer_function_from decoder = mixed_translator_from(pack->encoding);
-    SRC_DATA src_data = {0};
-    src_data.src_ratio = ((double)data->samplerate)/((double)pack->samplerate);
-    src_data.data_in = target;
-    src_data.data_out = data->resample_out;
+    channel_t ports = data->ports;
+    uint32_t frames_to_bytes = pack_unit_bytes(pack);
+    double ratio = ((double)data->samplerate)/((double)pack->samplerate);
+    struct mixed_buffer_group group = {0, 0, data->buffers, ports};
+    float *planes[ports], *outs[ports];
+    for(channel_t c=0; c<ports; ++c)
+      planes[c] = data->resample_data + c*RESAMPLE_FRAMES;
+    uint32_t used;
     do{
       // Step 1: determine available space
-      frames = buffer_frames;
-      for(channel_t c=0; c<channels; ++c)
-        frames = MIN(frames, mixed_buffer_available_write(data->buffers[c]));
-      src_data.output_frames = frames;
-      // Step 2: unpack to contiguous floats
+      uint32_t out_frames = UINT32_MAX;
+      mixed_buffer_group_request(0, outs, &out_frames, &group);
+      // Step 2: decode only as much as the space can take
+      char *pack_data = 0;
       uint32_t bytes = UINT32_MAX;
-      mixed_pack_request_read(&pack_data, &bytes, pack);
-      frames = MIN(frames, bytes / frames_to_bytes);
-      if(pack_data){
-        data->volume = decoder(pack_data, (float*)src_data.data_in, 1, frames*channels, data->volume, data->target_volume);
-        // Step 3: resample
-        src_data.input_frames = frames;
-        int e = src_process(data->resample_state, &src_data);
-        if(e){
-          fprintf(stderr, "libsamplerate: %s\n", src_strerror(e));
-          mixed_err(MIXED_RESAMPLE_FAILED);
-          return 0;
-        }
-        // Step 4: transfer from contigous to separate buffers
-        frames = src_data.input_frames_used;
-        float *source = src_data.data_out;
-        for(channel_t c=0; c<channels; ++c){
-          uint32_t out_frames = src_data.output_frames_gen;
-          mixed_buffer_request_write(&target, &out_frames, data->buffers[c]);
-          for(uint32_t i=0; i<out_frames; ++i)
-            target[i] = source[i*channels];
-          source++;
-          mixed_buffer_finish_write(out_frames, data->buffers[c]);
-        }
-        // Step 5: update consumed samples
-        mixed_pack_finish_read(frames * frames_to_bytes, pack);
-      }
-    }while(frames);
+      mixed_pack_request_read((void**)&pack_data, &bytes, pack);
+      uint32_t frames = MIN(RESAMPLE_FRAMES, bytes / frames_to_bytes);
+      frames = MIN(frames, (uint32_t)(out_frames / ratio));
+      if(!pack_data || out_frames == 0)
+        break;
+      float volume = data->volume;
+      unpack_frames(pack, pack_data, pack_map(data), ports, planes, frames, &volume, data->target_volume);
+      // Step 3: resample straight into the buffers
+      uint32_t generated;
+      if(!resample_channels(data, planes, frames, outs, out_frames, ratio, &used, &generated))
+        return 0;
+      // Frames the resampler did not take are decoded again next time.
+      data->volume = ramp_volume(data->volume, data->target_volume, used);
+      // Step 4: update consumed samples
+      mixed_pack_finish_read(used * frames_to_bytes, pack);
+      mixed_buffer_group_finish(generated, &group);
+    }while(used);
   }
   return 1;
 }
@@ -146,66 +306,107 @@ int drain_segment_mix(struct mixed_segment *segment){
   struct pack_segment_data *data = (struct pack_segment_data *)segment->data;
   struct mixed_pack *pack = data->pack;
 
+  if(data->blocks._data){
+    pack = &data->blocks;
+    pack->samplerate = data->pack->samplerate;
+  }
+
   if(pack->samplerate == data->samplerate){
-    mixed_buffer_to_pack(data->buffers, pack, &data->volume, data->target_volume);
+    buffer_to_pack(data->buffers, pack, pack_map(data), data->ports, &data->volume, data->target_volume, data->dither, data->dither_state);
   }else{
-    void *pack_data;
-    float *target = data->resample_in;
-    channel_t channels = pack->channels;
-    uint32_t frames, buffer_frames = 512 / channels;
-    uint32_t frames_to_bytes = channels * mixed_samplesize(pack->encoding);
-    mixed_transfer_function_to encoder = mixed_translator_to(pack->encoding);
-    SRC_DATA src_data = {0};
-    src_data.src_ratio = ((double)pack->samplerate)/((double)data->samplerate);
-    src_data.data_in = target;
-    src_data.data_out = data->resample_out;
+    channel_t ports = data->ports;
+    uint32_t frames_to_bytes = pack_unit_bytes(pack);
+    double ratio = ((double)pack->samplerate)/((double)data->samplerate);
+    struct mixed_buffer_group group = {data->buffers, ports, 0, 0};
+    enum mixed_dither_type dither = dither_applies(pack->encoding)? data->dither : MIXED_NO_DITHER;
+    float *planes[ports], *ins[ports];
+    for(channel_t c=0; c<ports; ++c)
+      planes[c] = data->resample_data + c*RESAMPLE_FRAMES;
+    uint32_t used;
     do{
+      char *pack_data = 0;
       uint32_t bytes = UINT32_MAX;
-      // Interleave data, count frames
-      mixed_pack_request_write(&pack_data, &bytes, pack);
+      mixed_pack_request_write((void**)&pack_data, &bytes, pack);
       // If we don't even have 2 frames worth of data remaining to write, clear.
-      if(bytes < 2*frames_to_bytes && mixed_pack_available_read(pack) == 0){
+      if(bytes < 2*frames_to_bytes && mixed_pack_available_read(pack) == 0 && !(pack->flags & MIXED_PACK_MIRRORED)){
         mixed_pack_clear(pack);
-        mixed_pack_request_write(&pack_data, &bytes, pack);
+        mixed_pack_request_write((void**)&pack_data, &bytes, pack);
       }
-      src_data.output_frames = MIN(buffer_frames, bytes / frames_to_bytes);
-      frames = MIN(buffer_frames, (src_data.output_frames*data->samplerate) / pack->samplerate);
-      if(pack_data){
-        for(channel_t c=0; c<channels; ++c){
-          float *source;
-          mixed_buffer_request_read(&source, &frames, data->buffers[c]);
-          for(uint32_t i=0; i<frames; ++i)
-            target[c+i*channels] = source[i];
-        }
-        // Resample
-        src_data.input_frames = frames;
-        int e = src_process(data->resample_state, &src_data);
-        if(e){
-          fprintf(stderr, "libsamplerate: %s\n", src_strerror(e));
-          mixed_error(MIXED_RESAMPLE_FAILED);
-          return 0;
-        }
-        // Pack
-        frames = src_data.input_frames_used;
-        uint32_t out_frames = src_data.output_frames_gen;
-        data->volume = encoder(src_data.data_out, pack_data, 1, out_frames*channels, data->volume, data->target_volume);
-        // Update consumed buffers
-        mixed_pack_finish_write(out_frames * frames_to_bytes, pack);
-        for(channel_t c=0; c<channels; ++c){
-          mixed_buffer_finish_read(frames, data->buffers[c]);
-        }
-      }
-    }while(frames);
+      uint32_t out_frames = MIN(RESAMPLE_FRAMES, bytes / frames_to_bytes);
+      if(!pack_data || out_frames == 0)
+        break;
+      // Resample straight from the buffers
+      uint32_t frames = UINT32_MAX;
+      mixed_buffer_group_request(ins, 0, &frames, &group);
+      frames = MIN(frames, (uint32_t)(out_frames / ratio));
+      uint32_t generated;
+      if(!resample_channels(data, ins, frames, planes, out_frames, ratio, &used, &generated))
+        return 0;
+      // Pack
+      pack_frames(planes, pack, pack_data, pack_map(data), ports, generated, &data->volume, data->target_volume, dither, data->dither_state);
+      // Update consumed buffers
+      mixed_pack_finish_write(generated * frames_to_bytes, pack);
+      mixed_buffer_group_finish(used, &group);
+    }while(used);
   }
+
+  if(data->blocks._data)
+    encode_blocks(data);
   return 1;
 }
 
 int pack_segment_end(struct mixed_segment *segment){
   struct pack_segment_data *data = (struct pack_segment_data *)segment->data;
-  if(data->resample_state){
-    src_delete(data->resample_state);
-    data->resample_state = 0;
+  free_resample_states(data);
+  return 1;
+}
+
+// Pad the last partial block with silence, so that its frames are
+// encoded too. Blocks are only ever read whole and the staging pack
+// holds exactly two, so the partial block is contiguous.
+static void flush_blocks(struct pack_segment_data *data){
+  uint32_t frame_bytes = MIXED_ADPCM_BLOCK_FRAMES*data->pack->channels*sizeof(float);
+  uint32_t used = mixed_pack_available_read(&data->blocks);
+  if(used == 0 || frame_bytes <= used)
+    return;
+  void *out;
+  uint32_t bytes = frame_bytes - used;
+  mixed_pack_request_write(&out, &bytes, &data->blocks);
+  memset(out, 0, bytes);
+  mixed_pack_finish_write(bytes, &data->blocks);
+  encode_blocks(data);
+}
+
+int drain_segment_end(struct mixed_segment *segment){
+  struct pack_segment_data *data = (struct pack_segment_data *)segment->data;
+  if(data->blocks._data)
+    flush_blocks(data);
+  return pack_segment_end(segment);
+}
+
+static int set_channel_map(struct pack_segment_data *data, struct mixed_channel_map *map){
+  if(data->channels < map->count){
+    mixed_err(MIXED_INVALID_VALUE);
+    return 0;
   }
+  for(channel_t c=0; c<map->count; ++c){
+    if(data->pack->channels <= map->channels[c]){
+      mixed_err(MIXED_INVALID_VALUE);
+      return 0;
+    }
+  }
+
+  channel_t ports = data->ports;
+  data->ports = (map->count)? map->count : data->pack->channels;
+  if(data->resample_states[0] && !make_resample_states(data)){
+    data->ports = ports;
+    mixed_err(MIXED_OUT_OF_MEMORY);
+    return 0;
+  }
+  data->mapped = (map->count != 0);
+  memcpy(data->map, map->channels, map->count*sizeof(channel_t));
+  for(channel_t c=data->ports; c<data->channels; ++c)
+    data->buffers[c] = 0;
   return 1;
 }
 
@@ -213,27 +414,21 @@ int source_segment_set(uint32_t field, void *value, struct mixed_segment *segmen
   struct pack_segment_data *data = (struct pack_segment_data *)segment->data;
   
   switch(field){
-  case MIXED_RESAMPLE_TYPE: {
-    int error;
+  case MIXED_CHANNEL_MAP:
+    return set_channel_map(data, (struct mixed_channel_map *)value);
+  case MIXED_RESAMPLE_TYPE:
     data->quality = *(enum mixed_resample_type *)value;
-    if(data->resample_state){
-      SRC_STATE *new = src_new(data->quality, data->pack->channels, &error);
-      if(!new) {
-        mixed_err(MIXED_RESAMPLE_FAILED);
-        return 0;
-      }
-      if(data->resample_state)
-        src_delete(data->resample_state);
-      data->resample_state = new;
+    if(data->resample_states[0] && !make_resample_states(data)){
+      mixed_err(MIXED_RESAMPLE_FAILED);
+      return 0;
     }
-  }
     return 1;
   case MIXED_VOLUME:
     data->target_volume = *((float *)value);
     return 1;
   case MIXED_BYPASS:
     if(*(bool *)value){
-      for(channel_t i=0; i<data->pack->channels; ++i){
+      for(channel_t i=0; i<data->ports; ++i){
         mixed_buffer_clear(data->buffers[i]);
       }
       segment->mix = mix_noop;
@@ -248,7 +443,31 @@ int source_segment_set(uint32_t field, void *value, struct mixed_segment *segmen
 }
 
 int drain_segment_set(uint32_t field, void *value, struct mixed_segment *segment){
+  struct pack_segment_data *data = (struct pack_segment_data *)segment->data;
+  
   switch(field){
+  case MIXED_DITHER: {
+    enum mixed_dither_type dither = *(enum mixed_dither_type *)value;
+    if(dither < MIXED_NO_DITHER || MIXED_SHAPED_DITHER < dither){
+      mixed_err(MIXED_INVALID_VALUE);
+      return 0;
+    }
+    data->dither = dither;
+  }
+    return 1;
+  case MIXED_CHANNEL_MAP: {
+    // Each pack channel can only be written from one port.
+    struct mixed_channel_map *map = (struct mixed_channel_map *)value;
+    for(channel_t i=0; i<map->count; ++i){
+      for(channel_t j=0; j<i; ++j){
+        if(map->channels[i] == map->channels[j]){
+          mixed_err(MIXED_INVALID_VALUE);
+          return 0;
+        }
+      }
+    }
+  }
+    return source_segment_set(field, value, segment);
   case MIXED_BYPASS:
     if(*(bool *)value){
       segment->mix = mix_noop;
@@ -274,20 +493,31 @@ int packer_segment_get(uint32_t field, void *value, struct mixed_segment *segmen
   case MIXED_BYPASS:
     *(bool *)value = (segment->mix == mix_noop);
     return 1;
+  case MIXED_CHANNEL_MAP: {
+    struct mixed_channel_map *map = (struct mixed_channel_map *)value;
+    map->count = (data->mapped)? data->ports : 0;
+    map->channels = data->map;
+  }
+    return 1;
   default:
     mixed_err(MIXED_INVALID_FIELD);
     return 0;
   }
 }
 
-int source_segment_info(struct mixed_segment_info *info, struct mixed_segment *segment){
-  info->name = "unpacker";
-  info->description = "Segment acting as an audio unpacker.";
-  info->min_inputs = 0;
-  info->max_inputs = 0;
-  info->outputs = ((struct pack_segment_data *)segment->data)->pack->channels;
+int drain_segment_get(uint32_t field, void *value, struct mixed_segment *segment){
+  struct pack_segment_data *data = (struct pack_segment_data *)segment->data;
   
-  struct mixed_segment_field_info *field = info->fields;
+  switch(field){
+  case MIXED_DITHER:
+    *(enum mixed_dither_type *)value = data->dither;
+    return 1;
+  default:
+    return packer_segment_get(field, value, segment);
+  }
+}
+
+static struct mixed_segment_field_info *pack_segment_info_fields(struct mixed_segment_field_info *field){
   set_info_field(field++, MIXED_BUFFER,
                  MIXED_BUFFER_POINTER, 1, MIXED_OUT | MIXED_SET,
                  "The buffer to attach to the port.");
@@ -303,51 +533,94 @@ int source_segment_info(struct mixed_segment_info *info, struct mixed_segment *s
   set_info_field(field++, MIXED_BYPASS,
                  MIXED_BOOL, 1, MIXED_SEGMENT | MIXED_SET | MIXED_GET,
                  "Bypass the segment's processing.");
+
+  set_info_field(field++, MIXED_CHANNEL_MAP,
+                 MIXED_CHANNEL_MAP_POINTER, 1, MIXED_SEGMENT | MIXED_SET | MIXED_GET,
+                 "The pack channels that the ports correspond to.");
+  return field;
+}
+
+int source_segment_info(struct mixed_segment_info *info, struct mixed_segment *segment){
+  info->name = "unpacker";
+  info->description = "Segment acting as an audio unpacker.";
+  info->min_inputs = 0;
+  info->max_inputs = 0;
+  info->outputs = ((struct pack_segment_data *)segment->data)->ports;
   
+  struct mixed_segment_field_info *field = pack_segment_info_fields(info->fields);
   clear_info_field(field++);
   return 1;
 }
 
 int drain_segment_info(struct mixed_segment_info *info, struct mixed_segment *segment){
-  source_segment_info(info, segment);
   info->name = "packer";
   info->description = "Segment acting as an audio packer.";
-  info->min_inputs = ((struct pack_segment_data *)segment->data)->pack->channels;
+  info->min_inputs = ((struct pack_segment_data *)segment->data)->ports;
   info->max_inputs = info->min_inputs;
   info->outputs = 0;
+  
+  struct mixed_segment_field_info *field = pack_segment_info_fields(info->fields);
+  set_info_field(field++, MIXED_DITHER,
+                 MIXED_DITHER_TYPE_ENUM, 1, MIXED_SEGMENT | MIXED_SET | MIXED_GET,
+                 "The dither applied when quantising to integer samples.");
+  
+  clear_info_field(field++);
   return 1;
 }
 
 int make_pack_internal(struct mixed_pack *pack, uint32_t samplerate, int quality, struct mixed_segment *segment){
   struct pack_segment_data *data = 0;
 
-  if(pack->encoding < MIXED_INT8 || MIXED_DOUBLE < pack->encoding){
+  if(!mixed_translator_from(pack->encoding) && pack->encoding != MIXED_IMA_ADPCM){
     mixed_err(MIXED_UNKNOWN_ENCODING);
     goto cleanup;
   }
 
-  data = calloc(1, sizeof(struct pack_segment_data));
+  data = mixed_calloc(1, sizeof(struct pack_segment_data));
   if(!data){
     mixed_err(MIXED_OUT_OF_MEMORY);
     goto cleanup;
   }
 
+  data->channels = pack->channels;
+  data->map = mixed_calloc(pack->channels, sizeof(channel_t));
+  data->buffers = mixed_calloc(pack->channels, sizeof(struct mixed_buffer *));
+  data->resample_states = mixed_calloc(pack->channels, sizeof(SRC_STATE *));
+  data->dither_state = mixed_calloc(pack->channels, sizeof(struct dither_channel));
+  if(!data->map || !data->buffers || !data->resample_states || !data->dither_state){
+    mixed_err(MIXED_OUT_OF_MEMORY);
+    goto cleanup;
+  }
+
   data->pack = pack;
+  data->ports = pack->channels;
   data->samplerate = samplerate;
   data->volume = 1.0;
   data->target_volume = 1.0;
   data->quality = quality;
+  data->dither = MIXED_NO_DITHER;
+  for(channel_t c=0; c<pack->channels; ++c)
+    dither_seed(&data->dither_state[c], c);
+
+  if(pack->encoding == MIXED_IMA_ADPCM){
+    // Room for two blocks, so that one can be converted while the
+    // other is still being transferred.
+    data->blocks.encoding = MIXED_FLOAT;
+    data->blocks.channels = pack->channels;
+    data->blocks.samplerate = pack->samplerate;
+    if(!mixed_make_pack(2*MIXED_ADPCM_BLOCK_FRAMES, &data->blocks))
+      goto cleanup;
+  }
 
   segment->free = pack_segment_free;
   segment->start = pack_segment_start;
   segment->end = pack_segment_end;
-  segment->get = packer_segment_get;
   segment->data = data;
   return 1;
 
  cleanup:
   if(data)
-    free(data);
+    free_pack_data(data);
   return 0;
 }
 
@@ -355,6 +628,7 @@ MIXED_EXPORT int mixed_make_segment_unpacker(struct mixed_pack *pack, uint32_t s
   segment->mix = source_segment_mix;
   segment->info = source_segment_info;
   segment->set = source_segment_set;
+  segment->get = packer_segment_get;
   segment->set_out = pack_segment_set_buffer;
   return make_pack_internal(pack, samplerate, MIXED_SINC_FASTEST, segment);
 }
@@ -371,8 +645,12 @@ MIXED_EXPORT int mixed_make_segment_packer(struct mixed_pack *pack, uint32_t sam
   segment->mix = drain_segment_mix;
   segment->info = drain_segment_info;
   segment->set = drain_segment_set;
+  segment->get = drain_segment_get;
   segment->set_in = pack_segment_set_buffer;
-  return make_pack_internal(pack, samplerate, MIXED_SINC_FASTEST, segment);
+  if(!make_pack_internal(pack, samplerate, MIXED_SINC_FASTEST, segment))
+    return 0;
+  segment->end = drain_segment_end;
+  return 1;
 }
 
 int __make_packer(void *args, struct mixed_segment *segment){
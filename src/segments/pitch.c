@@ -12,7 +12,7 @@ struct pitch_segment_data{
 int pitch_segment_free(struct mixed_segment *segment){
   if(segment->data){
     free_pitch_data(&((struct pitch_segment_data *)segment->data)->pitch_data);
-    free(segment->data);
+    mixed_free(segment->data);
   }
   segment->data = 0;
   return 1;
@@ -185,14 +185,14 @@ int pitch_segment_set(uint32_t field, void *value, struct mixed_segment *segment
 }
 
 MIXED_EXPORT int mixed_make_segment_pitch(float pitch, uint32_t samplerate, struct mixed_segment *segment){
-  struct pitch_segment_data *data = calloc(1, sizeof(struct pitch_segment_data));
+  struct pitch_segment_data *data = mixed_calloc(1, sizeof(struct pitch_segment_data));
   if(!data){
     mixed_err(MIXED_OUT_OF_MEMORY);
     return 0;
   }
 
   if(!make_pitch_data(2048, 4, samplerate, &data->pitch_data)){
-    free(data);
+    mixed_free(data);
     return 0;
   }
 
@@ -9,7 +9,7 @@ struct quantize_segment_data{
 
 int quantize_segment_free(struct mixed_segment *segment){
   if(segment->data)
-    free(segment->data);
+    mixed_free(segment->data);
   segment->data = 0;
   return 1;
 }
@@ -148,7 +148,7 @@ int quantize_segment_set(uint32_t field, void *value, struct mixed_segment *segm
 }
 
 MIXED_EXPORT int mixed_make_segment_quantize(uint32_t steps, struct mixed_segment *segment){
-  struct quantize_segment_data *data = calloc(1, sizeof(struct quantize_segment_data));
+  struct quantize_segment_data *data = mixed_calloc(1, sizeof(struct quantize_segment_data));
   if(!data){
     mixed_err(MIXED_OUT_OF_MEMORY);
     return 0;
@@ -30,8 +30,12 @@ int space_mixer_free(struct mixed_segment *segment){
   struct space_mixer_data *data = (struct space_mixer_data *)segment->data;
   if(data){
     free_pitch_data(&data->pitch_data);
-    free(data->sources);
-    free(data);
+    for(uint32_t i=0; i<data->count; ++i){
+      if(data->sources[i])
+        mixed_free(data->sources[i]);
+    }
+    mixed_free(data->sources);
+    mixed_free(data);
   }
   segment->data = 0;
   return 1;
@@ -157,7 +161,7 @@ VECTORIZE int space_mixer_mix(struct mixed_segment *segment){
   mixed_buffer_request_write(&right, &samples, data->right);
   for(uint32_t s=0; s<data->count; ++s){
     struct space_source *source = data->sources[s];
-    if(!source) continue;
+    if(!source || !source->buffer) continue;
 
     mixed_buffer_request_read(&in, &samples, source->buffer);
     if(samples == 0) break;
@@ -167,7 +171,7 @@ VECTORIZE int space_mixer_mix(struct mixed_segment *segment){
   memset(right, 0, samples*sizeof(float));
   for(uint32_t s=0; s<data->count; ++s){
     struct space_source *source = data->sources[s];
-    if(!source) continue;
+    if(!source || !source->buffer) continue;
   
     float lvolume, rvolume;
     mixed_buffer_request_read(&in, &samples, source->buffer);
@@ -229,11 +233,13 @@ int space_mixer_set_in(uint32_t field, uint32_t location, void *buffer, struct m
       if(location < data->count)
         source = data->sources[location];
       if(!source)
-        source = calloc(1, sizeof(struct space_source));
+        source = mixed_calloc(1, sizeof(struct space_source));
       if(!source){
         mixed_err(MIXED_OUT_OF_MEMORY);
         return 0;
       }
+      if(!source->buffer)
+        memset(source, 0, sizeof(struct space_source));
       source->buffer = (struct mixed_buffer *)buffer;
       if(location < data->count) data->sources[location] = source;
       else return vector_add_pos(location, source, (struct vector *)data);
@@ -242,8 +248,10 @@ int space_mixer_set_in(uint32_t field, uint32_t location, void *buffer, struct m
         mixed_err(MIXED_INVALID_LOCATION);
         return 0;
       }
-      free(data->sources[location]);
-      data->sources[location] = 0;
+      // Keep the source around so that re-adding a voice at this
+      // location does not need to allocate again.
+      if(data->sources[location])
+        data->sources[location]->buffer = 0;
     }
     return 1;
   case MIXED_SPACE_LOCATION:
@@ -282,7 +290,7 @@ int space_mixer_get_in(uint32_t field, uint32_t location, void *buffer, struct m
   }
   
   struct space_source *source = data->sources[location];
-  if(source == 0){
+  if(source == 0 || source->buffer == 0){
     mixed_err(MIXED_INVALID_LOCATION);
     return 0;
   }
@@ -507,7 +515,7 @@ int space_mixer_info(struct mixed_segment_info *info, struct mixed_segment *segm
 }
 
 MIXED_EXPORT int mixed_make_segment_space_mixer(uint32_t samplerate, struct mixed_segment *segment){
-  struct space_mixer_data *data = calloc(1, sizeof(struct space_mixer_data));
+  struct space_mixer_data *data = mixed_calloc(1, sizeof(struct space_mixer_data));
   if(!data){
     mixed_err(MIXED_OUT_OF_MEMORY);
     return 0;
@@ -515,7 +523,7 @@ MIXED_EXPORT int mixed_make_segment_space_mixer(uint32_t samplerate, struct mixe
 
   // These factors might need tweaking for efficiency/quality.
   if(!make_pitch_data(2048, 4, samplerate, &data->pitch_data)){
-    free(data);
+    mixed_free(data);
     return 0;
   }
 
@@ -10,7 +10,7 @@ struct volume_control_segment_data{
 
 int volume_control_segment_free(struct mixed_segment *segment){
   if(segment->data)
-    free(segment->data);
+    mixed_free(segment->data);
   segment->data = 0;
   return 1;
 }
@@ -61,22 +61,16 @@ int volume_control_segment_mix(struct mixed_segment *segment){
   struct volume_control_segment_data *data = (struct volume_control_segment_data *)segment->data;
   float lvolume = data->volume * ((0.0<data->pan)?(1.0f-data->pan):1.0f);
   float rvolume = data->volume * ((data->pan<0.0)?(1.0f+data->pan):1.0f);
-  float *in, *out;
-  uint32_t samples;
+  struct mixed_buffer_group group = {data->in, 2, data->out, 2};
+  float *in[2], *out[2];
+  uint32_t samples = UINT32_MAX;
 
-  mixed_buffer_request_read(&in, &samples, data->in[MIXED_LEFT]);
-  mixed_buffer_request_write(&out, &samples, data->out[MIXED_LEFT]);
+  mixed_buffer_group_request(in, out, &samples, &group);
   for(uint32_t i=0; i<samples; ++i)
-    out[i] = in[i]*lvolume;
-  mixed_buffer_finish_read(samples, data->in[MIXED_LEFT]);
-  mixed_buffer_finish_write(samples, data->out[MIXED_LEFT]);
-  
-  mixed_buffer_request_read(&in, &samples, data->in[MIXED_RIGHT]);
-  mixed_buffer_request_write(&out, &samples, data->out[MIXED_RIGHT]);
+    out[MIXED_LEFT][i] = in[MIXED_LEFT][i]*lvolume;
   for(uint32_t i=0; i<samples; ++i)
-    out[i] = in[i]*rvolume;
-  mixed_buffer_finish_read(samples, data->in[MIXED_RIGHT]);
-  mixed_buffer_finish_write(samples, data->out[MIXED_RIGHT]);
+    out[MIXED_RIGHT][i] = in[MIXED_RIGHT][i]*rvolume;
+  mixed_buffer_group_finish(samples, &group);
   return 1;
 }
 
@@ -162,7 +156,7 @@ int volume_control_segment_set(uint32_t field, void *value, struct mixed_segment
 }
 
 MIXED_EXPORT int mixed_make_segment_volume_control(float volume, float pan, struct mixed_segment *segment){
-  struct volume_control_segment_data *data = calloc(1, sizeof(struct volume_control_segment_data));
+  struct volume_control_segment_data *data = mixed_calloc(1, sizeof(struct volume_control_segment_data));
   if(!data){
     mixed_err(MIXED_OUT_OF_MEMORY);
     return 0;
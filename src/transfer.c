@@ -1,5 +1,74 @@
 #include "internal.h"
 
+//// G.711 companding
+// The tables are filled in from the reference algorithms once on
+// load, after which coding a sample is a single lookup. Codes are
+// decoded to int16 first so that they scale like MIXED_INT16.
+float mulaw_decode_table[256];
+float alaw_decode_table[256];
+uint8_t mulaw_encode_table[1 << 14];
+uint8_t alaw_encode_table[1 << 13];
+
+static int16_t mulaw_to_linear(uint8_t code){
+  code = ~code;
+  int t = (((code & 0x0F) << 3) + 0x84) << ((code & 0x70) >> 4);
+  return (code & 0x80)? (0x84 - t) : (t - 0x84);
+}
+
+static int16_t alaw_to_linear(uint8_t code){
+  code ^= 0x55;
+  int t = (code & 0x0F) << 4;
+  uint8_t segment = (code & 0x70) >> 4;
+  switch(segment){
+  case 0: t += 8; break;
+  case 1: t += 0x108; break;
+  default: t = (t + 0x108) << (segment - 1); break;
+  }
+  return (code & 0x80)? t : -t;
+}
+
+// Takes 14 bit samples.
+static uint8_t linear_to_mulaw(int16_t sample){
+  uint8_t mask = 0xFF;
+  if(sample < 0){
+    sample = -sample;
+    mask = 0x7F;
+  }
+  if(8159 < sample) sample = 8159;
+  sample += 0x84 >> 2;
+  uint8_t segment = 0;
+  while(segment < 8 && ((0x40 << segment) - 1) < sample) ++segment;
+  if(8 <= segment) return 0x7F ^ mask;
+  return ((segment << 4) | ((sample >> (segment + 1)) & 0x0F)) ^ mask;
+}
+
+// Takes 13 bit samples.
+static uint8_t linear_to_alaw(int16_t sample){
+  uint8_t mask = 0xD5;
+  if(sample < 0){
+    sample = -sample - 1;
+    mask = 0x55;
+  }
+  uint8_t segment = 0;
+  while(segment < 8 && ((0x20 << segment) - 1) < sample) ++segment;
+  if(8 <= segment) return 0x7F ^ mask;
+  uint8_t code = segment << 4;
+  code |= (segment < 2)? (sample >> 1) & 0x0F : (sample >> segment) & 0x0F;
+  return code ^ mask;
+}
+
+static void init_g711_tables() __attribute__((constructor));
+static void init_g711_tables(){
+  for(int i=0; i<256; ++i){
+    mulaw_decode_table[i] = mixed_from_int16(mulaw_to_linear(i));
+    alaw_decode_table[i] = mixed_from_int16(alaw_to_linear(i));
+  }
+  for(int i=0; i<(1 << 14); ++i)
+    mulaw_encode_table[i] = linear_to_mulaw(i - (1 << 13));
+  for(int i=0; i<(1 << 13); ++i)
+    alaw_encode_table[i] = linear_to_alaw(i - (1 << 12));
+}
+
 //// Single sample transfer functions
 // We assume little endian for all formats.
 #define DEF_MIXED_TRANSFER_SAMPLE_FROM(name, datatype)                  \
@@ -16,27 +85,62 @@ DEF_MIXED_TRANSFER_SAMPLE_FROM(uint32, uint32_t)
 DEF_MIXED_TRANSFER_SAMPLE_FROM(float, float)
 DEF_MIXED_TRANSFER_SAMPLE_FROM(double, double)
 
+// Packed samples are assembled byte by byte and then sign extended
+// from the top of a 32 bit word.
+static inline uint32_t read_uint24(uint8_t *p){
+  return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16);
+}
+
+static inline uint32_t read_uint24_be(uint8_t *p){
+  return ((uint32_t)p[0] << 16) | (p[1] << 8) | p[2];
+}
+
+static inline int32_t sign_extend(uint32_t value, uint8_t bits){
+  return (int32_t)(value << (32-bits)) >> (32-bits);
+}
+
 extern inline void mixed_transfer_sample_from_int24(void *in, uint32_t is, float *out, uint32_t os, float volume) {
-  int8_t *data = (int8_t *)in;
-  // Read in as uint
-  uint32_t temp = (data[3*is] << 16) + (data[3*is+1] << 8) + (data[3*is+2]);
-  // Shift up to fill 32 bit range
-  temp = temp << 8;
-  // Convert to signed, this is actually not standards compliant.
-  int32_t sample = (int32_t)temp;
-  // Shift down again to get back to 24 bit range.
-  out[os] = mixed_from_int24(sample >> 8) * volume;
+  out[os] = mixed_from_int24(sign_extend(read_uint24((uint8_t *)in+3*is), 24)) * volume;
 }
 
 extern inline void mixed_transfer_sample_from_uint24(void *in, uint32_t is, float *out, uint32_t os, float volume) {
-  uint8_t *data = (uint8_t *)in;
-  uint24_t sample = (data[3*is] << 16) + (data[3*is+1] << 8) + (data[3*is+2]);
-  out[os] = mixed_from_uint24(sample) * volume;
+  out[os] = mixed_from_uint24(read_uint24((uint8_t *)in+3*is)) * volume;
+}
+
+static inline void mixed_transfer_sample_from_int16_be(void *in, uint32_t is, float *out, uint32_t os, float volume) {
+  uint8_t *p = (uint8_t *)in+2*is;
+  out[os] = mixed_from_int16((int16_t)((p[0] << 8) | p[1])) * volume;
+}
+
+static inline void mixed_transfer_sample_from_int24_be(void *in, uint32_t is, float *out, uint32_t os, float volume) {
+  out[os] = mixed_from_int24(sign_extend(read_uint24_be((uint8_t *)in+3*is), 24)) * volume;
+}
+
+static inline void mixed_transfer_sample_from_int32_be(void *in, uint32_t is, float *out, uint32_t os, float volume) {
+  uint8_t *p = (uint8_t *)in+4*is;
+  uint32_t sample = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | (p[2] << 8) | p[3];
+  out[os] = mixed_from_int32((int32_t)sample) * volume;
+}
+
+static inline void mixed_transfer_sample_from_int24_32(void *in, uint32_t is, float *out, uint32_t os, float volume) {
+  out[os] = mixed_from_int24(sign_extend(((uint32_t *)in)[is], 24)) * volume;
+}
+
+static inline void mixed_transfer_sample_from_int20(void *in, uint32_t is, float *out, uint32_t os, float volume) {
+  out[os] = mixed_from_int20(sign_extend(read_uint24((uint8_t *)in+3*is), 20)) * volume;
+}
+
+static inline void mixed_transfer_sample_from_mulaw(void *in, uint32_t is, float *out, uint32_t os, float volume) {
+  out[os] = mulaw_decode_table[((uint8_t *)in)[is]] * volume;
+}
+
+static inline void mixed_transfer_sample_from_alaw(void *in, uint32_t is, float *out, uint32_t os, float volume) {
+  out[os] = alaw_decode_table[((uint8_t *)in)[is]] * volume;
 }
 
 #define DEF_MIXED_TRANSFER_SAMPLE_TO(name, datatype)                    \
   static inline void mixed_transfer_sample_to_##name(float *in, uint32_t is, void *out, uint32_t os, float volume){ \
-    ((datatype *)out)[os] = mixed_to_##name(in[is]) * volume;           \
+    ((datatype *)out)[os] = mixed_to_##name(in[is] * volume);           \
   }
 
 DEF_MIXED_TRANSFER_SAMPLE_TO(int8, int8_t)
@@ -48,46 +152,101 @@ DEF_MIXED_TRANSFER_SAMPLE_TO(uint32, uint32_t)
 DEF_MIXED_TRANSFER_SAMPLE_TO(float, float)
 DEF_MIXED_TRANSFER_SAMPLE_TO(double, double)
 
+static inline void write_uint24(uint8_t *p, uint32_t sample){
+  p[0] = (sample >>  0) & 0xFF;
+  p[1] = (sample >>  8) & 0xFF;
+  p[2] = (sample >> 16) & 0xFF;
+}
+
+static inline void write_uint24_be(uint8_t *p, uint32_t sample){
+  p[0] = (sample >> 16) & 0xFF;
+  p[1] = (sample >>  8) & 0xFF;
+  p[2] = (sample >>  0) & 0xFF;
+}
+
 extern inline void mixed_transfer_sample_to_int24(float *in, uint32_t is, void *out, uint32_t os, float volume){
-  int24_t sample = mixed_to_int24(in[is] * volume);
-  ((uint8_t *)out)[os+2] = (sample >> 16) & 0xFF;
-  ((uint8_t *)out)[os+1] = (sample >>  8) & 0xFF;
-  ((uint8_t *)out)[os+0] = (sample >>  0) & 0xFF;
+  write_uint24((uint8_t *)out+3*os, mixed_to_int24(in[is] * volume));
 }
 
 extern inline void mixed_transfer_sample_to_uint24(float *in, uint32_t is, void *out, uint32_t os, float volume){
-  uint24_t sample = mixed_to_uint24(in[is] * volume);
-  ((uint8_t *)out)[os+2] = (sample >> 16) & 0xFF;
-  ((uint8_t *)out)[os+1] = (sample >>  8) & 0xFF;
-  ((uint8_t *)out)[os+0] = (sample >>  0) & 0xFF;
+  write_uint24((uint8_t *)out+3*os, mixed_to_uint24(in[is] * volume));
+}
+
+static inline void mixed_transfer_sample_to_int16_be(float *in, uint32_t is, void *out, uint32_t os, float volume){
+  uint8_t *p = (uint8_t *)out+2*os;
+  int16_t sample = mixed_to_int16(in[is] * volume);
+  p[0] = (sample >> 8) & 0xFF;
+  p[1] = (sample >> 0) & 0xFF;
+}
+
+static inline void mixed_transfer_sample_to_int24_be(float *in, uint32_t is, void *out, uint32_t os, float volume){
+  write_uint24_be((uint8_t *)out+3*os, mixed_to_int24(in[is] * volume));
+}
+
+static inline void mixed_transfer_sample_to_int32_be(float *in, uint32_t is, void *out, uint32_t os, float volume){
+  uint8_t *p = (uint8_t *)out+4*os;
+  uint32_t sample = (uint32_t)mixed_to_int32(in[is] * volume);
+  p[0] = (sample >> 24) & 0xFF;
+  p[1] = (sample >> 16) & 0xFF;
+  p[2] = (sample >>  8) & 0xFF;
+  p[3] = (sample >>  0) & 0xFF;
+}
+
+static inline void mixed_transfer_sample_to_int24_32(float *in, uint32_t is, void *out, uint32_t os, float volume){
+  ((int32_t *)out)[os] = mixed_to_int24(in[is] * volume);
+}
+
+static inline void mixed_transfer_sample_to_int20(float *in, uint32_t is, void *out, uint32_t os, float volume){
+  write_uint24((uint8_t *)out+3*os, mixed_to_int20(in[is] * volume));
+}
+
+static inline void mixed_transfer_sample_to_mulaw(float *in, uint32_t is, void *out, uint32_t os, float volume){
+  ((uint8_t *)out)[os] = mulaw_encode(mixed_to_int16(in[is] * volume));
+}
+
+static inline void mixed_transfer_sample_to_alaw(float *in, uint32_t is, void *out, uint32_t os, float volume){
+  ((uint8_t *)out)[os] = alaw_encode(mixed_to_int16(in[is] * volume));
 }
 
 //// Array transfer functions
+// Volume changes are applied as a linear ramp of VOLUME_RAMP_STEP per
+// frame towards the target. The gain only depends on the frame index,
+// so every channel sees the same gain and the loops stay free of
+// dependencies between samples.
+#define VOLUME_RAMP_STEP (1.0f/1024.0f)
+
+// The number of frames before the ramp reaches the target volume.
+static inline uint32_t ramp_frames(float volume, float target_volume){
+  float frames = ceilf(fabsf(target_volume - volume) / VOLUME_RAMP_STEP);
+  return (frames < 1.0f)? 0 : (uint32_t)frames - 1;
+}
+
+float ramp_volume(float volume, float target_volume, uint32_t frames){
+  float step = (volume < target_volume)? VOLUME_RAMP_STEP : -VOLUME_RAMP_STEP;
+  uint32_t ramp = MIN(frames, ramp_frames(volume, target_volume));
+  return (ramp < frames)? target_volume : volume+step*ramp;
+}
+
 #define DEF_MIXED_TRANSFER_ARRAY_FROM_ALTERNATING(datatype)             \
   VECTORIZE float mixed_transfer_array_from_alternating_##datatype(void *in, float *out, uint8_t stride, uint32_t samples, float volume, float target_volume) { \
-    if(samples == 0) return volume;                                     \
-    mixed_transfer_sample_from_##datatype(in, 0, out, 0, volume);       \
-    for(uint32_t sample=1; sample<samples; ++sample){                   \
-      mixed_transfer_sample_from_##datatype(in, sample*stride, out, sample, volume); \
-      if(out[sample-1] * out[sample] < 0.0f) {                          \
-        volume = target_volume;                                         \
-        mixed_transfer_sample_from_##datatype(in, sample*stride, out, sample, volume); \
-      }                                                                 \
-    }                                                                   \
-    return volume;                                                      \
+    float step = (volume < target_volume)? VOLUME_RAMP_STEP : -VOLUME_RAMP_STEP; \
+    uint32_t ramp = MIN(samples, ramp_frames(volume, target_volume));   \
+    for(uint32_t sample=0; sample<ramp; ++sample)                       \
+      mixed_transfer_sample_from_##datatype(in, sample*stride, out, sample, volume+step*(sample+1)); \
+    for(uint32_t sample=ramp; sample<samples; ++sample)                 \
+      mixed_transfer_sample_from_##datatype(in, sample*stride, out, sample, target_volume); \
+    return (ramp < samples)? target_volume : volume+step*ramp;          \
   }
 
 #define DEF_MIXED_TRANSFER_ARRAY_TO_ALTERNATING(datatype)               \
   VECTORIZE static inline float mixed_transfer_array_to_alternating_##datatype(float *in, void *out, uint8_t stride, uint32_t samples, float volume, float target_volume){ \
-    if(samples == 0) return volume;                                     \
-    mixed_transfer_sample_to_##datatype(in, 0, out, 0, volume);         \
-    for(uint32_t sample=1; sample<samples; ++sample){                   \
-      if(in[sample-1] * in[sample] < 0.0f){                             \
-        volume = target_volume;                                         \
-      }                                                                 \
-      mixed_transfer_sample_to_##datatype(in, sample, out, sample*stride, volume); \
-    }                                                                   \
-    return volume;                                                      \
+    float step = (volume < target_volume)? VOLUME_RAMP_STEP : -VOLUME_RAMP_STEP; \
+    uint32_t ramp = MIN(samples, ramp_frames(volume, target_volume));   \
+    for(uint32_t sample=0; sample<ramp; ++sample)                       \
+      mixed_transfer_sample_to_##datatype(in, sample, out, sample*stride, volume+step*(sample+1)); \
+    for(uint32_t sample=ramp; sample<samples; ++sample)                 \
+      mixed_transfer_sample_to_##datatype(in, sample, out, sample*stride, target_volume); \
+    return (ramp < samples)? target_volume : volume+step*ramp;          \
   }
 
 DEF_MIXED_TRANSFER_ARRAY_FROM_ALTERNATING(int8)
@@ -100,6 +259,13 @@ DEF_MIXED_TRANSFER_ARRAY_FROM_ALTERNATING(int32)
 DEF_MIXED_TRANSFER_ARRAY_FROM_ALTERNATING(uint32)
 DEF_MIXED_TRANSFER_ARRAY_FROM_ALTERNATING(float)
 DEF_MIXED_TRANSFER_ARRAY_FROM_ALTERNATING(double)
+DEF_MIXED_TRANSFER_ARRAY_FROM_ALTERNATING(int16_be)
+DEF_MIXED_TRANSFER_ARRAY_FROM_ALTERNATING(int24_be)
+DEF_MIXED_TRANSFER_ARRAY_FROM_ALTERNATING(int32_be)
+DEF_MIXED_TRANSFER_ARRAY_FROM_ALTERNATING(int24_32)
+DEF_MIXED_TRANSFER_ARRAY_FROM_ALTERNATING(int20)
+DEF_MIXED_TRANSFER_ARRAY_FROM_ALTERNATING(mulaw)
+DEF_MIXED_TRANSFER_ARRAY_FROM_ALTERNATING(alaw)
 DEF_MIXED_TRANSFER_ARRAY_TO_ALTERNATING(int8)
 DEF_MIXED_TRANSFER_ARRAY_TO_ALTERNATING(uint8)
 DEF_MIXED_TRANSFER_ARRAY_TO_ALTERNATING(int16)
@@ -110,100 +276,405 @@ DEF_MIXED_TRANSFER_ARRAY_TO_ALTERNATING(int32)
 DEF_MIXED_TRANSFER_ARRAY_TO_ALTERNATING(uint32)
 DEF_MIXED_TRANSFER_ARRAY_TO_ALTERNATING(float)
 DEF_MIXED_TRANSFER_ARRAY_TO_ALTERNATING(double)
+DEF_MIXED_TRANSFER_ARRAY_TO_ALTERNATING(int16_be)
+DEF_MIXED_TRANSFER_ARRAY_TO_ALTERNATING(int24_be)
+DEF_MIXED_TRANSFER_ARRAY_TO_ALTERNATING(int32_be)
+DEF_MIXED_TRANSFER_ARRAY_TO_ALTERNATING(int24_32)
+DEF_MIXED_TRANSFER_ARRAY_TO_ALTERNATING(int20)
+DEF_MIXED_TRANSFER_ARRAY_TO_ALTERNATING(mulaw)
+DEF_MIXED_TRANSFER_ARRAY_TO_ALTERNATING(alaw)
 
 //// Buffer transfer functions
-static mixed_transfer_function_from transfer_array_functions_from[20] =
-  { mixed_transfer_array_from_alternating_int8,
-    mixed_transfer_array_from_alternating_uint8,
-    mixed_transfer_array_from_alternating_int16,
-    mixed_transfer_array_from_alternating_uint16,
-    mixed_transfer_array_from_alternating_int24,
-    mixed_transfer_array_from_alternating_uint24,
-    mixed_transfer_array_from_alternating_int32,
-    mixed_transfer_array_from_alternating_uint32,
-    mixed_transfer_array_from_alternating_float,
-    mixed_transfer_array_from_alternating_double,
+// Indexed by the encoding directly, as the encodings are not contiguous.
+static mixed_transfer_function_from transfer_array_functions_from[MIXED_ALAW+1] =
+  { [MIXED_INT8] = mixed_transfer_array_from_alternating_int8,
+    [MIXED_UINT8] = mixed_transfer_array_from_alternating_uint8,
+    [MIXED_INT16] = mixed_transfer_array_from_alternating_int16,
+    [MIXED_UINT16] = mixed_transfer_array_from_alternating_uint16,
+    [MIXED_INT24] = mixed_transfer_array_from_alternating_int24,
+    [MIXED_UINT24] = mixed_transfer_array_from_alternating_uint24,
+    [MIXED_INT32] = mixed_transfer_array_from_alternating_int32,
+    [MIXED_UINT32] = mixed_transfer_array_from_alternating_uint32,
+    [MIXED_FLOAT] = mixed_transfer_array_from_alternating_float,
+    [MIXED_DOUBLE] = mixed_transfer_array_from_alternating_double,
+    [MIXED_INT16_BE] = mixed_transfer_array_from_alternating_int16_be,
+    [MIXED_INT24_BE] = mixed_transfer_array_from_alternating_int24_be,
+    [MIXED_INT32_BE] = mixed_transfer_array_from_alternating_int32_be,
+    [MIXED_INT24_32] = mixed_transfer_array_from_alternating_int24_32,
+    [MIXED_INT20] = mixed_transfer_array_from_alternating_int20,
+    [MIXED_MULAW] = mixed_transfer_array_from_alternating_mulaw,
+    [MIXED_ALAW] = mixed_transfer_array_from_alternating_alaw,
   };
 
 MIXED_EXPORT mixed_transfer_function_from mixed_translator_from(enum mixed_encoding encoding){
-  return transfer_array_functions_from[encoding-1];
+  if(encoding < MIXED_INT8 || MIXED_ALAW < encoding)
+    return 0;
+  return transfer_array_functions_from[encoding];
 }
 
-VECTORIZE MIXED_EXPORT int mixed_buffer_from_pack(struct mixed_pack *in, struct mixed_buffer **outs, float *volume, float target_volume){
-  channel_t channels = in->channels;
-  uint32_t frames_to_bytes = channels * mixed_samplesize(in->encoding);
+// Deinterleave frames of packed data into separate float arrays.
+static VECTORIZE void deinterleave_frames(char *in, enum mixed_encoding encoding, channel_t channels, channel_t *map, channel_t count, float **outs, uint32_t frames, float *volume, float target_volume){
+  if(frames == 0) return;
+  mixed_transfer_function_from fun = transfer_array_functions_from[encoding];
+  uint8_t size = mixed_samplesize(encoding);
+  uint32_t frames_to_bytes = channels * size;
+  // Selected channels are picked out one by one, which the strided
+  // translators handle well enough and which skips the others.
+  if(map){
+    float vol = *volume;
+    for(channel_t c=0; c<count; ++c)
+      *volume = fun(in+map[c]*size, outs[c], channels, frames, vol, target_volume);
+    return;
+  }
+  uint32_t ramp = MIN(frames, ramp_frames(*volume, target_volume));
+  uint32_t done = 0;
+  // Once the ramp is through, all channels can be converted at
+  // once with a vectorised kernel.
+  if(ramp < frames){
+    mixed_deinterleave_function kernel = deinterleave_kernel(encoding, channels);
+    if(kernel){
+      float *areas[channels];
+      for(channel_t c=0; c<channels; ++c)
+        areas[c] = outs[c]+ramp;
+      done = kernel(in+ramp*frames_to_bytes, areas, channels, frames-ramp, target_volume);
+    }
+  }
+  float vol = *volume;
+  char *rest = in+(ramp+done)*frames_to_bytes;
+  for(channel_t c=0; c<channels; ++c){
+    *volume = fun(in+c*size, outs[c], channels, ramp, vol, target_volume);
+    fun(rest+c*size, outs[c]+ramp+done, channels, frames-ramp-done, target_volume, target_volume);
+  }
+  if(ramp < frames) *volume = target_volume;
+}
+
+// Planar packs keep every channel in its own plane, which the
+// translators read with a stride of one.
+void unpack_frames(struct mixed_pack *pack, char *in, channel_t *map, channel_t count, float **outs, uint32_t frames, float *volume, float target_volume){
+  if(!(pack->flags & MIXED_PACK_PLANAR)){
+    deinterleave_frames(in, pack->encoding, pack->channels, map, count, outs, frames, volume, target_volume);
+    return;
+  }
+  if(frames == 0) return;
+  mixed_transfer_function_from fun = transfer_array_functions_from[pack->encoding];
+  float vol = *volume;
+  for(channel_t c=0; c<count; ++c){
+    channel_t channel = map? map[c] : c;
+    *volume = fun(in+(size_t)channel*pack->size, outs[c], 1, frames, vol, target_volume);
+  }
+}
+
+int buffer_from_pack(struct mixed_pack *in, struct mixed_buffer **outs, channel_t *map, channel_t count, float *volume, float target_volume){
+  uint32_t frames_to_bytes = pack_unit_bytes(in);
   uint32_t frames = UINT32_MAX;
   char *ind;
-  float *outd[channels];
+  float *outd[count];
 
-  mixed_pack_request_read((void**)&ind, &frames, in);
-  frames = frames / frames_to_bytes;
-  for(uint32_t i=0; i<channels; ++i)
-    mixed_buffer_request_write(&outd[i], &frames, outs[i]);
+  struct mixed_buffer_group group = {0, 0, outs, count};
 
-  if(0 < frames){
-    mixed_transfer_function_from fun = transfer_array_functions_from[in->encoding-1];
-    uint8_t size = mixed_samplesize(in->encoding);
-    float vol = *volume;
-    // KLUDGE: this is not necessarily correct...
-    *volume = target_volume;
-    for(int8_t c=0; c<channels; ++c){
-      fun(ind, outd[c], channels, frames, vol, target_volume);
-      ind += size;
-    }
+  if(!mixed_translator_from(in->encoding)){
+    mixed_err(MIXED_UNKNOWN_ENCODING);
+    return 0;
   }
 
+  mixed_pack_request_read((void**)&ind, &frames, in);
+  frames = frames / frames_to_bytes;
+  mixed_buffer_group_request(0, outd, &frames, &group);
+  unpack_frames(in, ind, map, count, outd, frames, volume, target_volume);
   mixed_pack_finish_read(frames * frames_to_bytes, in);
-  for(uint32_t i=0; i<channels; ++i)
-    mixed_buffer_finish_write(frames, outs[i]);
+  mixed_buffer_group_finish(frames, &group);
   
   return 1;
 }
 
-static mixed_transfer_function_to transfer_array_functions_to[20] =
-  { mixed_transfer_array_to_alternating_int8,
-    mixed_transfer_array_to_alternating_uint8,
-    mixed_transfer_array_to_alternating_int16,
-    mixed_transfer_array_to_alternating_uint16,
-    mixed_transfer_array_to_alternating_int24,
-    mixed_transfer_array_to_alternating_uint24,
-    mixed_transfer_array_to_alternating_int32,
-    mixed_transfer_array_to_alternating_uint32,
-    mixed_transfer_array_to_alternating_float,
-    mixed_transfer_array_to_alternating_double,
+MIXED_EXPORT int mixed_buffer_from_pack(struct mixed_pack *in, struct mixed_buffer **outs, float *volume, float target_volume){
+  return buffer_from_pack(in, outs, 0, in->channels, volume, target_volume);
+}
+
+static mixed_transfer_function_to transfer_array_functions_to[MIXED_ALAW+1] =
+  { [MIXED_INT8] = mixed_transfer_array_to_alternating_int8,
+    [MIXED_UINT8] = mixed_transfer_array_to_alternating_uint8,
+    [MIXED_INT16] = mixed_transfer_array_to_alternating_int16,
+    [MIXED_UINT16] = mixed_transfer_array_to_alternating_uint16,
+    [MIXED_INT24] = mixed_transfer_array_to_alternating_int24,
+    [MIXED_UINT24] = mixed_transfer_array_to_alternating_uint24,
+    [MIXED_INT32] = mixed_transfer_array_to_alternating_int32,
+    [MIXED_UINT32] = mixed_transfer_array_to_alternating_uint32,
+    [MIXED_FLOAT] = mixed_transfer_array_to_alternating_float,
+    [MIXED_DOUBLE] = mixed_transfer_array_to_alternating_double,
+    [MIXED_INT16_BE] = mixed_transfer_array_to_alternating_int16_be,
+    [MIXED_INT24_BE] = mixed_transfer_array_to_alternating_int24_be,
+    [MIXED_INT32_BE] = mixed_transfer_array_to_alternating_int32_be,
+    [MIXED_INT24_32] = mixed_transfer_array_to_alternating_int24_32,
+    [MIXED_INT20] = mixed_transfer_array_to_alternating_int20,
+    [MIXED_MULAW] = mixed_transfer_array_to_alternating_mulaw,
+    [MIXED_ALAW] = mixed_transfer_array_to_alternating_alaw,
   };
 
 MIXED_EXPORT mixed_transfer_function_to mixed_translator_to(enum mixed_encoding encoding){
-  return transfer_array_functions_to[encoding-1];
+  if(encoding < MIXED_INT8 || MIXED_ALAW < encoding)
+    return 0;
+  return transfer_array_functions_to[encoding];
+}
+
+//// Dithered transfer
+void dither_seed(struct dither_channel *channel, uint32_t seed){
+  // Scramble the seed per lane so that the lanes do not produce
+  // shifted copies of the same sequence. Xorshift never leaves zero,
+  // so that state must be avoided.
+  for(uint32_t l=0; l<DITHER_LANES; ++l){
+    uint32_t x = seed*DITHER_LANES + l + 0x9E3779B9u;
+    x = (x ^ (x >> 16)) * 0x85EBCA6Bu;
+    x = (x ^ (x >> 13)) * 0xC2B2AE35u;
+    x ^= x >> 16;
+    channel->rng[l] = x? x : 1;
+  }
+  channel->error = 0.0f;
 }
 
-VECTORIZE MIXED_EXPORT int mixed_buffer_to_pack(struct mixed_buffer **ins, struct mixed_pack *out, float *volume, float target_volume){
-  channel_t channels = out->channels;
-  uint32_t frames_to_bytes = channels * mixed_samplesize(out->encoding);
+// The integer layout of the encodings that are worth dithering.
+// Wider encodings already resolve below the float precision.
+static int dither_layout(enum mixed_encoding encoding, uint8_t *bits, int32_t *offset, bool *big_endian){
+  *offset = 0;
+  *big_endian = false;
+  switch(encoding){
+  case MIXED_INT8: *bits = 8; break;
+  case MIXED_UINT8: *bits = 8; *offset = 0x80; break;
+  case MIXED_INT16: *bits = 16; break;
+  case MIXED_UINT16: *bits = 16; *offset = 0x8000; break;
+  case MIXED_INT24: *bits = 24; break;
+  case MIXED_UINT24: *bits = 24; *offset = 0x800000; break;
+  case MIXED_INT16_BE: *bits = 16; *big_endian = true; break;
+  case MIXED_INT24_BE: *bits = 24; *big_endian = true; break;
+  case MIXED_INT24_32: *bits = 24; break;
+  case MIXED_INT20: *bits = 20; break;
+  default: return 0;
+  }
+  return 1;
+}
+
+int dither_applies(enum mixed_encoding encoding){
+  uint8_t bits;
+  int32_t offset;
+  bool big_endian;
+  return dither_layout(encoding, &bits, &offset, &big_endian);
+}
+
+// Triangular noise in (-1, +1) from the difference of two uniform
+// draws, in the same way as the vectorised kernels compute it.
+static inline float dither_noise(uint32_t *rng){
+  uint32_t a = dither_xorshift(*rng);
+  uint32_t b = dither_xorshift(a);
+  *rng = b;
+  return ((float)(a >> 8) - (float)(b >> 8)) * (1.0f/16777216.0f);
+}
+
+// The encoding must be one for which dither_applies. Noise shaping
+// feeds each sample's error into the next, so it cannot be split
+// across vector lanes and is only done here.
+float dither_array_to(float *in, uint32_t in_stride, void *out, uint32_t out_stride, uint32_t samples, float volume, float target_volume, enum mixed_encoding encoding, enum mixed_dither_type type, struct dither_channel *state){
+  uint8_t size = mixed_samplesize(encoding);
+  uint8_t bits;
+  int32_t offset;
+  bool big_endian;
+  dither_layout(encoding, &bits, &offset, &big_endian);
+  float scale = (float)(1 << (bits-1));
+  float max = scale - 1.0f;
+  float step = (volume < target_volume)? VOLUME_RAMP_STEP : -VOLUME_RAMP_STEP;
+  uint32_t ramp = MIN(samples, ramp_frames(volume, target_volume));
+  uint32_t rng = state->rng[0];
+  float error = state->error;
+  uint8_t *data = (uint8_t *)out;
+  for(uint32_t i=0; i<samples; ++i){
+    float gain = (i < ramp)? volume+step*(i+1) : target_volume;
+    float v = in[i*in_stride] * gain * scale;
+    if(type == MIXED_SHAPED_DITHER) v -= error;
+    float q = nearbyintf(v + dither_noise(&rng));
+    // Written so that NaN ends up at the bottom like in encoding.h
+    q = (max < q)? max : (-scale <= q)? q : -scale;
+    // Clipped samples would otherwise feed back an unbounded error.
+    if(type == MIXED_SHAPED_DITHER) error = fminf(fmaxf(q - v, -2.0f), 2.0f);
+    int32_t sample = (int32_t)q + offset;
+    uint8_t *p = data + (size_t)i*out_stride*size;
+    for(uint8_t b=0; b<size; ++b)
+      p[big_endian? size-1-b : b] = (sample >> (8*b)) & 0xFF;
+  }
+  state->rng[0] = rng;
+  state->error = error;
+  return (ramp < samples)? target_volume : volume+step*ramp;
+}
+
+// Encode silence into a channel of packed data.
+static void silence_channel(char *out, enum mixed_encoding encoding, channel_t channels, uint32_t frames){
+  static float zeros[256] = {0};
+  mixed_transfer_function_to fun = transfer_array_functions_to[encoding];
+  uint32_t frames_to_bytes = channels * mixed_samplesize(encoding);
+  for(uint32_t i=0; i<frames; i+=256)
+    fun(zeros, out+i*frames_to_bytes, channels, MIN(256, frames-i), 1.0, 1.0);
+}
+
+// Interleave frames from separate float arrays into packed data.
+static VECTORIZE void interleave_frames(float **ins, char *out, enum mixed_encoding encoding, channel_t channels, channel_t *map, channel_t count, uint32_t frames, float *volume, float target_volume, enum mixed_dither_type dither, struct dither_channel *state){
+  if(frames == 0) return;
+  mixed_transfer_function_to fun = transfer_array_functions_to[encoding];
+  uint8_t size = mixed_samplesize(encoding);
+  uint32_t frames_to_bytes = channels * size;
+  // Pack channels that are not selected are filled with silence.
+  if(map){
+    bool used[channels];
+    memset(used, 0, sizeof(used));
+    float vol = *volume;
+    for(channel_t c=0; c<count; ++c){
+      if(dither == MIXED_NO_DITHER)
+        *volume = fun(ins[c], out+map[c]*size, channels, frames, vol, target_volume);
+      else
+        *volume = dither_array_to(ins[c], 1, out+map[c]*size, channels, frames, vol, target_volume, encoding, dither, &state[c]);
+      used[map[c]] = true;
+    }
+    for(channel_t c=0; c<channels; ++c){
+      if(!used[c]) silence_channel(out+c*size, encoding, channels, frames);
+    }
+    return;
+  }
+  uint32_t ramp = MIN(frames, ramp_frames(*volume, target_volume));
+  uint32_t done = 0;
+  if(ramp < frames){
+    float *areas[channels];
+    for(channel_t c=0; c<channels; ++c)
+      areas[c] = ins[c]+ramp;
+    if(dither == MIXED_NO_DITHER){
+      mixed_interleave_function kernel = interleave_kernel(encoding, channels);
+      if(kernel)
+        done = kernel(areas, out+ramp*frames_to_bytes, channels, frames-ramp, target_volume);
+    }else if(dither == MIXED_TPDF_DITHER){
+      mixed_dither_interleave_function kernel = dither_interleave_kernel(encoding, channels);
+      if(kernel)
+        done = kernel(areas, out+ramp*frames_to_bytes, frames-ramp, target_volume, state);
+    }
+  }
+  float vol = *volume;
+  char *rest = out+(ramp+done)*frames_to_bytes;
+  for(channel_t c=0; c<channels; ++c){
+    if(dither == MIXED_NO_DITHER){
+      *volume = fun(ins[c], out+c*size, channels, ramp, vol, target_volume);
+      fun(ins[c]+ramp+done, rest+c*size, channels, frames-ramp-done, target_volume, target_volume);
+    }else{
+      *volume = dither_array_to(ins[c], 1, out+c*size, channels, ramp, vol, target_volume, encoding, dither, &state[c]);
+      dither_array_to(ins[c]+ramp+done, 1, rest+c*size, channels, frames-ramp-done, target_volume, target_volume, encoding, dither, &state[c]);
+    }
+  }
+  if(ramp < frames) *volume = target_volume;
+}
+
+void pack_frames(float **ins, struct mixed_pack *pack, char *out, channel_t *map, channel_t count, uint32_t frames, float *volume, float target_volume, enum mixed_dither_type dither, struct dither_channel *state){
+  if(!(pack->flags & MIXED_PACK_PLANAR)){
+    interleave_frames(ins, out, pack->encoding, pack->channels, map, count, frames, volume, target_volume, dither, state);
+    return;
+  }
+  if(frames == 0) return;
+  mixed_transfer_function_to fun = transfer_array_functions_to[pack->encoding];
+  bool used[pack->channels];
+  memset(used, 0, sizeof(used));
+  float vol = *volume;
+  for(channel_t c=0; c<count; ++c){
+    channel_t channel = map? map[c] : c;
+    char *plane = out+(size_t)channel*pack->size;
+    if(dither == MIXED_NO_DITHER)
+      *volume = fun(ins[c], plane, 1, frames, vol, target_volume);
+    else
+      *volume = dither_array_to(ins[c], 1, plane, 1, frames, vol, target_volume, pack->encoding, dither, &state[c]);
+    used[channel] = true;
+  }
+  for(channel_t c=0; c<pack->channels; ++c){
+    if(!used[c]) silence_channel(out+(size_t)c*pack->size, pack->encoding, 1, frames);
+  }
+}
+
+int buffer_to_pack(struct mixed_buffer **ins, struct mixed_pack *out, channel_t *map, channel_t count, float *volume, float target_volume, enum mixed_dither_type dither, struct dither_channel *state){
+  uint32_t frames_to_bytes = pack_unit_bytes(out);
   uint32_t frames = UINT32_MAX;
   char *outd;
-  float *ind[channels];
+  float *ind[count];
+
+  struct mixed_buffer_group group = {ins, count, 0, 0};
+
+  if(!mixed_translator_to(out->encoding)){
+    mixed_err(MIXED_UNKNOWN_ENCODING);
+    return 0;
+  }
+
+  if(!dither_applies(out->encoding))
+    dither = MIXED_NO_DITHER;
 
   mixed_pack_request_write((void**)&outd, &frames, out);
   frames = frames / frames_to_bytes;
-  for(uint32_t i=0; i<channels; ++i)
-    mixed_buffer_request_read(&ind[i], &frames, ins[i]);
+  mixed_buffer_group_request(ind, 0, &frames, &group);
+  pack_frames(ind, out, outd, map, count, frames, volume, target_volume, dither, state);
+  mixed_pack_finish_write(frames * frames_to_bytes, out);
+  mixed_buffer_group_finish(frames, &group);
+  
+  return 1;
+}
+
+// Number of floats staged at once by mixed_pack_convert. This is kept
+// small so that the staged samples never leave the cache.
+#define CONVERT_SAMPLES 4096
+
+int pack_convert(struct mixed_pack *in, struct mixed_pack *out, channel_t *map, channel_t count, float *volume, float target_volume){
+  channel_t in_channels = in->channels;
+  channel_t out_channels = out->channels;
+  uint32_t in_frame = pack_unit_bytes(in);
+  uint32_t out_frame = pack_unit_bytes(out);
+  uint32_t in_bytes = UINT32_MAX, out_bytes = UINT32_MAX;
+  char *ind = 0, *outd = 0;
+
+  if(!mixed_translator_from(in->encoding) || !mixed_translator_to(out->encoding)){
+    mixed_err(MIXED_UNKNOWN_ENCODING);
+    return 0;
+  }
+  if(in->samplerate != out->samplerate){
+    mixed_err(MIXED_BAD_RESAMPLE_FACTOR);
+    return 0;
+  }
+
+  mixed_pack_request_read((void**)&ind, &in_bytes, in);
+  mixed_pack_request_write((void**)&outd, &out_bytes, out);
+  uint32_t frames = MIN(in_bytes / in_frame, out_bytes / out_frame);
 
   if(0 < frames){
-    mixed_transfer_function_to fun = transfer_array_functions_to[out->encoding-1];
-    uint8_t size = mixed_samplesize(out->encoding);
-    float vol = *volume;
-    // KLUDGE: this is not necessarily correct...
-    *volume = target_volume;
-    for(int8_t c=0; c<channels; ++c){
-      fun(ind[c], outd, channels, frames, vol, target_volume);
-      outd += size;
+    // Each chunk is decoded into one plane per input channel and
+    // re-encoded straight away. The last plane stays silent for
+    // output channels that have no input to draw from.
+    float scratch[CONVERT_SAMPLES];
+    uint32_t chunk = CONVERT_SAMPLES / (in_channels+1);
+    float *planes[in_channels+1];
+    float *sources[out_channels];
+    float unit = 1.0;
+    for(channel_t c=0; c<=in_channels; ++c)
+      planes[c] = scratch + c*chunk;
+    memset(planes[in_channels], 0, chunk*sizeof(float));
+    for(channel_t c=0; c<out_channels; ++c){
+      if(map)
+        sources[c] = (c < count)? planes[map[c]] : planes[in_channels];
+      else
+        sources[c] = (c < in_channels)? planes[c] : planes[(in_channels == 1)? 0 : in_channels];
+    }
+    for(uint32_t i=0; i<frames; i+=chunk){
+      uint32_t todo = MIN(chunk, frames-i);
+      unpack_frames(in, ind+i*in_frame, 0, in_channels, planes, todo, volume, target_volume);
+      pack_frames(sources, out, outd+i*out_frame, 0, out_channels, todo, &unit, 1.0, MIXED_NO_DITHER, 0);
     }
   }
 
-  mixed_pack_finish_write(frames * frames_to_bytes, out);
-  for(uint32_t i=0; i<channels; ++i)
-    mixed_buffer_finish_read(frames, ins[i]);
-  
+  mixed_pack_finish_read(frames * in_frame, in);
+  mixed_pack_finish_write(frames * out_frame, out);
   return 1;
 }
+
+MIXED_EXPORT int mixed_pack_convert(struct mixed_pack *in, struct mixed_pack *out, float *volume, float target_volume){
+  return pack_convert(in, out, 0, 0, volume, target_volume);
+}
+
+MIXED_EXPORT int mixed_buffer_to_pack(struct mixed_buffer **ins, struct mixed_pack *out, float *volume, float target_volume){
+  return buffer_to_pack(ins, out, 0, out->channels, volume, target_volume, MIXED_NO_DITHER, 0);
+}
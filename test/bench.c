@@ -0,0 +1,236 @@
+// Cross-thread pack throughput benchmark.
+//
+// Simulates a decoder thread feeding PCM into a pack that is drained
+// by an audio thread, and reports the achieved throughput.
+//
+// Next to the library's packs, the ring protocol of mirrored packs is
+// also run over plain memory twice: once with the sequentially
+// consistent ordering and fresh pointer loads the buffers used to
+// have, and once with the acquire/release ordering and cached
+// pointers they use now. This isolates the effect of the ordering.
+//
+//   bench [pack-bytes] [chunk-bytes] [total-megabytes]
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include "../src/mixed.h"
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+struct ring{
+  unsigned char *data;
+  uint32_t size;
+  char _pad0[64];
+  uint32_t read;
+  uint32_t write_cache;
+  char _pad1[64];
+  uint32_t write;
+  uint32_t read_cache;
+  char _pad2[64];
+};
+
+static inline uint32_t ring_used(uint32_t read, uint32_t write, uint32_t size){
+  return (read <= write)? write - read : write + 2*size - read;
+}
+
+static inline uint32_t ring_advance(uint32_t pointer, uint32_t size, uint32_t total){
+  pointer += size;
+  return (2*total <= pointer)? pointer - 2*total : pointer;
+}
+
+// OWN orders loads of the side's own pointer, OTHER loads of the
+// other side's pointer, STORE the publishing store. With CACHED set
+// the other side's pointer is only reloaded when the cached copy does
+// not suffice.
+#define DEFINE_RING(NAME, OWN, OTHER, STORE, CACHED)                    \
+  static int NAME##_request_write(void **area, uint32_t *size, void *queue){ \
+    struct ring *ring = (struct ring *)queue;                           \
+    uint32_t write = __atomic_load_n(&ring->write, OWN);                \
+    if(!CACHED || ring->size - ring_used(ring->read_cache, write, ring->size) < *size) \
+      ring->read_cache = __atomic_load_n(&ring->read, OTHER);           \
+    uint32_t available = ring->size - ring_used(ring->read_cache, write, ring->size); \
+    uint32_t off = write % ring->size;                                  \
+    *size = MIN(*size, MIN(available, ring->size - off));               \
+    *area = ring->data + off;                                           \
+    return 0 < *size;                                                   \
+  }                                                                     \
+  static int NAME##_finish_write(uint32_t size, void *queue){           \
+    struct ring *ring = (struct ring *)queue;                           \
+    uint32_t write = __atomic_load_n(&ring->write, OWN);                \
+    __atomic_store_n(&ring->write, ring_advance(write, size, ring->size), STORE); \
+    return 1;                                                           \
+  }                                                                     \
+  static int NAME##_request_read(void **area, uint32_t *size, void *queue){ \
+    struct ring *ring = (struct ring *)queue;                           \
+    uint32_t read = __atomic_load_n(&ring->read, OWN);                  \
+    if(!CACHED || ring_used(read, ring->write_cache, ring->size) < *size) \
+      ring->write_cache = __atomic_load_n(&ring->write, OTHER);         \
+    uint32_t available = ring_used(read, ring->write_cache, ring->size); \
+    uint32_t off = read % ring->size;                                   \
+    *size = MIN(*size, MIN(available, ring->size - off));               \
+    *area = ring->data + off;                                           \
+    return 0 < *size;                                                   \
+  }                                                                     \
+  static int NAME##_finish_read(uint32_t size, void *queue){            \
+    struct ring *ring = (struct ring *)queue;                           \
+    uint32_t read = __atomic_load_n(&ring->read, OWN);                  \
+    __atomic_store_n(&ring->read, ring_advance(read, size, ring->size), STORE); \
+    return 1;                                                           \
+  }
+
+DEFINE_RING(seq_cst, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST, 0)
+DEFINE_RING(acq_rel, __ATOMIC_RELAXED, __ATOMIC_ACQUIRE, __ATOMIC_RELEASE, 1)
+
+static int pack_request_write(void **area, uint32_t *size, void *queue){
+  return mixed_pack_request_write(area, size, (struct mixed_pack *)queue);
+}
+
+static int pack_finish_write(uint32_t size, void *queue){
+  return mixed_pack_finish_write(size, (struct mixed_pack *)queue);
+}
+
+static int pack_request_read(void **area, uint32_t *size, void *queue){
+  return mixed_pack_request_read(area, size, (struct mixed_pack *)queue);
+}
+
+static int pack_finish_read(uint32_t size, void *queue){
+  return mixed_pack_finish_read(size, (struct mixed_pack *)queue);
+}
+
+struct queue_ops{
+  int (*request_write)(void **area, uint32_t *size, void *queue);
+  int (*finish_write)(uint32_t size, void *queue);
+  int (*request_read)(void **area, uint32_t *size, void *queue);
+  int (*finish_read)(uint32_t size, void *queue);
+};
+
+static struct queue_ops pack_ops = {pack_request_write, pack_finish_write, pack_request_read, pack_finish_read};
+static struct queue_ops seq_cst_ops = {seq_cst_request_write, seq_cst_finish_write, seq_cst_request_read, seq_cst_finish_read};
+static struct queue_ops acq_rel_ops = {acq_rel_request_write, acq_rel_finish_write, acq_rel_request_read, acq_rel_finish_read};
+
+struct bench{
+  struct queue_ops *ops;
+  void *queue;
+  uint32_t chunk;
+  uint64_t total;
+  uint64_t checksum;
+};
+
+static double now(){
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec / 1000000000.0;
+}
+
+static void *producer(void *arg){
+  struct bench *bench = (struct bench *)arg;
+  uint64_t written = 0;
+  unsigned char counter = 0;
+  while(written < bench->total){
+    unsigned char *area;
+    uint32_t size = MIN(bench->chunk, bench->total - written);
+    if(!bench->ops->request_write((void**)&area, &size, bench->queue)){
+      sched_yield();
+      continue;
+    }
+    for(uint32_t i=0; i<size; ++i)
+      area[i] = counter++;
+    bench->ops->finish_write(size, bench->queue);
+    written += size;
+  }
+  return 0;
+}
+
+static void *consumer(void *arg){
+  struct bench *bench = (struct bench *)arg;
+  uint64_t read = 0;
+  uint64_t checksum = 0;
+  while(read < bench->total){
+    unsigned char *area;
+    uint32_t size = bench->chunk;
+    if(!bench->ops->request_read((void**)&area, &size, bench->queue)){
+      sched_yield();
+      continue;
+    }
+    for(uint32_t i=0; i<size; ++i)
+      checksum += area[i];
+    bench->ops->finish_read(size, bench->queue);
+    read += size;
+  }
+  bench->checksum = checksum;
+  return 0;
+}
+
+// The producer writes a byte counter, so the sum is known up front.
+static uint64_t expected_checksum(uint64_t total){
+  uint64_t rest = total % 256;
+  return (total / 256) * (255*256/2) + rest*(rest-1)/2;
+}
+
+static int run_queue(char *name, struct queue_ops *ops, void *queue, uint32_t size, uint32_t chunk, uint64_t total){
+  struct bench bench = {0};
+  pthread_t threads[2];
+  bench.ops = ops;
+  bench.queue = queue;
+  bench.chunk = chunk;
+  bench.total = total;
+
+  double start = now();
+  pthread_create(&threads[0], 0, consumer, &bench);
+  pthread_create(&threads[1], 0, producer, &bench);
+  pthread_join(threads[1], 0);
+  pthread_join(threads[0], 0);
+  double time = now() - start;
+
+  printf("%-10s %10u %8u %10.1f MB/s\n", name, size, chunk, total / time / (1024*1024));
+  if(bench.checksum != expected_checksum(total)){
+    fprintf(stderr, "%s: checksum mismatch, data was corrupted in transit.\n", name);
+    return 0;
+  }
+  return 1;
+}
+
+static int run_pack(char *name, enum mixed_pack_flags flags, uint32_t size, uint32_t chunk, uint64_t total){
+  struct mixed_pack pack = {0};
+  pack.flags = flags;
+  pack.encoding = MIXED_UINT8;
+  pack.channels = 1;
+  pack.samplerate = 44100;
+  if(!mixed_make_pack(size, &pack)){
+    fprintf(stderr, "Failed to make pack: %s\n", mixed_error_string(-1));
+    return 0;
+  }
+  int result = run_queue(name, &pack_ops, &pack, pack.size, chunk, total);
+  mixed_free_pack(&pack);
+  return result;
+}
+
+static int run_ring(char *name, struct queue_ops *ops, uint32_t size, uint32_t chunk, uint64_t total){
+  struct ring ring = {0};
+  ring.data = calloc(size, 1);
+  ring.size = size;
+  if(!ring.data){
+    fprintf(stderr, "Failed to allocate ring.\n");
+    return 0;
+  }
+  int result = run_queue(name, ops, &ring, size, chunk, total);
+  free(ring.data);
+  return result;
+}
+
+int main(int argc, char **argv){
+  uint32_t size = (1 < argc)? atoi(argv[1]) : 64*1024;
+  uint32_t chunk = (2 < argc)? atoi(argv[2]) : 4096;
+  uint64_t total = ((3 < argc)? atoi(argv[3]) : 2048) * (uint64_t)1024*1024;
+
+  printf("%-10s %10s %8s %15s\n", "Mode", "Size", "Chunk", "Throughput");
+  if(!run_pack("bip", 0, size, chunk, total)) return 1;
+  if(!run_pack("mirrored", MIXED_PACK_MIRRORED, size, chunk, total)) return 1;
+  if(!run_ring("seq_cst", &seq_cst_ops, size, chunk, total)) return 1;
+  if(!run_ring("acq_rel", &acq_rel_ops, size, chunk, total)) return 1;
+  return 0;
+}
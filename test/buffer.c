@@ -11,6 +11,202 @@ define_test(make, {
   cleanup:;
   });
 
+define_test(make_aligned, {
+    struct mixed_buffer buffer = {0};
+    float *area = 0;
+    uint32_t size = UINT32_MAX;
+    buffer.flags = MIXED_BUFFER_ALIGNED;
+    pass(mixed_make_buffer(1000, &buffer));
+    is(buffer.size, 1008);
+    is(((uintptr_t)buffer._data) % 64, 0);
+    pass(mixed_buffer_request_write(&area, &size, &buffer));
+    is(size, 1008);
+    is_p(area, buffer._data);
+    pass(mixed_buffer_finish_write(size, &buffer));
+    pass(mixed_buffer_resize(2000, &buffer));
+    is(((uintptr_t)buffer._data) % 64, 0);
+    is(buffer.size, 2000);
+    // Making the buffer again keeps it aligned
+    mixed_free_buffer(&buffer);
+    is(buffer.flags, MIXED_BUFFER_ALIGNED);
+    pass(mixed_make_buffer(1000, &buffer));
+    is(buffer.size, 1008);
+    
+  cleanup:
+    mixed_free_buffer(&buffer);
+  });
+
+define_test(pool, {
+    struct mixed_buffer_pool pool = {0};
+    struct mixed_buffer a = {0}, b = {0}, c = {0};
+    uint32_t sizes[2] = {128, 1024};
+    uint32_t counts[2] = {1, 1};
+    pass(mixed_make_buffer_pool(2, sizes, counts, &pool));
+    // Small request takes the small class first
+    pass(mixed_buffer_pool_acquire(100, &a, &pool));
+    is(a.size, 100);
+    is(((uintptr_t)a._data) % 64, 0);
+    // Then spills over into the larger one
+    pass(mixed_buffer_pool_acquire(100, &b, &pool));
+    isnt_p(a._data, b._data);
+    // And finally runs dry
+    fail(mixed_buffer_pool_acquire(100, &c, &pool));
+    pass(mixed_buffer_pool_release(&a, &pool));
+    is_p(a._data, 0);
+    pass(mixed_buffer_pool_acquire(128, &c, &pool));
+    pass(mixed_buffer_pool_release(&b, &pool));
+    pass(mixed_buffer_pool_release(&c, &pool));
+    
+  cleanup:
+    mixed_free_buffer_pool(&pool);
+  });
+
+define_test(arena, {
+    struct mixed_arena arena = {0};
+    struct mixed_buffer a = {0}, b = {0};
+    size_t used = 0;
+    pass(mixed_make_arena(64*1024, &arena));
+    pass(mixed_set_allocator(&arena.allocator));
+    is_p(mixed_get_allocator(), &arena.allocator);
+    pass(mixed_make_buffer(1024, &a));
+    isnt(arena.used, 0);
+    used = arena.used;
+    // Resizing goes through the arena as well
+    pass(mixed_buffer_resize(2048, &a));
+    is(a.size, 2048);
+    if(arena.used <= used) fail_test("Resize did not allocate from the arena");
+    // And it runs dry once exhausted
+    fail(mixed_make_buffer(64*1024, &b));
+    pass(mixed_set_allocator(0));
+    // Freeing still works after the allocator is reset
+    mixed_free_buffer(&a);
+    pass(mixed_arena_reset(&arena));
+    is(arena.used, 0);
+    // Sizes whose product wraps around are refused
+    is_p(arena.allocator.calloc(SIZE_MAX/8+2, 8, arena.allocator.user), 0);
+    is(arena.used, 0);
+    
+  cleanup:
+    mixed_set_allocator(0);
+    mixed_free_arena(&arena);
+  });
+
+define_test(mirrored, {
+    struct mixed_buffer buffer = {0};
+    float *area = 0;
+    uint32_t size = UINT32_MAX;
+    buffer.flags = MIXED_BUFFER_MIRRORED;
+    // The positions would overflow
+    fail(mixed_make_buffer(0x80000000u, &buffer));
+    is(mixed_error(), MIXED_INVALID_VALUE);
+    pass(mixed_make_buffer(1000, &buffer));
+    if(!(buffer.flags & MIXED_BUFFER_MIRRORED)) goto cleanup;
+    is(buffer.size, 1024);
+    // Move the pointers close to the end of the array
+    pass(mixed_buffer_request_write(&area, &size, &buffer));
+    pass(mixed_buffer_finish_write(1000, &buffer));
+    size = UINT32_MAX;
+    pass(mixed_buffer_request_read(&area, &size, &buffer));
+    pass(mixed_buffer_finish_read(1000, &buffer));
+    // Now the full size should be available across the wrap
+    size = UINT32_MAX;
+    pass(mixed_buffer_request_write(&area, &size, &buffer));
+    is(size, 1024);
+    is_p(area, buffer._data+1000);
+    for(uint32_t i=0; i<size; ++i) area[i] = i;
+    pass(mixed_buffer_finish_write(size, &buffer));
+    is(mixed_buffer_available_write(&buffer), 0);
+    is(buffer._data[0], 24);
+    size = UINT32_MAX;
+    pass(mixed_buffer_request_read(&area, &size, &buffer));
+    is(size, 1024);
+    is(area[1023], 1023);
+    pass(mixed_buffer_finish_read(size, &buffer));
+    is(mixed_buffer_available_read(&buffer), 0);
+    
+  cleanup:
+    mixed_free_buffer(&buffer);
+  });
+
+define_test(group, {
+    struct mixed_buffer a = {0}, b = {0}, c = {0};
+    struct mixed_buffer *ins[2] = {&a, 0};
+    struct mixed_buffer *outs[2] = {&b, &c};
+    struct mixed_buffer_group group = {ins, 2, outs, 2};
+    float *in_areas[2], *out_areas[2];
+    uint32_t frames = UINT32_MAX;
+    float *area;
+    uint32_t size = 100;
+    pass(mixed_make_buffer(1024, &a));
+    pass(mixed_make_buffer(1024, &b));
+    pass(mixed_make_buffer(1024, &c));
+    // Nothing to read yet
+    fail(mixed_buffer_group_request(in_areas, out_areas, &frames, &group));
+    is(frames, 0);
+    pass(mixed_buffer_request_write(&area, &size, &a));
+    pass(mixed_buffer_finish_write(100, &a));
+    size = 1000;
+    pass(mixed_buffer_request_write(&area, &size, &c));
+    pass(mixed_buffer_finish_write(1000, &c));
+    // Narrowed to the smallest of all members
+    frames = UINT32_MAX;
+    pass(mixed_buffer_group_request(in_areas, out_areas, &frames, &group));
+    is(frames, 24);
+    is_p(in_areas[0], a._data);
+    is_p(in_areas[1], 0);
+    is_p(out_areas[0], b._data);
+    is_p(out_areas[1], c._data+1000);
+    pass(mixed_buffer_group_finish(frames, &group));
+    is(mixed_buffer_available_read(&a), 76);
+    is(mixed_buffer_available_read(&b), 24);
+    is(mixed_buffer_available_write(&c), 0);
+    
+  cleanup:
+    mixed_free_buffer(&a);
+    mixed_free_buffer(&b);
+    mixed_free_buffer(&c);
+  });
+
+define_test(multibuffer, {
+    struct mixed_multibuffer a = {0}, b = {0};
+    struct mixed_segment fade = {0};
+    float *areas[6], *out[6];
+    uint32_t frames = UINT32_MAX;
+    a.channels = 6;
+    b.channels = 6;
+    pass(mixed_make_multibuffer(100, &a));
+    pass(mixed_make_multibuffer(100, &b));
+    // Every plane should be aligned
+    pass(mixed_multibuffer_request_write(areas, &frames, &a));
+    is(frames, 100);
+    for(uint32_t c=0; c<6; ++c){
+      is(((uintptr_t)areas[c]) % 64, 0);
+      for(uint32_t i=0; i<frames; ++i)
+        areas[c][i] = c;
+    }
+    pass(mixed_multibuffer_finish_write(frames, &a));
+    is(mixed_multibuffer_available_read(&a), 100);
+    is(mixed_multibuffer_available_write(&a), 0);
+    // Process all channels through one segment
+    pass(mixed_make_segment_fade(0.5, 0.5, 1.0, MIXED_LINEAR, 44100, &fade));
+    pass(mixed_segment_set_in(MIXED_MULTIBUFFER, 0, &a, &fade));
+    pass(mixed_segment_set_out(MIXED_MULTIBUFFER, 0, &b, &fade));
+    pass(mixed_segment_start(&fade));
+    pass(mixed_segment_mix(&fade));
+    is(mixed_multibuffer_available_read(&a), 0);
+    frames = UINT32_MAX;
+    pass(mixed_multibuffer_request_read(out, &frames, &b));
+    is(frames, 100);
+    for(uint32_t c=0; c<6; ++c)
+      is_f(out[c][99], c*0.5);
+    pass(mixed_multibuffer_finish_read(frames, &b));
+
+  cleanup:
+    mixed_free_segment(&fade);
+    mixed_free_multibuffer(&a);
+    mixed_free_multibuffer(&b);
+  });
+
 define_test(write_allocation, {
     struct mixed_buffer buffer = {0};
     pass(mixed_make_buffer(1024, &buffer));
@@ -223,6 +419,61 @@ define_test(transfer, {
     mixed_free_buffer(&b);
   });
 
+define_test(forward, {
+    struct mixed_buffer a={0}, b={0}, c={0};
+    float *area, *storage;
+    uint32_t size = 1024;
+    float mem[size];
+    a.flags = b.flags = c.flags = MIXED_BUFFER_FORWARD;
+    pass(mixed_make_buffer(size, &a));
+    pass(mixed_make_buffer(size, &b));
+    pass(mixed_make_buffer(size/2, &c));
+    for(int i=0; i<1024; i++)
+      mem[i] = rand();
+    pass(mixed_buffer_request_write(&area, &size, &a));
+    memcpy(area, mem, sizeof(float)*size);
+    pass(mixed_buffer_finish_write(size, &a));
+    storage = a._data;
+    // b is empty, so the array should be handed over
+    pass(mixed_buffer_transfer(&a, &b));
+    is_p(b._data, storage);
+    isnt_p(a._data, storage);
+    is(mixed_buffer_available_read(&a), 0);
+    is(mixed_buffer_available_write(&a), 1024);
+    pass(mixed_buffer_request_read(&area, &size, &b));
+    is(size, 1024);
+    is(memcmp(mem, area, sizeof(float)*size), 0);
+    // Sizes differ, so this must copy
+    pass(mixed_buffer_transfer(&b, &c));
+    is_p(b._data, storage);
+    is(mixed_buffer_available_read(&c), 512);
+    is(mixed_buffer_available_read(&b), 512);
+    // Shared buffers must stay put
+    mixed_buffer_clear(&a);
+    mixed_buffer_clear(&b);
+    size = 16;
+    pass(mixed_buffer_request_write(&area, &size, &b));
+    pass(mixed_buffer_finish_write(size, &b));
+    b.flags |= MIXED_BUFFER_SHARED;
+    a.flags |= MIXED_BUFFER_SHARED;
+    pass(mixed_buffer_transfer(&b, &a));
+    is_p(b._data, storage);
+    is(mixed_buffer_available_read(&a), 16);
+    // Without opting in, buffers always copy
+    mixed_buffer_clear(&a);
+    a.flags = b.flags = 0;
+    pass(mixed_buffer_request_write(&area, &size, &b));
+    pass(mixed_buffer_finish_write(size, &b));
+    pass(mixed_buffer_transfer(&b, &a));
+    is_p(b._data, storage);
+    is(mixed_buffer_available_read(&a), 16);
+
+  cleanup:
+    mixed_free_buffer(&a);
+    mixed_free_buffer(&b);
+    mixed_free_buffer(&c);
+  });
+
 define_test(copy, {
     struct mixed_buffer a={0}, b={0};
     float *area;
@@ -272,6 +523,50 @@ define_test(resize, {
     mixed_free_buffer(&buffer);
   });
 
+define_test(staged_resize, {
+    struct mixed_buffer buffer = {0};
+    float *area;
+    uint32_t size = 16;
+    pass(mixed_make_buffer(16, &buffer));
+    // Fill, consume some, and wrap around
+    pass(mixed_buffer_request_write(&area, &size, &buffer));
+    for(uint32_t i=0; i<16; ++i) area[i] = i;
+    pass(mixed_buffer_finish_write(16, &buffer));
+    size = 10;
+    pass(mixed_buffer_request_read(&area, &size, &buffer));
+    pass(mixed_buffer_finish_read(10, &buffer));
+    size = 6;
+    pass(mixed_buffer_request_write(&area, &size, &buffer));
+    is(size, 6);
+    for(uint32_t i=0; i<6; ++i) area[i] = 16+i;
+    pass(mixed_buffer_finish_write(6, &buffer));
+    // Stage and apply
+    pass(mixed_buffer_stage_resize(32, &buffer));
+    fail(mixed_buffer_stage_resize(64, &buffer));
+    is(buffer.size, 16);
+    pass(mixed_buffer_apply_resize(&buffer));
+    fail(mixed_buffer_apply_resize(&buffer));
+    is(buffer.size, 32);
+    isnt_p(buffer._retired, 0);
+    // The pending data should now be in one piece
+    size = UINT32_MAX;
+    pass(mixed_buffer_request_read(&area, &size, &buffer));
+    is(size, 12);
+    for(uint32_t i=0; i<12; ++i) is_f(area[i], 10+i);
+    is(mixed_buffer_available_write(&buffer), 20);
+    pass(mixed_buffer_reclaim_resize(&buffer));
+    is_p(buffer._retired, 0);
+    // Shrinking keeps the oldest samples
+    pass(mixed_buffer_resize(8, &buffer));
+    size = UINT32_MAX;
+    pass(mixed_buffer_request_read(&area, &size, &buffer));
+    is(size, 8);
+    for(uint32_t i=0; i<8; ++i) is_f(area[i], 10+i);
+
+  cleanup:
+    mixed_free_buffer(&buffer);
+  });
+
 define_test(with_transfer, {
     float *area;
     uint32_t size = 1024;
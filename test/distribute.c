@@ -79,4 +79,26 @@ define_test(distribute_varying, {
     mixed_free_segment(&distribute);
     mixed_free_buffer(&buffer);
   })
+define_test(distribute_release, {
+    struct mixed_buffer buffer = {0}, other = {0};
+    struct mixed_segment distribute = {0};
+    pass(mixed_make_buffer(100, &buffer));
+    pass(mixed_make_buffer(100, &other));
+    pass(mixed_make_segment_distribute(&distribute));
+    // Attaching pins the input's storage
+    pass(mixed_segment_set_in(MIXED_BUFFER, MIXED_MONO, &buffer, &distribute));
+    is(buffer.flags & MIXED_BUFFER_SHARED, MIXED_BUFFER_SHARED);
+    // Replacing the input releases it again
+    pass(mixed_segment_set_in(MIXED_BUFFER, MIXED_MONO, &other, &distribute));
+    is(buffer.flags & MIXED_BUFFER_SHARED, 0);
+    is(other.flags & MIXED_BUFFER_SHARED, MIXED_BUFFER_SHARED);
+    // As does detaching it
+    pass(mixed_segment_set_in(MIXED_BUFFER, MIXED_MONO, 0, &distribute));
+    is(other.flags & MIXED_BUFFER_SHARED, 0);
+
+  cleanup:
+    mixed_free_segment(&distribute);
+    mixed_free_buffer(&buffer);
+    mixed_free_buffer(&other);
+  })
 #undef __TEST_SUITE
@@ -0,0 +1,151 @@
+#define __TEST_SUITE graph
+#include "tester.h"
+
+define_test(order, {
+    struct mixed_pack in = {0}, out = {0};
+    struct mixed_buffer a[2] = {0}, b[2] = {0};
+    struct mixed_segment unpacker = {0}, volume = {0}, packer = {0}, graph = {0};
+    struct mixed_segment **plan;
+    uint32_t count;
+    float *data;
+    uint32_t size = UINT32_MAX;
+    in.encoding = MIXED_FLOAT; in.channels = 2; in.samplerate = 48000;
+    out.encoding = MIXED_FLOAT; out.channels = 2; out.samplerate = 48000;
+    pass(mixed_make_pack(64, &in));
+    pass(mixed_make_pack(64, &out));
+    for(int c=0; c<2; ++c){
+      pass(mixed_make_buffer(64, &a[c]));
+      pass(mixed_make_buffer(64, &b[c]));
+    }
+    pass(mixed_make_segment_unpacker(&in, 48000, &unpacker));
+    pass(mixed_make_segment_volume_control(0.5, 0.0, &volume));
+    pass(mixed_make_segment_packer(&out, 48000, &packer));
+    pass(mixed_make_segment_graph(&graph));
+    // Add the segments in the wrong order on purpose.
+    pass(mixed_graph_add(&packer, &graph));
+    pass(mixed_graph_add(&volume, &graph));
+    pass(mixed_graph_add(&unpacker, &graph));
+    fail(mixed_graph_add(&volume, &graph));
+    fail(mixed_graph_connect(&unpacker, 0, &graph, 0, &a[0], &graph));
+    for(int c=0; c<2; ++c){
+      pass(mixed_graph_connect(&unpacker, c, &volume, c, &a[c], &graph));
+      pass(mixed_graph_connect(&volume, c, &packer, c, &b[c], &graph));
+    }
+    pass(mixed_graph_plan(&plan, &count, &graph));
+    is(count, 3);
+    is(plan[0], &unpacker);
+    is(plan[1], &volume);
+    is(plan[2], &packer);
+
+    mixed_pack_request_write((void**)&data, &size, &in);
+    for(uint32_t i=0; i<size/sizeof(float); ++i)
+      data[i] = 0.5;
+    mixed_pack_finish_write(size, &in);
+    pass(mixed_segment_start(&graph));
+    pass(mixed_segment_mix(&graph));
+    is(mixed_pack_available_read(&out), 64*2*sizeof(float));
+    size = UINT32_MAX;
+    mixed_pack_request_read((void**)&data, &size, &out);
+    is_f(data[0], 0.25);
+    pass(mixed_segment_end(&graph));
+
+    // Disconnecting leaves no constraints but the insertion order.
+    pass(mixed_graph_disconnect(&packer, 0, &graph));
+    pass(mixed_graph_disconnect(&packer, 1, &graph));
+    fail(mixed_graph_disconnect(&packer, 1, &graph));
+    pass(mixed_graph_plan(&plan, &count, &graph));
+    is(plan[0], &packer);
+    is(plan[1], &unpacker);
+    is(plan[2], &volume);
+
+    // Feeding a segment its own output closes a cycle.
+    pass(mixed_graph_connect(&volume, 0, &volume, 0, &b[0], &graph));
+    fail(mixed_graph_plan(&plan, &count, &graph));
+    is(mixed_error(), MIXED_GRAPH_CYCLE);
+    fail(mixed_segment_mix(&graph));
+    pass(mixed_graph_remove(&volume, &graph));
+    pass(mixed_graph_plan(&plan, &count, &graph));
+    is(count, 2);
+
+  cleanup:
+    mixed_free_segment(&graph);
+    mixed_free_segment(&unpacker);
+    mixed_free_segment(&volume);
+    mixed_free_segment(&packer);
+    for(int c=0; c<2; ++c){
+      mixed_free_buffer(&a[c]);
+      mixed_free_buffer(&b[c]);
+    }
+    mixed_free_pack(&in);
+    mixed_free_pack(&out);
+  })
+
+#define VOICES 16
+
+define_test(parallel, {
+    struct mixed_pack voices[VOICES] = {0}, out = {0};
+    struct mixed_buffer buffers[VOICES] = {0}, mixed = {0};
+    struct mixed_segment unpackers[VOICES] = {0}, mixer = {0}, packer = {0}, graph = {0};
+    uint32_t threads = 4;
+    float *data;
+    uint32_t size;
+    out.encoding = MIXED_FLOAT; out.channels = 1; out.samplerate = 48000;
+    pass(mixed_make_pack(64, &out));
+    pass(mixed_make_buffer(64, &mixed));
+    pass(mixed_make_segment_basic_mixer(1, &mixer));
+    pass(mixed_make_segment_packer(&out, 48000, &packer));
+    pass(mixed_make_segment_graph(&graph));
+    pass(mixed_graph_add(&packer, &graph));
+    pass(mixed_graph_add(&mixer, &graph));
+    for(int v=0; v<VOICES; ++v){
+      voices[v].encoding = MIXED_FLOAT; voices[v].channels = 1; voices[v].samplerate = 48000;
+      pass(mixed_make_pack(64, &voices[v]));
+      pass(mixed_make_buffer(64, &buffers[v]));
+      pass(mixed_make_segment_unpacker(&voices[v], 48000, &unpackers[v]));
+      pass(mixed_graph_add(&unpackers[v], &graph));
+      pass(mixed_graph_connect(&unpackers[v], 0, &mixer, v, &buffers[v], &graph));
+    }
+    pass(mixed_graph_connect(&mixer, 0, &packer, 0, &mixed, &graph));
+    size = 0;
+    fail(mixed_segment_set(MIXED_THREADS, &size, &graph));
+    pass(mixed_segment_set(MIXED_THREADS, &threads, &graph));
+    pass(mixed_segment_start(&graph));
+    for(int round=0; round<200; ++round){
+      // Change the pool while running now and then.
+      if(round == 100){
+        threads = 3;
+        pass(mixed_segment_set(MIXED_THREADS, &threads, &graph));
+      }
+      for(int v=0; v<VOICES; ++v){
+        size = UINT32_MAX;
+        mixed_pack_request_write((void**)&data, &size, &voices[v]);
+        for(uint32_t i=0; i<size/sizeof(float); ++i)
+          data[i] = (v+1)/256.0;
+        mixed_pack_finish_write(size, &voices[v]);
+      }
+      pass(mixed_segment_mix(&graph));
+      size = UINT32_MAX;
+      mixed_pack_request_read((void**)&data, &size, &out);
+      is(size, 64*sizeof(float));
+      is_f(data[0], 136/256.0);
+      is_f(data[63], 136/256.0);
+      mixed_pack_finish_read(size, &out);
+    }
+    pass(mixed_segment_get(MIXED_THREADS, &threads, &graph));
+    is(threads, 3);
+    pass(mixed_segment_end(&graph));
+
+  cleanup:
+    mixed_free_segment(&graph);
+    mixed_free_segment(&mixer);
+    mixed_free_segment(&packer);
+    for(int v=0; v<VOICES; ++v){
+      mixed_free_segment(&unpackers[v]);
+      mixed_free_buffer(&buffers[v]);
+      mixed_free_pack(&voices[v]);
+    }
+    mixed_free_buffer(&mixed);
+    mixed_free_pack(&out);
+  })
+
+#undef __TEST_SUITE
@@ -1,6 +1,8 @@
 #define __TEST_SUITE pack
 #include <string.h>
 #include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include "tester.h"
 
 define_test(make, {
@@ -15,6 +17,256 @@ define_test(make, {
     mixed_free_pack(&pack);
   });
 
+define_test(mmap, {
+    struct mixed_pack pack = {0};
+    char path[] = "/tmp/mixed-pack-XXXXXX";
+    int16_t samples[1024];
+    void *area = 0;
+    uint32_t avail = UINT32_MAX;
+    int fd = mkstemp(path);
+    if(fd < 0) fail_test("Failed to create temporary file.");
+    for(int i=0; i<1024; ++i) samples[i] = i;
+    // Leave an unaligned header in front of the samples
+    if(write(fd, "RIFF", 3) != 3 || write(fd, samples, sizeof(samples)) != sizeof(samples))
+      fail_test("Failed to write temporary file.");
+    close(fd);
+
+    pack.channels = 2;
+    pack.encoding = MIXED_INT16;
+    pack.samplerate = 1;
+    pass(mixed_make_pack_mmap(path, 3, 0, &pack));
+    is(pack.size, sizeof(samples));
+    is(mixed_pack_available_read(&pack), sizeof(samples));
+    is(mixed_pack_available_write(&pack), 0);
+    fail(mixed_pack_request_write(&area, &avail, &pack));
+    avail = 64;
+    pass(mixed_pack_request_read(&area, &avail, &pack));
+    is(avail, 64);
+    is(((int16_t*)area)[1], 1);
+    pass(mixed_pack_finish_read(avail, &pack));
+    is(mixed_pack_available_read(&pack), sizeof(samples)-64);
+    pass(mixed_pack_seek(100, &pack));
+    avail = UINT32_MAX;
+    pass(mixed_pack_request_read(&area, &avail, &pack));
+    is(avail, sizeof(samples)-400);
+    is(((int16_t*)area)[0], 200);
+    fail(mixed_pack_seek(513, &pack));
+    mixed_free_pack(&pack);
+    // Frames beyond the end of the file are rejected
+    fail(mixed_make_pack_mmap(path, 3, 513, &pack));
+    
+  cleanup:
+    mixed_free_pack(&pack);
+    unlink(path);
+  });
+
+static void *delayed_writer(void *arg){
+  struct mixed_pack *pack = (struct mixed_pack *)arg;
+  unsigned char data[64] = {0};
+  uint32_t bytes = sizeof(data);
+  struct timespec time = {0, 10000000};
+  nanosleep(&time, 0);
+  mixed_pack_write(data, &bytes, -1, pack);
+  return 0;
+}
+
+static int watermarks = 0;
+static void on_low(struct mixed_pack *pack){ watermarks -= 1; }
+static void on_high(struct mixed_pack *pack){ watermarks += 10; }
+
+define_test(wait, {
+    struct mixed_pack pack = {0};
+    pthread_t writer = 0;
+    unsigned char data[256] = {0};
+    uint32_t bytes = 0;
+    void *area = 0;
+    pack.channels = 1;
+    pack.encoding = MIXED_UINT8;
+    pack.samplerate = 1;
+    pack.flags = MIXED_PACK_WAITABLE;
+    pass(mixed_make_pack(128, &pack));
+    // Nothing there, time out
+    fail(mixed_pack_wait_read(1, 5, &pack));
+    is(mixed_error(), MIXED_BUFFER_EMPTY);
+    pass(mixed_pack_wait_write(128, 0, &pack));
+    // Get woken by the writer
+    if(pthread_create(&writer, 0, delayed_writer, &pack) != 0)
+      fail_test("Failed to spawn thread.");
+    pass(mixed_pack_wait_read(64, -1, &pack));
+    pthread_join(writer, 0);
+    writer = 0;
+    is(mixed_pack_available_read(&pack), 64);
+    // Watermarks fire on crossings only
+    pack.on_low_watermark = on_low;
+    pack.on_high_watermark = on_high;
+    pack.low_watermark = 16;
+    pack.high_watermark = 96;
+    bytes = 32;
+    pass(mixed_pack_write(data, &bytes, 0, &pack));
+    is(watermarks, 10);
+    bytes = 80;
+    pass(mixed_pack_request_read(&area, &bytes, &pack));
+    pass(mixed_pack_finish_read(80, &pack));
+    is(watermarks, 9);
+    // Blocking write times out when there is no room
+    bytes = 256;
+    fail(mixed_pack_write(data, &bytes, 5, &pack));
+    is(bytes, 112);
+    // Dropping the newest data writes what fits
+    pass(mixed_pack_clear(&pack));
+    pack.overflow = MIXED_OVERFLOW_DROP_NEWEST;
+    bytes = 256;
+    pass(mixed_pack_write(data, &bytes, 0, &pack));
+    is(bytes, 128);
+    
+  cleanup:
+    if(writer) pthread_cancel(writer);
+    mixed_free_pack(&pack);
+  });
+
+define_test(drop_oldest, {
+    struct mixed_pack pack = {0};
+    unsigned char data[4096];
+    uint32_t bytes = 0;
+    unsigned char *area = 0;
+    pack.channels = 1;
+    pack.encoding = MIXED_UINT8;
+    pack.samplerate = 1;
+    pack.flags = MIXED_PACK_MIRRORED;
+    pack.overflow = MIXED_OVERFLOW_DROP_OLDEST;
+    pass(mixed_make_pack(4096, &pack));
+    if(!(pack.flags & MIXED_PACK_MIRRORED)) goto cleanup;
+    for(int i=0; i<4096; ++i) data[i] = i/16;
+    bytes = 4000;
+    pass(mixed_pack_write(data, &bytes, 0, &pack));
+    // Overwrites the first 1000 bytes
+    bytes = 1096;
+    pass(mixed_pack_write(data+3000, &bytes, 0, &pack));
+    is(bytes, 1096);
+    is(mixed_pack_available_read(&pack), 4096);
+    bytes = UINT32_MAX;
+    pass(mixed_pack_request_read((void**)&area, &bytes, &pack));
+    is(area[0], data[1000]);
+    is(area[4095], data[4095]);
+    pass(mixed_pack_finish_read(bytes, &pack));
+    // Blocking cannot wait without MIXED_PACK_WAITABLE
+    pack.overflow = MIXED_OVERFLOW_BLOCK;
+    bytes = 4000;
+    pass(mixed_pack_write(data, &bytes, -1, &pack));
+    bytes = 1096;
+    fail(mixed_pack_write(data, &bytes, -1, &pack));
+    is(mixed_error(), MIXED_BUFFER_FULL);
+    is(bytes, 96);
+    
+  cleanup:
+    mixed_free_pack(&pack);
+  });
+
+define_test(drop_oldest_reading, {
+    struct mixed_pack pack = {0};
+    int16_t data[4096];
+    uint32_t bytes = 0;
+    int16_t *area = 0;
+    pack.channels = 2;
+    pack.encoding = MIXED_INT16;
+    pack.samplerate = 1;
+    pack.flags = MIXED_PACK_MIRRORED;
+    pack.overflow = MIXED_OVERFLOW_DROP_OLDEST;
+    pass(mixed_make_pack(1024, &pack));
+    if(!(pack.flags & MIXED_PACK_MIRRORED)) goto cleanup;
+    for(int i=0; i<4096; ++i) data[i] = i;
+    bytes = pack.size;
+    pass(mixed_pack_write(data, &bytes, 0, &pack));
+    // A drop while reading is reported at the finish
+    bytes = 16;
+    pass(mixed_pack_request_read((void**)&area, &bytes, &pack));
+    bytes = 3;
+    pass(mixed_pack_write(data, &bytes, 0, &pack));
+    fail(mixed_pack_finish_read(16, &pack));
+    is(mixed_error(), MIXED_BUFFER_DROPPED);
+    // Only whole frames were dropped, so the channels stay in place
+    bytes = UINT32_MAX;
+    pass(mixed_pack_request_read((void**)&area, &bytes, &pack));
+    is(area[0], 2);
+    is(area[1], 3);
+    pass(mixed_pack_finish_read(4, &pack));
+    
+  cleanup:
+    mixed_free_pack(&pack);
+  });
+
+#define PRODUCERS 4
+#define PRODUCER_FRAMES 20000
+
+struct producer{
+  struct mixed_pack *pack;
+  int32_t id;
+  int stop;
+};
+
+static void *reserving_writer(void *arg){
+  struct producer *producer = (struct producer *)arg;
+  int32_t sequence = 0;
+  while(sequence < PRODUCER_FRAMES && !__atomic_load_n(&producer->stop, __ATOMIC_RELAXED)){
+    struct mixed_pack_reservation reservation = {0};
+    uint32_t frames = (PRODUCER_FRAMES - sequence < 7)? PRODUCER_FRAMES - sequence : 7;
+    if(!mixed_pack_reserve(frames*2*sizeof(int32_t), &reservation, producer->pack))
+      continue;
+    int32_t *area = (int32_t *)reservation.area;
+    for(uint32_t i=0; i<reservation.size/sizeof(int32_t); i+=2){
+      area[i+0] = producer->id;
+      area[i+1] = sequence++;
+    }
+    mixed_pack_commit(&reservation, producer->pack);
+  }
+  return 0;
+}
+
+define_test(multi_producer, {
+    struct mixed_pack pack = {0};
+    struct producer producers[PRODUCERS];
+    pthread_t threads[PRODUCERS] = {0};
+    int32_t sequences[PRODUCERS] = {0};
+    uint32_t frames = 0;
+    pack.channels = 2;
+    pack.encoding = MIXED_INT32;
+    pack.samplerate = 1;
+    pack.flags = MIXED_PACK_MULTI_PRODUCER;
+    if(!mixed_make_pack(512, &pack) && mixed_error() == MIXED_NOT_IMPLEMENTED)
+      goto cleanup;
+    is(pack.flags & MIXED_PACK_MIRRORED, MIXED_PACK_MIRRORED);
+    for(int i=0; i<PRODUCERS; ++i){
+      producers[i].pack = &pack;
+      producers[i].id = i;
+      producers[i].stop = 0;
+      if(pthread_create(&threads[i], 0, reserving_writer, &producers[i]) != 0)
+        fail_test("Failed to spawn thread.");
+    }
+    // Every frame must arrive whole, and in order per producer.
+    while(frames < PRODUCERS*PRODUCER_FRAMES){
+      int32_t *area;
+      uint32_t bytes = UINT32_MAX;
+      if(!mixed_pack_request_read((void**)&area, &bytes, &pack))
+        continue;
+      is(bytes % 8, 0);
+      for(uint32_t i=0; i<bytes/sizeof(int32_t); i+=2){
+        if(area[i] < 0 || PRODUCERS <= area[i])
+          fail_test("Bad producer id %i", area[i]);
+        is(area[i+1], sequences[area[i]]);
+        sequences[area[i]]++;
+      }
+      frames += bytes/8;
+      pass(mixed_pack_finish_read(bytes, &pack));
+    }
+    
+  cleanup:
+    for(int i=0; i<PRODUCERS; ++i)
+      __atomic_store_n(&producers[i].stop, 1, __ATOMIC_RELAXED);
+    for(int i=0; i<PRODUCERS; ++i)
+      if(threads[i]) pthread_join(threads[i], 0);
+    mixed_free_pack(&pack);
+  });
+
 define_test(randomized, {
     struct mixed_pack pack = {0};
     pack.channels = 1;
@@ -70,3 +322,139 @@ define_test(randomized, {
   cleanup:
     mixed_free_pack(&pack);
   });
+
+define_test(planar, {
+    struct mixed_pack pack = {0};
+    struct mixed_buffer buffers[2] = {0};
+    struct mixed_buffer *outs[2] = {&buffers[0], &buffers[1]};
+    int16_t *area;
+    uint32_t bytes = UINT32_MAX;
+    float volume = 1.0;
+    pack.channels = 2;
+    pack.encoding = MIXED_INT16;
+    pack.samplerate = 1;
+    pack.flags = MIXED_PACK_PLANAR | MIXED_PACK_MIRRORED;
+    fail(mixed_make_pack(16, &pack));
+    pack.flags = MIXED_PACK_PLANAR;
+    pass(mixed_make_pack(16, &pack));
+    is(pack.size, 16*sizeof(int16_t));
+    fail(mixed_pack_write(&volume, &bytes, 0, &pack));
+    bytes = UINT32_MAX;
+    pass(mixed_pack_request_write((void**)&area, &bytes, &pack));
+    is(bytes, 16*sizeof(int16_t));
+    for(int i=0; i<16; ++i){
+      area[i] = i*256;
+      area[16+i] = -i*256;
+    }
+    pass(mixed_pack_finish_write(bytes, &pack));
+    pass(mixed_make_buffer(16, &buffers[0]));
+    pass(mixed_make_buffer(16, &buffers[1]));
+    pass(mixed_buffer_from_pack(&pack, outs, &volume, 1.0));
+    is(mixed_buffer_available_read(&buffers[0]), 16);
+    is(mixed_buffer_available_read(&buffers[1]), 16);
+    for(int i=0; i<16; ++i){
+      is(buffers[0]._data[i], mixed_from_int16(i*256));
+      is(buffers[1]._data[i], mixed_from_int16(-i*256));
+    }
+    is(mixed_pack_available_read(&pack), 0);
+    pass(mixed_buffer_to_pack(outs, &pack, &volume, 1.0));
+    is(mixed_pack_available_read(&pack), 16*sizeof(int16_t));
+    for(int i=0; i<16; ++i){
+      is(area[i], i*256);
+      is(area[16+i], -i*256);
+    }
+
+  cleanup:
+    mixed_free_buffer(&buffers[0]);
+    mixed_free_buffer(&buffers[1]);
+    mixed_free_pack(&pack);
+  });
+
+define_test(buffer_view, {
+    struct mixed_pack pack = {0};
+    struct mixed_pack interleaved = {0};
+    struct mixed_buffer views[2] = {0};
+    struct mixed_buffer *view_ptrs[2] = {&views[0], &views[1]};
+    float next_write = 0, next_read = 0;
+    pack.channels = 2;
+    pack.encoding = MIXED_FLOAT;
+    pack.samplerate = 1;
+    pack.flags = MIXED_PACK_PLANAR;
+    interleaved.channels = 2;
+    interleaved.encoding = MIXED_FLOAT;
+    interleaved.samplerate = 1;
+    pass(mixed_make_pack(32, &pack));
+    pass(mixed_make_pack(32, &interleaved));
+    fail(mixed_make_buffer_view(&interleaved, 0, &views[0]));
+    fail(mixed_make_buffer_view(&pack, 2, &views[0]));
+    pass(mixed_make_buffer_view(&pack, 0, &views[0]));
+    pass(mixed_make_buffer_view(&pack, 1, &views[1]));
+    is(views[0].size, 32);
+    is((void*)views[1]._data, (void*)(pack._data + pack.size));
+    // Push data through in uneven steps so that the positions wrap.
+    for(int round=0; round<20; ++round){
+      uint32_t frames = 3 + (round*7) % 20;
+      while(0 < frames){
+        float *area;
+        uint32_t bytes = frames*sizeof(float);
+        mixed_pack_request_write((void**)&area, &bytes, &pack);
+        if(bytes == 0) break;
+        for(uint32_t i=0; i<bytes/sizeof(float); ++i){
+          area[i] = next_write;
+          area[i+32] = -next_write;
+          next_write += 1;
+        }
+        mixed_pack_finish_write(bytes, &pack);
+        frames -= bytes/sizeof(float);
+      }
+      pass(mixed_pack_sync_views(&pack, view_ptrs, 2));
+      is(mixed_buffer_available_read(&views[0]), mixed_pack_available_read(&pack)/sizeof(float));
+      for(;;){
+        float *left, *right;
+        uint32_t left_frames = UINT32_MAX, right_frames = UINT32_MAX;
+        mixed_buffer_request_read(&left, &left_frames, &views[0]);
+        mixed_buffer_request_read(&right, &right_frames, &views[1]);
+        is(left_frames, right_frames);
+        if(left_frames == 0) break;
+        for(uint32_t i=0; i<left_frames; ++i){
+          is(left[i], next_read);
+          is(right[i], -next_read);
+          next_read += 1;
+        }
+        mixed_buffer_finish_read(left_frames, &views[0]);
+        mixed_buffer_finish_read(right_frames, &views[1]);
+      }
+      pass(mixed_pack_sync_views(&pack, view_ptrs, 2));
+      is(mixed_pack_available_read(&pack), 0);
+    }
+    is(next_read, next_write);
+    
+  cleanup:
+    mixed_free_buffer(&views[0]);
+    mixed_free_buffer(&views[1]);
+    mixed_free_pack(&interleaved);
+    mixed_free_pack(&pack);
+  });
+
+define_test(multi_producer_reservations, {
+    struct mixed_pack pack = {0};
+    struct mixed_pack_reservation reservation = {0};
+    pack.channels = 1;
+    pack.encoding = MIXED_UINT8;
+    pack.samplerate = 1;
+    pack.flags = MIXED_PACK_MULTI_PRODUCER | MIXED_PACK_WAITABLE;
+    if(!mixed_make_pack(512, &pack) && mixed_error() == MIXED_NOT_IMPLEMENTED)
+      goto cleanup;
+    pass(mixed_pack_reserve(pack.size, &reservation, &pack));
+    // Outstanding reservations leave no room to wait for
+    fail(mixed_pack_wait_write(1, 0, &pack));
+    is(mixed_error(), MIXED_BUFFER_FULL);
+    // Plain writes would commit past the reservation
+    fail(mixed_pack_finish_write(1, &pack));
+    is(mixed_error(), MIXED_INVALID_VALUE);
+    pass(mixed_pack_commit(&reservation, &pack));
+    is(mixed_pack_available_read(&pack), pack.size);
+    
+  cleanup:
+    mixed_free_pack(&pack);
+  });
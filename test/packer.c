@@ -1,6 +1,7 @@
 #define __TEST_SUITE packer
 #include "tester.h"
 #include <math.h>
+#include <string.h>
 
 static int make_pack(enum mixed_encoding encoding, int channels, struct mixed_pack *pack){
   int frames = 500;
@@ -186,5 +187,473 @@ define_test(dual_channel_resample_in_out, {
     mixed_free_pack(&pack_i);
     mixed_free_pack(&pack_o);
   })
+
+static int check_dither(enum mixed_dither_type dither, channel_t channels){
+  int result = 0;
+  uint32_t frames = 1000;
+  struct mixed_pack pack = {0};
+  struct mixed_buffer buffers[3] = {0};
+  struct mixed_segment packer = {0};
+  enum mixed_dither_type current = 0;
+  pack.encoding = MIXED_INT16;
+  pack.channels = channels;
+  pack.samplerate = 48000;
+  if(!mixed_make_pack(frames, &pack)) goto cleanup;
+  if(!mixed_make_segment_packer(&pack, pack.samplerate, &packer)) goto cleanup;
+  if(!mixed_segment_set(MIXED_DITHER, &dither, &packer)) goto cleanup;
+  if(!mixed_segment_get(MIXED_DITHER, &current, &packer) || current != dither) goto cleanup;
+  // A quarter step above 1000, which truncation would always drop.
+  float value = 1000.25f/32768.0f;
+  for(channel_t c=0; c<channels; ++c){
+    if(!mixed_make_buffer(frames, &buffers[c])) goto cleanup;
+    if(!mixed_segment_set_in(MIXED_BUFFER, c, &buffers[c], &packer)) goto cleanup;
+    float *data;
+    uint32_t size = frames;
+    mixed_buffer_request_write(&data, &size, &buffers[c]);
+    for(uint32_t i=0; i<size; ++i) data[i] = value;
+    mixed_buffer_finish_write(size, &buffers[c]);
+  }
+  if(!mixed_segment_start(&packer)) goto cleanup;
+  if(!mixed_segment_mix(&packer)) goto cleanup;
+  if(mixed_pack_available_read(&pack) != frames*channels*sizeof(int16_t)) goto cleanup;
+  int16_t *out = (int16_t *)pack._data;
+  for(channel_t c=0; c<channels; ++c){
+    double sum = 0.0;
+    for(uint32_t i=0; i<frames; ++i){
+      int16_t sample = out[i*channels+c];
+      if(sample < 998 || 1002 < sample) goto cleanup;
+      sum += sample;
+    }
+    if(fabs(sum/frames - 1000.25) > 0.1) goto cleanup;
+  }
+  result = 1;
+
+ cleanup:
+  mixed_free_segment(&packer);
+  for(channel_t c=0; c<channels; ++c)
+    mixed_free_buffer(&buffers[c]);
+  mixed_free_pack(&pack);
+  return result;
+}
+
+define_test(dither, {
+    enum mixed_dither_type invalid = 0;
+    struct mixed_pack pack = {0};
+    struct mixed_segment packer = {0};
+    pack.encoding = MIXED_INT16;
+    pack.channels = 1;
+    pack.samplerate = 48000;
+    pass(mixed_make_pack(100, &pack));
+    pass(mixed_make_segment_packer(&pack, pack.samplerate, &packer));
+    fail(mixed_segment_set(MIXED_DITHER, &invalid, &packer));
+    // Two channels go through the vector kernels, three do not.
+    pass(check_dither(MIXED_TPDF_DITHER, 2));
+    pass(check_dither(MIXED_TPDF_DITHER, 3));
+    pass(check_dither(MIXED_SHAPED_DITHER, 2));
+    pass(check_dither(MIXED_SHAPED_DITHER, 3));
+
+  cleanup:
+    mixed_free_segment(&packer);
+    mixed_free_pack(&pack);
+  })
+
+define_test(adpcm, {
+    uint32_t frames = 2*MIXED_ADPCM_BLOCK_FRAMES;
+    struct mixed_pack pack = {0};
+    struct mixed_buffer l = {0}, r = {0};
+    struct mixed_segment packer = {0};
+    struct mixed_segment unpacker = {0};
+    float original[2][2*MIXED_ADPCM_BLOCK_FRAMES];
+    pack.encoding = MIXED_IMA_ADPCM;
+    pack.channels = 2;
+    pack.samplerate = 44100;
+    // Sizes are rounded to whole blocks
+    pass(mixed_make_pack(frames-10, &pack));
+    is(pack.size, 2*2*MIXED_ADPCM_BLOCK_SIZE);
+    is(mixed_samplesize(MIXED_IMA_ADPCM), 0);
+    pass(mixed_make_buffer(frames, &l));
+    pass(mixed_make_buffer(frames, &r));
+    // Only whole blocks go through the segments
+    fail(mixed_buffer_to_pack((struct mixed_buffer*[]){&l, &r}, &pack, &(float){1.0}, 1.0));
+    pass(mixed_make_segment_packer(&pack, pack.samplerate, &packer));
+    pass(mixed_make_segment_unpacker(&pack, pack.samplerate, &unpacker));
+    pass(mixed_segment_set_in(MIXED_BUFFER, MIXED_LEFT, &l, &packer));
+    pass(mixed_segment_set_in(MIXED_BUFFER, MIXED_RIGHT, &r, &packer));
+    pass(mixed_segment_set_out(MIXED_BUFFER, MIXED_LEFT, &l, &unpacker));
+    pass(mixed_segment_set_out(MIXED_BUFFER, MIXED_RIGHT, &r, &unpacker));
+    // Fill in two different tones
+    float *data;
+    uint32_t size = frames;
+    mixed_buffer_request_write(&data, &size, &l);
+    for(uint32_t i=0; i<size; ++i)
+      data[i] = original[0][i] = 0.5*sin(i*2*M_PI*440/44100);
+    mixed_buffer_finish_write(size, &l);
+    size = frames;
+    mixed_buffer_request_write(&data, &size, &r);
+    for(uint32_t i=0; i<size; ++i)
+      data[i] = original[1][i] = 0.25*sin(i*2*M_PI*1000/44100);
+    mixed_buffer_finish_write(size, &r);
+    // Encode
+    pass(mixed_segment_start(&packer));
+    pass(mixed_segment_mix(&packer));
+    is(mixed_buffer_available_read(&l), 0);
+    is(mixed_pack_available_read(&pack), pack.size);
+    // Decode again
+    pass(mixed_segment_start(&unpacker));
+    pass(mixed_segment_mix(&unpacker));
+    is(mixed_pack_available_read(&pack), 0);
+    is(mixed_buffer_available_read(&l), frames);
+    is(mixed_buffer_available_read(&r), frames);
+    for(uint32_t i=0; i<frames; ++i){
+      is(fabs(l._data[i] - original[0][i]) < 0.02, 1);
+      is(fabs(r._data[i] - original[1][i]) < 0.02, 1);
+    }
+
+  cleanup:
+    mixed_free_segment(&packer);
+    mixed_free_segment(&unpacker);
+    mixed_free_buffer(&l);
+    mixed_free_buffer(&r);
+    mixed_free_pack(&pack);
+  })
+  
+define_test(adpcm_partial, {
+    uint32_t frames = MIXED_ADPCM_BLOCK_FRAMES+100;
+    struct mixed_pack pack = {0};
+    struct mixed_buffer buffer = {0}, out = {0};
+    struct mixed_segment packer = {0};
+    struct mixed_segment unpacker = {0};
+    pack.encoding = MIXED_IMA_ADPCM;
+    pack.channels = 1;
+    pack.samplerate = 44100;
+    pass(mixed_make_pack(2*MIXED_ADPCM_BLOCK_FRAMES, &pack));
+    pass(mixed_make_buffer(frames, &buffer));
+    pass(mixed_make_buffer(2*MIXED_ADPCM_BLOCK_FRAMES, &out));
+    pass(mixed_make_segment_packer(&pack, pack.samplerate, &packer));
+    pass(mixed_make_segment_unpacker(&pack, pack.samplerate, &unpacker));
+    pass(mixed_segment_set_in(MIXED_BUFFER, MIXED_MONO, &buffer, &packer));
+    pass(mixed_segment_set_out(MIXED_BUFFER, MIXED_MONO, &out, &unpacker));
+    float *data;
+    uint32_t size = frames;
+    mixed_buffer_request_write(&data, &size, &buffer);
+    for(uint32_t i=0; i<size; ++i)
+      data[i] = 0.5*sin(i*2*M_PI*440/44100);
+    mixed_buffer_finish_write(size, &buffer);
+    // Only the whole block is encoded while mixing
+    pass(mixed_segment_start(&packer));
+    pass(mixed_segment_mix(&packer));
+    is(mixed_buffer_available_read(&buffer), 0);
+    is(mixed_pack_available_read(&pack), MIXED_ADPCM_BLOCK_SIZE);
+    // Ending flushes the rest, padded to a block
+    pass(mixed_segment_end(&packer));
+    is(mixed_pack_available_read(&pack), 2*MIXED_ADPCM_BLOCK_SIZE);
+    pass(mixed_segment_start(&unpacker));
+    pass(mixed_segment_mix(&unpacker));
+    is(mixed_buffer_available_read(&out), 2*MIXED_ADPCM_BLOCK_FRAMES);
+    for(uint32_t i=0; i<frames; ++i)
+      is(fabs(out._data[i] - 0.5*sin(i*2*M_PI*440/44100)) < 0.02, 1);
+    for(uint32_t i=frames; i<2*MIXED_ADPCM_BLOCK_FRAMES; ++i)
+      is(fabs(out._data[i]) < 0.02, 1);
+
+  cleanup:
+    mixed_free_segment(&packer);
+    mixed_free_segment(&unpacker);
+    mixed_free_buffer(&buffer);
+    mixed_free_buffer(&out);
+    mixed_free_pack(&pack);
+  })
   
+define_test(channel_map, {
+    uint32_t frames = 100;
+    struct mixed_pack in = {0}, out = {0};
+    struct mixed_buffer buffers[3] = {0};
+    struct mixed_segment unpacker = {0};
+    struct mixed_segment packer = {0};
+    struct mixed_channel_map map = {0};
+    int16_t *data;
+    uint32_t size = UINT32_MAX;
+    in.encoding = MIXED_INT16; in.channels = 6; in.samplerate = 48000;
+    out.encoding = MIXED_INT16; out.channels = 4; out.samplerate = 48000;
+    pass(mixed_make_pack(frames, &in));
+    pass(mixed_make_pack(frames, &out));
+    for(int i=0; i<3; ++i)
+      pass(mixed_make_buffer(frames, &buffers[i]));
+    mixed_pack_request_write((void**)&data, &size, &in);
+    for(uint32_t i=0; i<frames*6; ++i)
+      data[i] = (i%6)*1000 + i/6;
+    mixed_pack_finish_write(size, &in);
+    pass(mixed_make_segment_unpacker(&in, in.samplerate, &unpacker));
+    pass(mixed_make_segment_packer(&out, out.samplerate, &packer));
+    // Channels out of range and duplicate packer channels are refused
+    map = (struct mixed_channel_map){2, (channel_t[]){0, 6}};
+    fail(mixed_segment_set(MIXED_CHANNEL_MAP, &map, &unpacker));
+    map = (struct mixed_channel_map){2, (channel_t[]){1, 1}};
+    fail(mixed_segment_set(MIXED_CHANNEL_MAP, &map, &packer));
+    // Pick out channels in any order, even repeatedly
+    map = (struct mixed_channel_map){3, (channel_t[]){4, 1, 4}};
+    pass(mixed_segment_set(MIXED_CHANNEL_MAP, &map, &unpacker));
+    map = (struct mixed_channel_map){0};
+    pass(mixed_segment_get(MIXED_CHANNEL_MAP, &map, &unpacker));
+    is(map.count, 3);
+    is(map.channels[0], 4);
+    map = (struct mixed_channel_map){2, (channel_t[]){2, 0}};
+    pass(mixed_segment_set(MIXED_CHANNEL_MAP, &map, &packer));
+    for(int i=0; i<3; ++i)
+      pass(mixed_segment_set_out(MIXED_BUFFER, i, &buffers[i], &unpacker));
+    fail(mixed_segment_set_in(MIXED_BUFFER, 2, &buffers[2], &packer));
+    pass(mixed_segment_set_in(MIXED_BUFFER, 0, &buffers[0], &packer));
+    pass(mixed_segment_set_in(MIXED_BUFFER, 1, &buffers[1], &packer));
+    mixed_pack_clear(&out);
+    pass(mixed_segment_start(&unpacker));
+    pass(mixed_segment_start(&packer));
+    pass(mixed_segment_mix(&unpacker));
+    is(mixed_pack_available_read(&in), 0);
+    is(mixed_buffer_available_read(&buffers[2]), frames);
+    pass(mixed_segment_mix(&packer));
+    is(mixed_pack_available_read(&out), frames*4*sizeof(int16_t));
+    data = (int16_t *)out._data;
+    for(uint32_t i=0; i<frames; ++i){
+      is(data[i*4+0], 1000+i);
+      is(data[i*4+1], 0);
+      is(data[i*4+2], 4000+i);
+      is(data[i*4+3], 0);
+    }
+    pass(mixed_segment_end(&unpacker));
+    pass(mixed_segment_end(&packer));
+  cleanup:
+    mixed_free_segment(&unpacker);
+    mixed_free_segment(&packer);
+    for(int i=0; i<3; ++i)
+      mixed_free_buffer(&buffers[i]);
+    mixed_free_pack(&in);
+    mixed_free_pack(&out);
+  })
+
+define_test(wide_pack, {
+    uint32_t frames = 100;
+    struct mixed_pack in = {0}, out = {0};
+    struct mixed_buffer buffers[16] = {0};
+    struct mixed_segment unpacker = {0};
+    struct mixed_segment packer = {0};
+    int16_t *data;
+    uint32_t size = UINT32_MAX;
+    in.encoding = MIXED_INT16; in.channels = 16; in.samplerate = 48000;
+    out.encoding = MIXED_INT16; out.channels = 16; out.samplerate = 48000;
+    pass(mixed_make_pack(frames, &in));
+    pass(mixed_make_pack(frames, &out));
+    mixed_pack_request_write((void**)&data, &size, &in);
+    // Samples near full scale do not survive the round trip
+    // through floats exactly.
+    for(uint32_t i=0; i<frames*16; ++i)
+      data[i] = rand() % 16384 - 8192;
+    mixed_pack_finish_write(size, &in);
+    mixed_pack_clear(&out);
+    pass(mixed_make_segment_unpacker(&in, in.samplerate, &unpacker));
+    pass(mixed_make_segment_packer(&out, out.samplerate, &packer));
+    for(int c=0; c<16; ++c){
+      pass(mixed_make_buffer(frames, &buffers[c]));
+      pass(mixed_segment_set_out(MIXED_BUFFER, c, &buffers[c], &unpacker));
+      pass(mixed_segment_set_in(MIXED_BUFFER, c, &buffers[c], &packer));
+    }
+    fail(mixed_segment_set_in(MIXED_BUFFER, 16, &buffers[0], &packer));
+    pass(mixed_segment_start(&unpacker));
+    pass(mixed_segment_start(&packer));
+    pass(mixed_segment_mix(&unpacker));
+    pass(mixed_segment_mix(&packer));
+    is(mixed_pack_available_read(&out), frames*16*sizeof(int16_t));
+    is(memcmp(in._data, out._data, frames*16*sizeof(int16_t)), 0);
+    pass(mixed_segment_end(&unpacker));
+    pass(mixed_segment_end(&packer));
+  cleanup:
+    mixed_free_segment(&unpacker);
+    mixed_free_segment(&packer);
+    for(int c=0; c<16; ++c)
+      mixed_free_buffer(&buffers[c]);
+    mixed_free_pack(&in);
+    mixed_free_pack(&out);
+  })
+
+define_test(converter, {
+    struct mixed_pack in = {0}, out = {0};
+    struct mixed_segment converter = {0};
+    int16_t *ind;
+    float *outd;
+    uint32_t size = UINT32_MAX;
+    in.encoding = MIXED_INT16; in.channels = 1; in.samplerate = 48000;
+    out.encoding = MIXED_FLOAT; out.channels = 2; out.samplerate = 24000;
+    pass(mixed_make_pack(1000, &in));
+    pass(mixed_make_pack(1000, &out));
+    mixed_pack_request_write((void**)&ind, &size, &in);
+    for(uint32_t i=0; i<size/2; ++i)
+      ind[i] = 16384;
+    mixed_pack_finish_write(size, &in);
+    pass(mixed_make_segment_converter(&in, &out, &converter));
+    pass(mixed_segment_start(&converter));
+    pass(mixed_segment_mix(&converter));
+    // Halving the rate takes all input and yields about half the frames,
+    // with the mono input repeated on both channels.
+    is(mixed_pack_available_read(&in), 0);
+    size = mixed_pack_available_read(&out) / (2*sizeof(float));
+    if(size < 450 || 500 < size)
+      fail_test("Expected about 500 frames, got %i", size);
+    mixed_pack_request_read((void**)&outd, &size, &out);
+    for(uint32_t i=200; i<400; ++i){
+      if(fabs(outd[2*i] - 0.5) > 0.01 || outd[2*i] != outd[2*i+1])
+        fail_test("Frame %i is %f %f", i, outd[2*i], outd[2*i+1]);
+    }
+    pass(mixed_segment_end(&converter));
+  cleanup:
+    mixed_free_segment(&converter);
+    mixed_free_pack(&in);
+    mixed_free_pack(&out);
+  })
+
+define_test(converter_ramp, {
+    struct mixed_pack in = {0}, out = {0};
+    struct mixed_segment converter = {0};
+    float *ind, *outd;
+    float volume = 0.0;
+    uint32_t size = UINT32_MAX;
+    in.encoding = MIXED_FLOAT; in.channels = 2; in.samplerate = 48000;
+    out.encoding = MIXED_FLOAT; out.channels = 2; out.samplerate = 24000;
+    pass(mixed_make_pack(1000, &in));
+    pass(mixed_make_pack(1000, &out));
+    mixed_pack_request_write((void**)&ind, &size, &in);
+    for(uint32_t i=0; i<size/sizeof(float); ++i)
+      ind[i] = 0.5;
+    mixed_pack_finish_write(size, &in);
+    pass(mixed_make_segment_converter(&in, &out, &converter));
+    pass(mixed_segment_set(MIXED_VOLUME, &volume, &converter));
+    pass(mixed_segment_start(&converter));
+    pass(mixed_segment_mix(&converter));
+    // The fade ramps per frame, so both channels see the same gain.
+    size = UINT32_MAX;
+    mixed_pack_request_read((void**)&outd, &size, &out);
+    size /= 2*sizeof(float);
+    if(size < 400)
+      fail_test("Expected about 500 frames, got %i", size);
+    for(uint32_t i=0; i<size; ++i){
+      if(outd[2*i] != outd[2*i+1])
+        fail_test("Frame %i is %f %f", i, outd[2*i], outd[2*i+1]);
+    }
+    pass(mixed_segment_end(&converter));
+  cleanup:
+    mixed_free_segment(&converter);
+    mixed_free_pack(&in);
+    mixed_free_pack(&out);
+  })
+
+define_test(converter_map, {
+    struct mixed_pack in = {0}, out = {0};
+    struct mixed_segment converter = {0};
+    float *ind, *outd;
+    channel_t channels[3] = {1, 0, 2};
+    struct mixed_channel_map map = {2, channels};
+    uint32_t size = UINT32_MAX;
+    in.encoding = MIXED_FLOAT; in.channels = 2; in.samplerate = 48000;
+    out.encoding = MIXED_FLOAT; out.channels = 3; out.samplerate = 48000;
+    pass(mixed_make_pack(100, &in));
+    pass(mixed_make_pack(100, &out));
+    mixed_pack_request_write((void**)&ind, &size, &in);
+    for(uint32_t i=0; i<size/sizeof(float); ++i)
+      ind[i] = (i%2)? 0.75 : 0.25;
+    mixed_pack_finish_write(size, &in);
+    pass(mixed_make_segment_converter(&in, &out, &converter));
+    // Input channel 2 does not exist
+    map.count = 3;
+    fail(mixed_segment_set(MIXED_CHANNEL_MAP, &map, &converter));
+    map.count = 2;
+    pass(mixed_segment_set(MIXED_CHANNEL_MAP, &map, &converter));
+    pass(mixed_segment_start(&converter));
+    pass(mixed_segment_mix(&converter));
+    // The channels are swapped and the unmapped one is silent
+    size = UINT32_MAX;
+    mixed_pack_request_read((void**)&outd, &size, &out);
+    is(size, 100*3*sizeof(float));
+    for(uint32_t i=0; i<100; ++i){
+      if(outd[3*i] != 0.75 || outd[3*i+1] != 0.25 || outd[3*i+2] != 0.0)
+        fail_test("Frame %i is %f %f %f", i, outd[3*i], outd[3*i+1], outd[3*i+2]);
+    }
+    pass(mixed_segment_end(&converter));
+  cleanup:
+    mixed_free_segment(&converter);
+    mixed_free_pack(&in);
+    mixed_free_pack(&out);
+  })
+
+define_test(views, {
+    struct mixed_pack pack = {0};
+    struct mixed_buffer views[2] = {0};
+    struct mixed_segment unpacker = {0};
+    struct mixed_segment packer = {0};
+    float *area;
+    uint32_t bytes = UINT32_MAX;
+    pack.channels = 2;
+    pack.encoding = MIXED_FLOAT;
+    pack.samplerate = 48000;
+    pack.flags = MIXED_PACK_PLANAR;
+    pass(mixed_make_pack(64, &pack));
+    pass(mixed_make_segment_unpacker(&pack, 48000, &unpacker));
+    pass(mixed_make_buffer_view(&pack, 1, &views[0]));
+    pass(mixed_make_buffer_view(&pack, 0, &views[1]));
+    pass(mixed_segment_set_out(MIXED_BUFFER, 0, &views[0], &unpacker));
+    pass(mixed_segment_set_out(MIXED_BUFFER, 1, &views[1], &unpacker));
+    // The views do not match the channels in order.
+    fail(mixed_segment_start(&unpacker));
+    pass(mixed_make_buffer_view(&pack, 0, &views[0]));
+    pass(mixed_make_buffer_view(&pack, 1, &views[1]));
+    pack.samplerate = 44100;
+    fail(mixed_segment_start(&unpacker));
+    pack.samplerate = 48000;
+    // The packer cannot write through views.
+    pass(mixed_make_segment_packer(&pack, 48000, &packer));
+    pass(mixed_segment_set_in(MIXED_BUFFER, 0, &views[0], &packer));
+    pass(mixed_segment_set_in(MIXED_BUFFER, 1, &views[1], &packer));
+    fail(mixed_segment_start(&packer));
+    pass(mixed_segment_start(&unpacker));
+    mixed_pack_request_write((void**)&area, &bytes, &pack);
+    for(int i=0; i<40; ++i){
+      // Out of range samples come through unclamped.
+      area[i] = i;
+      area[64+i] = -i;
+    }
+    mixed_pack_finish_write(40*sizeof(float), &pack);
+    pass(mixed_segment_mix(&unpacker));
+    is(mixed_buffer_available_read(&views[0]), 40);
+    is(views[0]._data[39], 39.0);
+    is(views[1]._data[39], -39.0);
+    pass(mixed_buffer_finish_read(30, &views[0]));
+    pass(mixed_buffer_finish_read(25, &views[1]));
+    pass(mixed_segment_mix(&unpacker));
+    is(mixed_pack_available_read(&pack), 15*sizeof(float));
+    is(mixed_buffer_available_read(&views[0]), 15);
+    is(mixed_buffer_available_read(&views[1]), 15);
+    // Fill the pack up across the wrap, then read all of it.
+    for(int i=0; i<2; ++i){
+      bytes = UINT32_MAX;
+      pass(mixed_pack_request_write((void**)&area, &bytes, &pack));
+      pass(mixed_pack_finish_write(bytes, &pack));
+    }
+    is(mixed_pack_available_write(&pack), 0);
+    pass(mixed_segment_mix(&unpacker));
+    for(int c=0; c<2; ++c){
+      while(0 < mixed_buffer_available_read(&views[c])){
+        uint32_t samples = UINT32_MAX;
+        pass(mixed_buffer_request_read(&area, &samples, &views[c]));
+        pass(mixed_buffer_finish_read(samples, &views[c]));
+      }
+    }
+    // Having read a full wrap is not the same as having read nothing
+    pass(mixed_segment_mix(&unpacker));
+    is(mixed_pack_available_read(&pack), 0);
+    pass(mixed_segment_end(&unpacker));
+    
+  cleanup:
+    mixed_free_segment(&unpacker);
+    mixed_free_segment(&packer);
+    mixed_free_buffer(&views[0]);
+    mixed_free_buffer(&views[1]);
+    mixed_free_pack(&pack);
+  })
+
 #undef __TEST_SUITE
@@ -1,5 +1,7 @@
 #define __TEST_SUITE transfer
 #include "tester.h"
+#include <string.h>
+#include <math.h>
 
 static int make_pack(enum mixed_encoding encoding, int channels, struct mixed_pack *pack){
   pack->encoding = encoding;
@@ -110,6 +112,267 @@ define_test(dual_channel_uneven, {
     mixed_free_pack(&pack);
   })
 
+static int check_channels(enum mixed_encoding encoding, channel_t channels){
+  // An odd frame count, so that both the vector and scalar paths run.
+  uint32_t frames = 67;
+  uint32_t size = mixed_samplesize(encoding);
+  struct mixed_pack pack = {0};
+  struct mixed_buffer buffers[16] = {0};
+  struct mixed_buffer *barray[16];
+  float volume = 1.0;
+  int result = 0;
+  pack.encoding = encoding;
+  pack.channels = channels;
+  pack.samplerate = 1;
+  if(!mixed_make_pack(frames, &pack)) goto cleanup;
+  for(channel_t c=0; c<channels; ++c){
+    barray[c] = &buffers[c];
+    if(!mixed_make_buffer(frames, &buffers[c])) goto cleanup;
+  }
+  char *data;
+  uint32_t bytes = UINT32_MAX;
+  mixed_pack_request_write((void**)&data, &bytes, &pack);
+  for(uint32_t i=0; i<frames*channels; ++i){
+    switch(encoding){
+    case MIXED_INT16: ((int16_t*)data)[i] = (i%7 == 0)? INT16_MIN : rand(); break;
+    case MIXED_INT32: ((int32_t*)data)[i] = (i%7 == 0)? INT32_MAX : rand()*((i%2)? -1 : 1); break;
+    default: ((float*)data)[i] = (i%7 == 0)? 1.0 : (rand()/(float)RAND_MAX)*3.0-1.5; break;
+    }
+  }
+  mixed_pack_finish_write(bytes, &pack);
+  char original[16*4*67];
+  memcpy(original, data, bytes);
+  // Decode and compare against the scalar conversion
+  mixed_buffer_from_pack(&pack, barray, &volume, 1.0);
+  for(uint32_t i=0; i<frames*channels; ++i){
+    float expected, actual = buffers[i%channels]._data[i/channels];
+    switch(encoding){
+    case MIXED_INT16: expected = mixed_from_int16(((int16_t*)original)[i]); break;
+    case MIXED_INT32: expected = mixed_from_int32(((int32_t*)original)[i]); break;
+    default: expected = mixed_from_float(((float*)original)[i]); break;
+    }
+    if(actual != expected) goto cleanup;
+  }
+  // Encode and compare again
+  mixed_pack_clear(&pack);
+  mixed_buffer_to_pack(barray, &pack, &volume, 1.0);
+  if(mixed_pack_available_read(&pack) != frames*channels*size) goto cleanup;
+  for(uint32_t i=0; i<frames*channels; ++i){
+    float sample = buffers[i%channels]._data[i/channels];
+    switch(encoding){
+    case MIXED_INT16: if(((int16_t*)data)[i] != mixed_to_int16(sample)) goto cleanup; break;
+    case MIXED_INT32: if(((int32_t*)data)[i] != mixed_to_int32(sample)) goto cleanup; break;
+    default: if(((float*)data)[i] != mixed_to_float(sample)) goto cleanup; break;
+    }
+  }
+  result = 1;
+
+ cleanup:
+  for(channel_t c=0; c<channels; ++c)
+    mixed_free_buffer(&buffers[c]);
+  mixed_free_pack(&pack);
+  return result;
+}
+
+define_test(vectorised, {
+    enum mixed_encoding encodings[] = {MIXED_INT16, MIXED_INT32, MIXED_FLOAT};
+    channel_t channels[] = {1, 2, 4, 5, 6, 8, 12, 16};
+    for(int e=0; e<3; ++e){
+      for(int c=0; c<8; ++c){
+        if(!check_channels(encodings[e], channels[c]))
+          fail_test("Mismatch for encoding %i with %i channels", encodings[e], channels[c]);
+      }
+    }
+  cleanup: {}
+  })
+
+define_test(volume_ramp, {
+    struct mixed_pack pack = {0};
+    struct mixed_buffer buffers[2] = {0};
+    struct mixed_buffer *barray[2] = {&buffers[0], &buffers[1]};
+    float volume = 0.0;
+    float *data;
+    uint32_t bytes = UINT32_MAX;
+    pack.encoding = MIXED_FLOAT;
+    pack.channels = 2;
+    pack.samplerate = 1;
+    pass(mixed_make_pack(2048, &pack));
+    pass(mixed_make_buffer(512, &buffers[0]));
+    pass(mixed_make_buffer(512, &buffers[1]));
+    mixed_pack_request_write((void**)&data, &bytes, &pack);
+    for(uint32_t i=0; i<bytes/sizeof(float); ++i)
+      data[i] = 0.5;
+    mixed_pack_finish_write(bytes, &pack);
+    // The first block only gets halfway up
+    pass(mixed_buffer_from_pack(&pack, barray, &volume, 1.0));
+    is_f(volume, 0.5);
+    for(uint32_t i=0; i<512; ++i){
+      is_f(buffers[0]._data[i], 0.5*(i+1)/1024.0);
+      is_f(buffers[1]._data[i], buffers[0]._data[i]);
+    }
+    // The second one reaches the target on its last frame
+    mixed_buffer_clear(&buffers[0]);
+    mixed_buffer_clear(&buffers[1]);
+    pass(mixed_buffer_from_pack(&pack, barray, &volume, 1.0));
+    is_f(buffers[0]._data[510], 0.5*1023/1024.0);
+    is_f(buffers[0]._data[511], 0.5);
+    is_f(volume, 1.0);
+    // And from then on the volume stays put
+    mixed_buffer_clear(&buffers[0]);
+    mixed_buffer_clear(&buffers[1]);
+    pass(mixed_buffer_from_pack(&pack, barray, &volume, 1.0));
+    is_f(buffers[1]._data[0], 0.5);
+    is_f(volume, 1.0);
+
+  cleanup:
+    mixed_free_buffer(&buffers[0]);
+    mixed_free_buffer(&buffers[1]);
+    mixed_free_pack(&pack);
+  })
+
+static int check_layout(enum mixed_encoding encoding, channel_t channels){
+  // Every pattern of bytes is a valid sample in these encodings, so
+  // we can decode random bytes and compare the vector kernels
+  // against the scalar translators.
+  uint32_t frames = 67;
+  uint32_t size = mixed_samplesize(encoding);
+  struct mixed_pack pack = {0};
+  struct mixed_buffer buffers[16] = {0};
+  struct mixed_buffer *barray[16];
+  mixed_transfer_function_from decoder = mixed_translator_from(encoding);
+  mixed_transfer_function_to encoder = mixed_translator_to(encoding);
+  float volume = 1.0, expected[67];
+  char original[16*4*67], encoded[16*4*67];
+  int result = 0;
+  pack.encoding = encoding;
+  pack.channels = channels;
+  pack.samplerate = 1;
+  if(!mixed_make_pack(frames, &pack)) goto cleanup;
+  for(channel_t c=0; c<channels; ++c){
+    barray[c] = &buffers[c];
+    if(!mixed_make_buffer(frames, &buffers[c])) goto cleanup;
+  }
+  char *data;
+  uint32_t bytes = UINT32_MAX;
+  mixed_pack_request_write((void**)&data, &bytes, &pack);
+  for(uint32_t i=0; i<bytes; ++i)
+    data[i] = rand();
+  mixed_pack_finish_write(bytes, &pack);
+  memcpy(original, data, bytes);
+  mixed_buffer_from_pack(&pack, barray, &volume, 1.0);
+  for(channel_t c=0; c<channels; ++c){
+    decoder(original+c*size, expected, channels, frames, 1.0, 1.0);
+    if(memcmp(expected, buffers[c]._data, sizeof(float)*frames)) goto cleanup;
+    encoder(buffers[c]._data, encoded+c*size, channels, frames, 1.0, 1.0);
+  }
+  mixed_pack_clear(&pack);
+  mixed_buffer_to_pack(barray, &pack, &volume, 1.0);
+  if(mixed_pack_available_read(&pack) != bytes) goto cleanup;
+  if(memcmp(encoded, data, bytes)) goto cleanup;
+  result = 1;
+
+ cleanup:
+  for(channel_t c=0; c<channels; ++c)
+    mixed_free_buffer(&buffers[c]);
+  mixed_free_pack(&pack);
+  return result;
+}
+
+static int check_bytes(enum mixed_encoding encoding, float sample, const char *bytes){
+  char out[4] = {0};
+  mixed_translator_to(encoding)(&sample, out, 1, 1, 1.0, 1.0);
+  if(memcmp(out, bytes, mixed_samplesize(encoding))) return 0;
+  float back = 0.0;
+  mixed_translator_from(encoding)(out, &back, 1, 1, 1.0, 1.0);
+  return fabs(back - sample) < 0.0001;
+}
+
+define_test(packed_encodings, {
+    is(check_bytes(MIXED_INT24, 0.5, "\x00\x00\x40"), 1);
+    is(check_bytes(MIXED_INT24, -1.0, "\x00\x00\x80"), 1);
+    is(check_bytes(MIXED_INT16_BE, 0.5, "\x40\x00"), 1);
+    is(check_bytes(MIXED_INT16_BE, -1.0, "\x80\x00"), 1);
+    is(check_bytes(MIXED_INT24_BE, 0.5, "\x40\x00\x00"), 1);
+    is(check_bytes(MIXED_INT32_BE, -0.5, "\xC0\x00\x00\x00"), 1);
+    is(check_bytes(MIXED_INT24_32, -1.0, "\x00\x00\x80\xFF"), 1);
+    is(check_bytes(MIXED_INT20, 0.5, "\x00\x00\x04"), 1);
+    is(check_bytes(MIXED_INT20, -1.0, "\x00\x00\xF8"), 1);
+    enum mixed_encoding encodings[] = {MIXED_INT24, MIXED_INT16_BE, MIXED_INT24_BE, MIXED_INT32_BE, MIXED_INT24_32, MIXED_INT20, MIXED_MULAW, MIXED_ALAW};
+    channel_t channels[] = {1, 2, 3, 4, 5, 6, 8, 16};
+    for(int e=0; e<8; ++e){
+      for(int c=0; c<8; ++c){
+        if(!check_layout(encodings[e], channels[c]))
+          fail_test("Mismatch for encoding %i with %i channels", encodings[e], channels[c]);
+      }
+    }
+  cleanup: {}
+  })
+
+define_test(g711, {
+    mixed_transfer_function_from mulaw_from = mixed_translator_from(MIXED_MULAW);
+    mixed_transfer_function_to mulaw_to = mixed_translator_to(MIXED_MULAW);
+    mixed_transfer_function_from alaw_from = mixed_translator_from(MIXED_ALAW);
+    mixed_transfer_function_to alaw_to = mixed_translator_to(MIXED_ALAW);
+    uint8_t codes[256], encoded[256];
+    float decoded[256];
+    for(int i=0; i<256; ++i) codes[i] = i;
+    // Reference values from the G.711 tables
+    mulaw_from(codes, decoded, 1, 256, 1.0, 1.0);
+    is_f(decoded[0xFF], 0.0);
+    is_f(decoded[0x00], -32124/32768.0);
+    is_f(decoded[0x80], 32124/32767.0);
+    // Every code but negative zero survives a round trip
+    mulaw_to(decoded, encoded, 1, 256, 1.0, 1.0);
+    for(int i=0; i<256; ++i)
+      is(encoded[i], (i == 0x7F)? 0xFF : i);
+    alaw_from(codes, decoded, 1, 256, 1.0, 1.0);
+    is_f(decoded[0xD5], 8/32767.0);
+    is_f(decoded[0x55], -8/32768.0);
+    is_f(decoded[0xAA], 32256/32767.0);
+    alaw_to(decoded, encoded, 1, 256, 1.0, 1.0);
+    for(int i=0; i<256; ++i)
+      is(encoded[i], i);
+  cleanup: {}
+  })
+
+define_test(pack_convert, {
+    uint32_t frames = 3000;
+    struct mixed_pack in = {0}, out = {0}, mono = {0};
+    float volume = 1.0;
+    int16_t *ind;
+    uint8_t *outd;
+    uint32_t size = UINT32_MAX;
+    in.encoding = MIXED_INT16; in.channels = 2; in.samplerate = 48000;
+    out.encoding = MIXED_INT16_BE; out.channels = 3; out.samplerate = 48000;
+    mono.encoding = MIXED_INT16; mono.channels = 1; mono.samplerate = 44100;
+    pass(mixed_make_pack(frames, &in));
+    pass(mixed_make_pack(frames, &out));
+    pass(mixed_make_pack(frames, &mono));
+    mixed_pack_request_write((void**)&ind, &size, &in);
+    for(uint32_t i=0; i<2*frames; ++i)
+      ind[i] = (i%2)? -(int16_t)i : (int16_t)i;
+    mixed_pack_finish_write(size, &in);
+    // Converts across several staging chunks, silencing the extra channel
+    pass(mixed_pack_convert(&in, &out, &volume, 1.0));
+    is(mixed_pack_available_read(&in), 0);
+    is(mixed_pack_available_read(&out), frames*6);
+    size = UINT32_MAX;
+    mixed_pack_request_read((void**)&outd, &size, &out);
+    for(uint32_t i=0; i<frames; ++i){
+      uint8_t *frame = outd+i*6;
+      is((int16_t)(frame[0] << 8 | frame[1]), (int16_t)(2*i));
+      is((int16_t)(frame[2] << 8 | frame[3]), -(int16_t)(2*i+1));
+      is(frame[4] | frame[5], 0);
+    }
+    // Sample rates must agree
+    fail(mixed_pack_convert(&mono, &out, &volume, 1.0));
+    is(mixed_error(), MIXED_BAD_RESAMPLE_FACTOR);
+  cleanup:
+    mixed_free_pack(&in);
+    mixed_free_pack(&out);
+    mixed_free_pack(&mono);
+  })
+
 define_test(bounds_check, {
     mixed_transfer_function_from decoder = mixed_translator_from(MIXED_INT16);
     mixed_transfer_function_to encoder = mixed_translator_to(MIXED_INT16);